@@ -0,0 +1,90 @@
+/*
+ * Benchmark: gateway token minting, per-call DRBG seeding vs shared CSPRNG
+ * Mints 32-character bearer tokens the way gateway_auth does. The legacy
+ * path is the generator the gateway used before: a fresh entropy context
+ * and CTR-DRBG seeded for every output character, kept here as the
+ * reference.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+
+/* Reach the static token generator */
+#include "../src/gateway_auth.c"
+
+#define TOKEN_LEN           33      /* 32 characters + NUL */
+#define LEGACY_ITERATIONS   200
+#define SHARED_ITERATIONS   200000
+
+static int legacy_fill_bytes(unsigned char *out, size_t len) {
+    int rc;
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context ctr_drbg;
+    const char *pers = "mikroclaw-gateway-auth";
+
+    mbedtls_entropy_init(&entropy);
+    mbedtls_ctr_drbg_init(&ctr_drbg);
+    rc = mbedtls_ctr_drbg_seed(&ctr_drbg, mbedtls_entropy_func, &entropy,
+                               (const unsigned char *)pers, strlen(pers));
+    if (rc == 0) {
+        rc = mbedtls_ctr_drbg_random(&ctr_drbg, out, len);
+    }
+    mbedtls_ctr_drbg_free(&ctr_drbg);
+    mbedtls_entropy_free(&entropy);
+    return rc == 0 ? 0 : -1;
+}
+
+static int legacy_random_string(char *out, size_t len) {
+    static const char *alphabet = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
+    size_t alpha_len = strlen(alphabet);
+    unsigned char r[1];
+
+    for (size_t i = 0; i + 1 < len; i++) {
+        if (legacy_fill_bytes(r, sizeof(r)) != 0) {
+            return -1;
+        }
+        out[i] = alphabet[r[0] % alpha_len];
+    }
+    out[len - 1] = '\0';
+    return 0;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static volatile size_t sink;
+
+static double run(int (*mint)(char *, size_t), int iterations) {
+    char token[TOKEN_LEN];
+    double t = now_ns();
+
+    for (int i = 0; i < iterations; i++) {
+        assert(mint(token, sizeof(token)) == 0);
+        sink += (size_t)token[i % (TOKEN_LEN - 1)];
+    }
+    return (now_ns() - t) / iterations;
+}
+
+int main(void) {
+    double old_ns;
+    double new_ns;
+
+    /* First draw seeds the shared generator; keep it out of the timing */
+    assert(random_string((char[TOKEN_LEN]){0}, TOKEN_LEN) == 0);
+
+    old_ns = run(legacy_random_string, LEGACY_ITERATIONS);
+    new_ns = run(random_string, SHARED_ITERATIONS);
+
+    printf("token mint (%d chars)  per-call seeding %9.0f ns (%6.0f/s)  "
+           "shared csprng %6.0f ns (%8.0f/s)  %.0fx\n",
+           TOKEN_LEN - 1, old_ns, 1e9 / old_ns, new_ns, 1e9 / new_ns, old_ns / new_ns);
+    return 0;
+}
@@ -0,0 +1,216 @@
+/*
+ * Benchmark: identity vs gzip responses for a large /rest/interface listing
+ * Reports bytes on the wire and client CPU per response through the native
+ * HTTP client, plus raw inflate throughput. Needs gzip(1) to compress the
+ * payload.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "../src/http.h"
+#include "../src/http_pool.h"
+#include "../vendor/inflate.h"
+
+#define INTERFACES  400
+#define ITERATIONS  50
+#define WAN_MBIT    10      /* Link speed for the transfer time estimate */
+
+static char payload[INTERFACES * 640];
+static size_t payload_len;
+static unsigned char *gz;
+static size_t gz_len;
+
+/* RouterOS-like interface table with varying counters */
+static void build_payload(void) {
+    unsigned long seed = 12345;
+    size_t n = (size_t)snprintf(payload, sizeof(payload), "[");
+
+    for (int i = 0; i < INTERFACES; i++) {
+        unsigned long c[6];
+        for (int j = 0; j < 6; j++) {
+            seed = seed * 6364136223846793005ul + 1442695040888963407ul;
+            c[j] = (seed >> 33) % 4000000000ul;
+        }
+        n += (size_t)snprintf(payload + n, sizeof(payload) - n,
+            "%s{\".id\":\"*%X\",\"actual-mtu\":\"1500\",\"default-name\":\"ether%d\","
+            "\"disabled\":\"false\",\"fp-rx-byte\":\"%lu\",\"fp-rx-packet\":\"%lu\","
+            "\"fp-tx-byte\":\"0\",\"fp-tx-packet\":\"0\",\"l2mtu\":\"1598\","
+            "\"last-link-up-time\":\"2026-02-%02d 10:%02d:%02d\",\"link-downs\":\"%d\","
+            "\"mac-address\":\"48:A9:8A:%02X:%02X:%02X\",\"max-l2mtu\":\"9578\","
+            "\"mtu\":\"1500\",\"name\":\"%s%d\",\"running\":\"%s\",\"rx-byte\":\"%lu\","
+            "\"rx-drop\":\"0\",\"rx-error\":\"0\",\"rx-packet\":\"%lu\",\"tx-byte\":\"%lu\","
+            "\"tx-drop\":\"0\",\"tx-error\":\"0\",\"tx-packet\":\"%lu\","
+            "\"tx-queue-drop\":\"0\",\"type\":\"%s\"}",
+            i ? "," : "", i + 1, i + 1, c[0], c[0] / 900, 1 + i % 28, i % 60, (i * 7) % 60,
+            i % 5, (i >> 8) & 0xff, i & 0xff, (int)(c[1] & 0xff),
+            i < 24 ? "ether" : "vlan", i + 1, i % 4 ? "true" : "false",
+            c[2], c[2] / 800, c[3], c[3] / 700, i < 24 ? "ether" : "vlan");
+    }
+    n += (size_t)snprintf(payload + n, sizeof(payload) - n, "]");
+    payload_len = n;
+}
+
+static void compress_payload(void) {
+    char path[] = "/tmp/mikroclaw-bench-XXXXXX";
+    char cmd[128];
+    int fd = mkstemp(path);
+    FILE *p;
+
+    assert(fd >= 0);
+    assert(write(fd, payload, payload_len) == (ssize_t)payload_len);
+    close(fd);
+
+    snprintf(cmd, sizeof(cmd), "gzip -6 -c %s", path);
+    p = popen(cmd, "r");
+    assert(p != NULL);
+    gz = malloc(payload_len);
+    assert(gz != NULL);
+    gz_len = fread(gz, 1, payload_len, p);
+    assert(pclose(p) == 0 && gz_len > 0);
+    unlink(path);
+}
+
+static void send_all(int fd, const void *data, size_t len) {
+    const char *p = data;
+    while (len > 0) {
+        ssize_t n = send(fd, p, len, 0);
+        if (n <= 0) return;
+        p += n;
+        len -= (size_t)n;
+    }
+}
+
+/* Keep-alive server: "/gzip" gets the compressed body, anything else identity */
+static void serve(int listen_fd) {
+    int fd = accept(listen_fd, NULL, NULL);
+    int one = 1;
+    char buf[4096] = "";
+
+    /* Like a real server: no Nagle stall on the last partial segment */
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    while (fd >= 0) {
+        size_t total = 0;
+        char head[160];
+        int use_gzip;
+
+        while (!strstr(buf, "\r\n\r\n")) {
+            ssize_t n = recv(fd, buf + total, sizeof(buf) - total - 1, 0);
+            if (n <= 0) return;
+            total += (size_t)n;
+            buf[total] = '\0';
+        }
+        use_gzip = strncmp(buf, "GET /gzip ", 10) == 0;
+        buf[0] = '\0';
+
+        snprintf(head, sizeof(head),
+                 "HTTP/1.1 200 OK\r\nContent-Type: application/json\r\n%s"
+                 "Content-Length: %zu\r\n\r\n",
+                 use_gzip ? "Content-Encoding: gzip\r\n" : "",
+                 use_gzip ? gz_len : payload_len);
+        send_all(fd, head, strlen(head));
+        send_all(fd, use_gzip ? (const void *)gz : payload, use_gzip ? gz_len : payload_len);
+    }
+}
+
+static double now_ms(clockid_t clock) {
+    struct timespec ts;
+    clock_gettime(clock, &ts);
+    return ts.tv_sec * 1000.0 + ts.tv_nsec / 1e6;
+}
+
+static int count_body(const char *data, size_t len, void *user_data) {
+    (void)data;
+    *(size_t *)user_data += len;
+    return 0;
+}
+
+static void run(struct http_client *client, const char *path, size_t wire_body) {
+    double cpu = now_ms(CLOCK_PROCESS_CPUTIME_ID);
+    double wall = now_ms(CLOCK_MONOTONIC);
+    size_t decoded = 0;
+    struct http_response resp;
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        assert(http_get_stream(client, path, NULL, 0, count_body, &decoded, &resp) == 0);
+    }
+    cpu = (now_ms(CLOCK_PROCESS_CPUTIME_ID) - cpu) / ITERATIONS;
+    wall = (now_ms(CLOCK_MONOTONIC) - wall) / ITERATIONS;
+    assert(decoded == payload_len * ITERATIONS);
+
+    printf("%-10s wire %7zu B  decoded %7zu B  client cpu %6.3f ms  loopback %6.3f ms  "
+           "@%d Mbit/s %7.1f ms\n",
+           path, wire_body, payload_len, cpu, wall, WAN_MBIT,
+           wire_body * 8.0 / (WAN_MBIT * 1000.0));
+}
+
+static int discard(const unsigned char *data, size_t len, void *user_data) {
+    (void)data;
+    *(size_t *)user_data += len;
+    return 0;
+}
+
+static void run_inflate_only(void) {
+    static struct inflate_stream stream;
+    double cpu = now_ms(CLOCK_PROCESS_CPUTIME_ID);
+    size_t out = 0;
+    int rounds = 200;
+
+    for (int i = 0; i < rounds; i++) {
+        inflate_init(&stream, INFLATE_GZIP);
+        assert(inflate_write(&stream, gz, gz_len, discard, &out) == INFLATE_DONE);
+    }
+    cpu = now_ms(CLOCK_PROCESS_CPUTIME_ID) - cpu;
+    printf("inflate    %.1f MB/s decoded (%.3f ms per response)\n",
+           out / (cpu * 1000.0), cpu / rounds);
+}
+
+int main(void) {
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct http_client *client;
+    pid_t pid;
+    int status;
+
+    build_payload();
+    compress_payload();
+    printf("/rest/interface: %d interfaces, %zu B JSON, %zu B gzip (%.1fx)\n",
+           INTERFACES, payload_len, gz_len, (double)payload_len / gz_len);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert(bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    assert(listen(listen_fd, 1) == 0);
+    assert(getsockname(listen_fd, (struct sockaddr *)&addr, &addr_len) == 0);
+
+    pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        serve(listen_fd);
+        _exit(0);
+    }
+    close(listen_fd);
+
+    client = http_client_create("127.0.0.1", ntohs(addr.sin_port), false);
+    assert(client != NULL);
+    run(client, "/identity", payload_len);
+    run(client, "/gzip", gz_len);
+    http_client_destroy(client);
+    http_pool_flush();  /* Close the kept-alive connection so the server exits */
+    waitpid(pid, &status, 0);
+
+    run_inflate_only();
+    free(gz);
+    return 0;
+}
@@ -0,0 +1,188 @@
+/*
+ * Benchmark: response head parsing, single-pass scanner vs sscanf
+ * Parses captured-style response heads the way the client consumes them:
+ * status line, every header, framing headers, then one lookup of a header
+ * the caller wants. The sscanf path is the parser the client used before,
+ * kept here as the reference.
+ */
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* Reach the static parser */
+#include "../src/http.c"
+
+#define ITERATIONS  200000
+
+/* RouterOS REST (nginx-style) response head */
+static const char routeros_head[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Server: nginx\r\n"
+    "Date: Mon, 02 Mar 2026 10:14:07 GMT\r\n"
+    "Content-Type: application/json\r\n"
+    "Content-Length: 1834\r\n"
+    "Connection: keep-alive\r\n"
+    "Cache-Control: no-store\r\n"
+    "Expires: Thu, 01 Jan 1970 00:00:01 GMT\r\n"
+    "\r\n";
+
+/* LLM API behind a CDN: more than the old 16-header limit */
+static const char llm_head[] =
+    "HTTP/1.1 200 OK\r\n"
+    "Date: Mon, 02 Mar 2026 10:14:08 GMT\r\n"
+    "Content-Type: application/json\r\n"
+    "Transfer-Encoding: chunked\r\n"
+    "Connection: keep-alive\r\n"
+    "Access-Control-Allow-Origin: *\r\n"
+    "Cache-Control: private, no-cache\r\n"
+    "Vary: Accept-Encoding\r\n"
+    "X-Request-Id: req_01JNQ4W9Y2H3K5M7P8R0S1T2U3\r\n"
+    "X-Ratelimit-Limit-Requests: 10000\r\n"
+    "X-Ratelimit-Limit-Tokens: 2000000\r\n"
+    "X-Ratelimit-Remaining-Requests: 9999\r\n"
+    "X-Ratelimit-Remaining-Tokens: 1998734\r\n"
+    "X-Ratelimit-Reset-Requests: 6ms\r\n"
+    "X-Ratelimit-Reset-Tokens: 37ms\r\n"
+    "Openai-Processing-Ms: 412\r\n"
+    "Strict-Transport-Security: max-age=31536000; includeSubDomains; preload\r\n"
+    "X-Content-Type-Options: nosniff\r\n"
+    "Set-Cookie: __cf_bm=Zk4Qy7.abcdefghijklmnopqrstuvwxyz0123456789; path=/; "
+    "expires=Mon, 02-Mar-26 10:44:08 GMT; domain=.example.com; HttpOnly; Secure\r\n"
+    "Server: cloudflare\r\n"
+    "CF-RAY: 91a2b3c4d5e6f708-FRA\r\n"
+    "Content-Encoding: gzip\r\n"
+    "Alt-Svc: h3=\":443\"; ma=86400\r\n"
+    "\r\n";
+
+/* The client's previous parser: sscanf per line into fixed slots */
+struct legacy_response {
+    int status_code;
+    struct http_header headers[HTTP_MAX_HEADERS];
+    int num_headers;
+};
+
+static int legacy_parse(const char *data, struct legacy_response *response) {
+    int status;
+    const char *body_start;
+    const char *header_start;
+
+    response->num_headers = 0;
+    if (sscanf(data, "HTTP/%*s %d", &status) != 1) return -1;
+    response->status_code = status;
+
+    body_start = strstr(data, "\r\n\r\n");
+    if (!body_start) return -1;
+    body_start += 4;
+
+    header_start = strstr(data, "\r\n");
+    if (header_start) {
+        header_start += 2;
+        while (header_start < body_start && response->num_headers < HTTP_MAX_HEADERS) {
+            const char *line_end = strstr(header_start, "\r\n");
+            char name[HTTP_MAX_HEADER_NAME];
+            char value[HTTP_MAX_HEADER_VALUE];
+
+            if (!line_end || line_end >= body_start) break;
+            if (sscanf(header_start, "%63[^:]: %511[^\r]", name, value) == 2) {
+                strncpy(response->headers[response->num_headers].name, name,
+                        HTTP_MAX_HEADER_NAME - 1);
+                strncpy(response->headers[response->num_headers].value, value,
+                        HTTP_MAX_HEADER_VALUE - 1);
+                response->num_headers++;
+            }
+            header_start = line_end + 2;
+        }
+    }
+    return 0;
+}
+
+static const char *legacy_get_header(const struct legacy_response *response, const char *name) {
+    for (int i = 0; i < response->num_headers; i++) {
+        if (strcasecmp(response->headers[i].name, name) == 0) {
+            return response->headers[i].value;
+        }
+    }
+    return NULL;
+}
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static volatile size_t sink;
+
+static double run_legacy(const char *head, size_t len, const char *lookup) {
+    static struct legacy_response resp;
+    char buf[4096];
+    double t = now_ns();
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        const char *v;
+        memcpy(buf, head, len + 1);
+        assert(legacy_parse(buf, &resp) == 0);
+        /* What the framing logic looked up */
+        v = legacy_get_header(&resp, "Connection");
+        v = v ? v : legacy_get_header(&resp, "Content-Encoding");
+        v = v ? v : legacy_get_header(&resp, "Transfer-Encoding");
+        v = v ? v : legacy_get_header(&resp, "Content-Length");
+        sink += (size_t)resp.num_headers + (v != NULL);
+        v = legacy_get_header(&resp, lookup);
+        sink += v ? strlen(v) : 0;
+    }
+    return (now_ns() - t) / ITERATIONS;
+}
+
+static double run_scanner(struct http_client *client, const char *head, size_t len,
+                          const char *lookup, int *count) {
+    struct http_response resp;
+    struct http_framing framing;
+    char buf[4096];
+    double t = now_ns();
+
+    for (int i = 0; i < ITERATIONS; i++) {
+        const char *v;
+        int http10;
+        memcpy(buf, head, len + 1);
+        assert(parse_head(client, buf, len, &resp, &http10) == 0);
+        memset(&framing, 0, sizeof(framing));
+        parse_framing(&resp, http10, len, &framing);
+        sink += (size_t)resp.num_headers + (size_t)framing.keep_alive;
+        v = http_response_get_header(&resp, lookup);
+        sink += v ? strlen(v) : 0;
+        *count = resp.num_headers;
+    }
+    return (now_ns() - t) / ITERATIONS;
+}
+
+static void run(struct http_client *client, const char *label, const char *head,
+                const char *lookup) {
+    static struct legacy_response legacy;
+    char buf[4096];
+    size_t len = strlen(head);
+    int kept = 0;
+    double old_ns;
+    double new_ns;
+
+    memcpy(buf, head, len + 1);
+    assert(legacy_parse(buf, &legacy) == 0);
+    old_ns = run_legacy(head, len, lookup);
+    new_ns = run_scanner(client, head, len, lookup, &kept);
+
+    printf("%-9s %4zu B head  sscanf %7.0f ns (%2d headers kept)  "
+           "scanner %5.0f ns (%2d headers kept)  %.1fx\n",
+           label, len, old_ns, legacy.num_headers, new_ns, kept, old_ns / new_ns);
+}
+
+int main(void) {
+    struct http_client *client = http_client_create("bench.invalid", 80, false);
+
+    assert(client != NULL);
+    run(client, "routeros", routeros_head, "Content-Type");
+    run(client, "llm", llm_head, "X-Ratelimit-Remaining-Tokens");
+    http_client_destroy(client);
+    return 0;
+}
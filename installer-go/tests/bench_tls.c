@@ -0,0 +1,332 @@
+/*
+ * Benchmark: TLS handshake time and bulk throughput per ciphersuite
+ * Runs a local `openssl s_server` restricted to one suite at a time (EC
+ * P-256 certificate, TLS 1.2) and drives it through the mbedTLS
+ * integration layer: full and resumed handshakes, then a bulk download.
+ * Suites the library was built without are skipped. Also reports the mbedTLS
+ * heap held per connection, counted through the platform allocator hooks.
+ * Needs openssl(1).
+ */
+
+#include <assert.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include <mbedtls/platform.h>
+#include <mbedtls/ssl.h>
+
+#include "../vendor/mbedtls_integration.h"
+
+#define HANDSHAKES  50
+#define BULK_BYTES  (8u * 1024u * 1024u)
+
+/* Records no larger than the client's input buffer; the server would
+ * otherwise send 16 KiB records a small-buffer build cannot take */
+#if defined(MBEDTLS_SSL_IN_CONTENT_LEN)
+#define RECORD_MAX  MBEDTLS_SSL_IN_CONTENT_LEN
+#else
+#define RECORD_MAX  MBEDTLS_SSL_MAX_CONTENT_LEN
+#endif
+
+/* mbedTLS suite name -> OpenSSL cipher name, for the ECDSA certificate */
+static const struct {
+    const char *mbedtls;
+    const char *openssl;
+} suites[] = {
+    { "TLS-ECDHE-ECDSA-WITH-AES-128-GCM-SHA256", "ECDHE-ECDSA-AES128-GCM-SHA256" },
+    { "TLS-ECDHE-ECDSA-WITH-AES-256-GCM-SHA384", "ECDHE-ECDSA-AES256-GCM-SHA384" },
+    { "TLS-ECDHE-ECDSA-WITH-CHACHA20-POLY1305-SHA256", "ECDHE-ECDSA-CHACHA20-POLY1305" },
+};
+
+static char g_dir[] = "/tmp/mikroclaw-bench-tls-XXXXXX";
+static char g_cert[64];
+static char g_key[64];
+
+#if defined(MBEDTLS_PLATFORM_MEMORY)
+/* Every mbedTLS allocation carries its size in front */
+union alloc_hdr {
+    size_t size;
+    max_align_t align;
+};
+
+static size_t heap_now;
+static size_t heap_peak;
+
+static void *counting_calloc(size_t n, size_t size) {
+    union alloc_hdr *h;
+
+    if (size != 0 && n > (SIZE_MAX - sizeof(*h)) / size) return NULL;
+    h = calloc(1, sizeof(*h) + n * size);
+    if (!h) return NULL;
+    h->size = n * size;
+    heap_now += h->size;
+    if (heap_now > heap_peak) heap_peak = heap_now;
+    return h + 1;
+}
+
+static void counting_free(void *p) {
+    union alloc_hdr *h;
+
+    if (!p) return;
+    h = (union alloc_hdr *)p - 1;
+    heap_now -= h->size;
+    free(h);
+}
+#endif
+
+static double now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static int setup_files(void) {
+    char cmd[512];
+    char path[64];
+    char block[4096];
+    FILE *fp;
+
+    snprintf(g_cert, sizeof(g_cert), "%s/cert.pem", g_dir);
+    snprintf(g_key, sizeof(g_key), "%s/key.pem", g_dir);
+    snprintf(cmd, sizeof(cmd),
+             "openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:prime256v1 -nodes "
+             "-keyout %s -out %s -days 2 -subj /CN=localhost "
+             "-addext subjectAltName=DNS:localhost >/dev/null 2>&1", g_key, g_cert);
+    if (system(cmd) != 0) return -1;
+
+    /* Served by s_server -WWW as GET /bulk */
+    snprintf(path, sizeof(path), "%s/bulk", g_dir);
+    fp = fopen(path, "wb");
+    if (!fp) return -1;
+    for (size_t i = 0; i < sizeof(block); i++) block[i] = (char)('a' + i % 26);
+    for (size_t done = 0; done < BULK_BYTES; done += sizeof(block)) {
+        fwrite(block, 1, sizeof(block), fp);
+    }
+    fclose(fp);
+    return 0;
+}
+
+static uint16_t free_port(void) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    assert(getsockname(fd, (struct sockaddr *)&addr, &len) == 0);
+    close(fd);
+    return ntohs(addr.sin_port);
+}
+
+static int tcp_connect(uint16_t port) {
+    struct sockaddr_in addr;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+static pid_t start_server(uint16_t port, const char *cipher) {
+    char accept_arg[32];
+    char frag_arg[16];
+    pid_t pid;
+
+    snprintf(accept_arg, sizeof(accept_arg), "127.0.0.1:%u", port);
+    snprintf(frag_arg, sizeof(frag_arg), "%d", RECORD_MAX);
+    pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        if (chdir(g_dir) != 0) _exit(127);
+        execlp("openssl", "openssl", "s_server", "-quiet", "-WWW", "-tls1_2",
+               "-cipher", cipher, "-max_send_frag", frag_arg, "-accept", accept_arg,
+               "-cert", g_cert, "-key", g_key, (char *)NULL);
+        _exit(127);
+    }
+
+    for (int i = 0; i < 100; i++) {
+        int fd = tcp_connect(port);
+        if (fd >= 0) {
+            close(fd);
+            return pid;
+        }
+        usleep(50000);
+    }
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    return -1;
+}
+
+static void stop_server(pid_t pid) {
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+}
+
+/* One connection: handshake, optionally fetch /bulk; returns body bytes */
+static long session(uint16_t port, const char *expect_suite, double *handshake_ns,
+                    double *transfer_ns, int fetch) {
+    static char buf[16384];
+    const char *req = "GET /bulk HTTP/1.0\r\n\r\n";
+    struct mbedtls_ctx ctx;
+    long total = 0;
+    double t;
+    int fd = tcp_connect(port);
+
+    assert(fd >= 0);
+    assert(mbedtls_init(&ctx, "localhost") == 0);
+    assert(mbedtls_connect_socket(&ctx, fd) == 0);
+
+    t = now_ns();
+    assert(mbedtls_handshake(&ctx) == 0);
+    *handshake_ns = now_ns() - t;
+    assert(strcmp(mbedtls_tls_ciphersuite(&ctx), expect_suite) == 0);
+
+    if (fetch) {
+        int n;
+        t = now_ns();
+        assert(mbedtls_send(&ctx, req, strlen(req)) == (int)strlen(req));
+        while ((n = mbedtls_recv(&ctx, buf, sizeof(buf))) > 0) {
+            total += n;
+        }
+        *transfer_ns = now_ns() - t;
+    }
+
+    mbedtls_tls_close(&ctx);
+    mbedtls_tls_free(&ctx);
+    close(fd);
+    return total;
+}
+
+#if defined(MBEDTLS_PLATFORM_MEMORY)
+/* Heap a connection holds once established, and at its handshake peak */
+static void bench_memory(void) {
+    static char buf[512];
+    const char *req = "GET /bulk HTTP/1.0\r\n\r\n";
+    uint16_t port = free_port();
+    pid_t server = start_server(port, suites[0].openssl);
+    struct mbedtls_ctx ctx;
+    size_t base;
+    size_t idle;
+    size_t established;
+    int fd;
+
+    assert(server > 0);
+    mbedtls_tls_session_flush();
+    base = heap_now;
+    heap_peak = heap_now;
+
+    fd = tcp_connect(port);
+    assert(fd >= 0);
+    assert(mbedtls_init(&ctx, "localhost") == 0);
+    assert(mbedtls_connect_socket(&ctx, fd) == 0);
+    idle = heap_now - base;
+    assert(mbedtls_handshake(&ctx) == 0);
+    assert(mbedtls_send(&ctx, req, strlen(req)) == (int)strlen(req));
+    assert(mbedtls_recv(&ctx, buf, sizeof(buf)) > 0);
+    /* The cached session is shared state, not the connection's */
+    mbedtls_tls_session_flush();
+    established = heap_now - base;
+
+    printf("per connection (in %d B / out %d B records, max_fragment %d)  "
+           "before handshake %zu B  established %zu B  handshake peak %zu B\n",
+           MBEDTLS_SSL_IN_CONTENT_LEN, MBEDTLS_SSL_OUT_CONTENT_LEN, mbedtls_tls_max_fragment(),
+           idle, established, heap_peak - base);
+
+    mbedtls_tls_close(&ctx);
+    mbedtls_tls_free(&ctx);
+    close(fd);
+    stop_server(server);
+}
+#endif
+
+static void bench_suite(const char *mbedtls_name, const char *openssl_name) {
+    uint16_t port = free_port();
+    pid_t server = start_server(port, openssl_name);
+    double full = 0;
+    double resumed = 0;
+    double hs;
+    double xfer = 0;
+    long got;
+
+    assert(server > 0);
+
+    for (int i = 0; i < HANDSHAKES; i++) {
+        mbedtls_tls_session_flush();
+        session(port, mbedtls_name, &hs, NULL, 0);
+        full += hs;
+    }
+    for (int i = 0; i < HANDSHAKES; i++) {
+        session(port, mbedtls_name, &hs, NULL, 0);
+        resumed += hs;
+    }
+    got = session(port, mbedtls_name, &hs, &xfer, 1);
+    assert(got > (long)BULK_BYTES);
+
+    printf("%-46s full %6.2f ms  resumed %5.2f ms  bulk %7.1f MB/s\n",
+           mbedtls_name, full / HANDSHAKES / 1e6, resumed / HANDSHAKES / 1e6,
+           (double)got / (xfer / 1e9) / (1024 * 1024));
+    stop_server(server);
+}
+
+int main(void) {
+    const int *order;
+    char cmd[128];
+
+    if (system("command -v openssl >/dev/null 2>&1") != 0) {
+        printf("SKIP: openssl not available\n");
+        return 0;
+    }
+#if defined(MBEDTLS_PLATFORM_MEMORY)
+    assert(mbedtls_platform_set_calloc_free(counting_calloc, counting_free) == 0);
+#endif
+    assert(mkdtemp(g_dir) != NULL);
+    assert(setup_files() == 0);
+    setenv("SSL_CERT_FILE", g_cert, 1);
+
+    order = mbedtls_tls_ciphersuite_order();
+    assert(order != NULL);
+    printf("preferred AEAD: %s  (first suite offered: %s)\n",
+           mbedtls_tls_cipher_preference() == TLS_PREFER_AES_GCM ? "AES-GCM" : "ChaCha20-Poly1305",
+           mbedtls_ssl_get_ciphersuite_name(order[0]));
+
+    for (size_t i = 0; i < sizeof(suites) / sizeof(suites[0]); i++) {
+        int id = mbedtls_ssl_get_ciphersuite_id(suites[i].mbedtls);
+        int offered = 0;
+        for (int j = 0; id != 0 && order[j] != 0; j++) offered |= order[j] == id;
+        if (!offered) {
+            printf("%-46s not in this build\n", suites[i].mbedtls);
+            continue;
+        }
+        bench_suite(suites[i].mbedtls, suites[i].openssl);
+    }
+#if defined(MBEDTLS_PLATFORM_MEMORY)
+    bench_memory();
+#endif
+
+    assert(mbedtls_tls_cleanup() == 0);
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", g_dir);
+    assert(system(cmd) == 0);
+    return 0;
+}
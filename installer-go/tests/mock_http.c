@@ -65,6 +65,24 @@ struct http_client *http_client_create(const char *hostname, uint16_t port, bool
     return client;
 }
 
+void http_client_set_timeout(struct http_client *client, int timeout_ms) {
+    (void)client;
+    (void)timeout_ms;
+}
+
+void http_retry_set_default(const struct http_retry_policy *policy) {
+    (void)policy;
+}
+
+void http_retry_get_default(struct http_retry_policy *policy) {
+    if (policy) memset(policy, 0, sizeof(*policy));
+}
+
+void http_client_set_retry(struct http_client *client, const struct http_retry_policy *policy) {
+    (void)client;
+    (void)policy;
+}
+
 void http_client_destroy(struct http_client *client) {
     free(client);
 }
@@ -75,40 +93,22 @@ void http_response_clear(struct http_response *response) {
     }
 
     response->status_code = 0;
+    response->body = "";
     response->body_len = 0;
-    response->body[0] = '\0';
+    response->headers = NULL;
     response->num_headers = 0;
 }
 
-static void copy_headers(struct http_response *response, const struct http_header *headers, int num_headers) {
-    if (!response) {
-        return;
-    }
-
-    for (int i = 0; i < num_headers && i < HTTP_MAX_HEADERS; i++) {
-        if (headers[i].name[0] == '\0') {
-            continue;
-        }
-
-        strncpy(response->headers[response->num_headers].name,
-                headers[i].name,
-                sizeof(response->headers[response->num_headers].name) - 1);
-        strncpy(response->headers[response->num_headers].value,
-                headers[i].value,
-                sizeof(response->headers[response->num_headers].value) - 1);
-        response->num_headers++;
-    }
-}
-
 static void set_mock_response(struct http_response *response) {
     if (!response) {
         return;
     }
 
     response->status_code = g_next_status;
+    response->body = g_next_body;
     response->body_len = g_next_body_len;
-    memcpy(response->body, g_next_body, g_next_body_len);
-    response->body[g_next_body_len] = '\0';
+    response->headers = NULL;
+    response->num_headers = 0;
 }
 
 static void record_request(const char *method,
@@ -170,9 +170,49 @@ const char *http_response_get_header(const struct http_response *response, const
     }
 
     for (int i = 0; i < response->num_headers; i++) {
-        if (strncmp(response->headers[i].name, name, sizeof(response->headers[i].name)) == 0) {
+        if (strcmp(response->headers[i].name, name) == 0) {
             return response->headers[i].value;
         }
     }
     return NULL;
 }
+
+int http_get_stream(struct http_client *client, const char *path,
+                    const struct http_header *headers, int num_headers,
+                    http_body_cb on_body, void *user_data,
+                    struct http_response *response) {
+    (void)client;
+    record_request("GET", path, headers, num_headers, NULL, 0);
+    set_mock_response(response);
+    if (g_next_body_len > 0 && on_body(g_next_body, g_next_body_len, user_data) != 0) {
+        return HTTP_ERR_ABORTED;
+    }
+    return 0;
+}
+
+int http_post_stream(struct http_client *client, const char *path,
+                     const struct http_header *headers, int num_headers,
+                     const char *body, size_t body_len,
+                     http_body_cb on_body, void *user_data,
+                     struct http_response *response) {
+    (void)client;
+    record_request("POST", path, headers, num_headers, body, body_len);
+    set_mock_response(response);
+    if (g_next_body_len > 0 && on_body(g_next_body, g_next_body_len, user_data) != 0) {
+        return HTTP_ERR_ABORTED;
+    }
+    return 0;
+}
+
+int http_get_batch(struct http_client *client,
+                   const struct http_header *headers, int num_headers,
+                   struct http_batch_item *items, int count) {
+    struct http_response response;
+
+    for (int i = 0; i < count; i++) {
+        items[i].result = http_get_stream(client, items[i].path, headers, num_headers,
+                                          items[i].on_body, items[i].user_data, &response);
+        items[i].status_code = items[i].result == 0 ? response.status_code : 0;
+    }
+    return 0;
+}
@@ -0,0 +1,69 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "../src/csprng.h"
+
+/* Draw n bytes in a forked child and hand them back over a pipe */
+static void child_draw(unsigned char *out, size_t n, int reseed) {
+    int fds[2];
+    pid_t pid;
+    int status;
+
+    assert(pipe(fds) == 0);
+    pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        unsigned char buf[64];
+        close(fds[0]);
+        if (reseed) {
+            assert(csprng_reseed() == 0);
+        }
+        assert(csprng_bytes(buf, n) == 0);
+        assert(write(fds[1], buf, n) == (ssize_t)n);
+        _exit(0);
+    }
+    close(fds[1]);
+    assert(read(fds[0], out, n) == (ssize_t)n);
+    close(fds[0]);
+    waitpid(pid, &status, 0);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+int main(void) {
+    unsigned char a[32];
+    unsigned char b[32];
+    unsigned char big[3000];
+    unsigned char zero[sizeof(big)];
+
+    assert(csprng_bytes(NULL, 4) == -1);
+    assert(csprng_bytes(a, 0) == -1);
+
+    assert(csprng_bytes(a, sizeof(a)) == 0);
+    assert(csprng_bytes(b, sizeof(b)) == 0);
+    assert(memcmp(a, b, sizeof(a)) != 0);
+    printf("PASS: successive draws differ\n");
+
+    /* Larger than one DRBG request */
+    memset(big, 0, sizeof(big));
+    memset(zero, 0, sizeof(zero));
+    assert(csprng_bytes(big, sizeof(big)) == 0);
+    assert(memcmp(big + sizeof(big) - 64, zero, 64) != 0);
+    printf("PASS: bulk draw fills the whole buffer\n");
+
+    /* Children forked from the same state must not see the same stream,
+     * whether or not they reseed explicitly */
+    child_draw(a, sizeof(a), 0);
+    child_draw(b, sizeof(b), 0);
+    assert(memcmp(a, b, sizeof(a)) != 0);
+    child_draw(b, sizeof(b), 1);
+    assert(memcmp(a, b, sizeof(a)) != 0);
+    assert(csprng_bytes(b, sizeof(b)) == 0);
+    assert(memcmp(a, b, sizeof(a)) != 0);
+    printf("PASS: forked children draw independent streams\n");
+
+    printf("ALL PASS: csprng\n");
+    return 0;
+}
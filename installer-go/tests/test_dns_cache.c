@@ -0,0 +1,74 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "../src/dns_cache.h"
+
+static struct dns_cache_stats stats(void) {
+    struct dns_cache_stats s;
+    dns_cache_get_stats(&s);
+    return s;
+}
+
+static void test_hit_after_miss(void) {
+    struct dns_cache_addr addrs[DNS_CACHE_MAX_ADDRS];
+    struct dns_cache_stats before = stats();
+    int cached = -1;
+
+    assert(dns_cache_resolve("127.0.0.1", addrs, DNS_CACHE_MAX_ADDRS, &cached) >= 1);
+    assert(cached == 0);
+    assert(addrs[0].family == AF_INET);
+    assert(dns_cache_resolve("127.0.0.1", addrs, DNS_CACHE_MAX_ADDRS, &cached) >= 1);
+    assert(cached == 1);
+    assert(stats().misses == before.misses + 1);
+    assert(stats().hits == before.hits + 1);
+
+    dns_cache_invalidate("127.0.0.1");
+    assert(dns_cache_resolve("127.0.0.1", addrs, DNS_CACHE_MAX_ADDRS, &cached) >= 1);
+    assert(cached == 0);
+    printf("PASS: lookups are cached until invalidated\n");
+}
+
+static void test_negative_caching(void) {
+    struct dns_cache_addr addrs[DNS_CACHE_MAX_ADDRS];
+    struct dns_cache_stats before = stats();
+
+    assert(dns_cache_resolve("mikroclaw.invalid", addrs, DNS_CACHE_MAX_ADDRS, NULL) == -1);
+    assert(dns_cache_resolve("mikroclaw.invalid", addrs, DNS_CACHE_MAX_ADDRS, NULL) == -1);
+    assert(stats().misses == before.misses + 1);
+    assert(stats().negative_hits == before.negative_hits + 1);
+    printf("PASS: failed lookups are cached\n");
+}
+
+static void test_stale_while_revalidate(void) {
+    struct dns_cache_addr addrs[DNS_CACHE_MAX_ADDRS];
+    struct dns_cache_stats before;
+    int cached = -1;
+
+    dns_cache_flush();
+    dns_cache_set_ttl(1, 1);
+    assert(dns_cache_resolve("127.0.0.1", addrs, DNS_CACHE_MAX_ADDRS, NULL) >= 1);
+    sleep(2);
+
+    before = stats();
+    assert(dns_cache_resolve("127.0.0.1", addrs, DNS_CACHE_MAX_ADDRS, &cached) >= 1);
+    assert(cached == 1);
+    assert(stats().stale_hits == before.stale_hits + 1);
+    assert(stats().misses == before.misses);
+
+    dns_cache_revalidate();
+    assert(stats().revalidations == before.revalidations + 1);
+    assert(dns_cache_resolve("127.0.0.1", addrs, DNS_CACHE_MAX_ADDRS, &cached) >= 1);
+    assert(stats().hits == before.hits + 1);
+    printf("PASS: expired entries served stale and refreshed\n");
+}
+
+int main(void) {
+    test_hit_after_miss();
+    test_negative_caching();
+    test_stale_while_revalidate();
+
+    printf("ALL PASS: dns cache\n");
+    return 0;
+}
@@ -0,0 +1,217 @@
+/*
+ * Gateway TLS listener tests over loopback with a throwaway self-signed
+ * certificate for localhost. The native TLS client runs in the same
+ * process, stepping its handshake between gateway polls, so both ends stay
+ * non-blocking. Skipped when no openssl binary is available to make the
+ * certificate, or when mbedTLS has no server support.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "../src/gateway.h"
+#include "../vendor/mbedtls_integration.h"
+
+#define REPLY "HTTP/1.0 200 OK\r\nContent-Length: 2\r\n\r\nok"
+
+static char g_dir[] = "/tmp/mikroclaw-gwtls-XXXXXX";
+static char g_cert[64];
+static char g_key[64];
+
+static int make_cert(void) {
+    char cmd[512];
+
+    snprintf(g_cert, sizeof(g_cert), "%s/cert.pem", g_dir);
+    snprintf(g_key, sizeof(g_key), "%s/key.pem", g_dir);
+    snprintf(cmd, sizeof(cmd),
+             "openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:prime256v1 -nodes "
+             "-keyout %s -out %s -days 2 -subj /CN=localhost "
+             "-addext subjectAltName=DNS:localhost >/dev/null 2>&1", g_key, g_cert);
+    return system(cmd) == 0 ? 0 : -1;
+}
+
+static int tcp_connect(int port) {
+    struct sockaddr_in addr;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons((uint16_t)port);
+    assert(connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    fcntl(fd, F_SETFL, O_NONBLOCK);
+    return fd;
+}
+
+/* Serve one request from the gateway with REPLY; 1 once answered */
+static int serve_one(struct gateway_ctx *gw) {
+    char request[1024];
+    char ip[64];
+    int fd = -1;
+
+    if (gateway_poll(gw, request, sizeof(request), &fd, 0, ip, sizeof(ip)) != 1) {
+        return 0;
+    }
+    assert(strncmp(request, "GET /health ", 12) == 0);
+    assert(strcmp(ip, "127.0.0.1") == 0);
+    assert(gateway_respond(fd, REPLY) == 0);
+    return 1;
+}
+
+/* One HTTPS request from the native client; returns whether it resumed */
+static int client_request(struct gateway_ctx *gw) {
+    const char *req = "GET /health HTTP/1.0\r\n\r\n";
+    struct mbedtls_ctx cli;
+    char reply[256];
+    size_t got = 0;
+    int served = 0;
+    int step;
+    int fd = tcp_connect(gateway_port(gw));
+    int resumed;
+
+    assert(mbedtls_init(&cli, "localhost") == 0);
+    assert(mbedtls_connect_socket(&cli, fd) == 0);
+
+    /* Neither side blocks: each client step is answered by the next poll */
+    for (int i = 0; (step = mbedtls_handshake_step(&cli)) != 0; i++) {
+        assert(step == TLS_WANT_READ || step == TLS_WANT_WRITE);
+        assert(i < 1000);
+        assert(serve_one(gw) == 0);
+        usleep(1000);
+    }
+    assert(mbedtls_send(&cli, req, strlen(req)) == (int)strlen(req));
+
+    for (int i = 0; i < 1000; i++) {
+        int n;
+
+        if (!served) served = serve_one(gw);
+        n = mbedtls_recv(&cli, reply + got, sizeof(reply) - 1 - got);
+        if (n == 0) break;
+        if (n > 0) {
+            got += (size_t)n;
+            continue;
+        }
+        assert(errno == EAGAIN);
+        usleep(1000);
+    }
+    reply[got] = '\0';
+    assert(served);
+    assert(strcmp(reply, REPLY) == 0);
+
+    resumed = cli.resumed;
+    mbedtls_tls_free(&cli);
+    close(fd);
+    return resumed;
+}
+
+static void test_native_resumption(struct gateway_ctx *gw) {
+    struct tls_session_stats stats;
+
+    assert(client_request(gw) == 0);
+    assert(client_request(gw) == 1);
+
+    gateway_tls_stats(gw, &stats);
+    assert(stats.handshakes == 2);
+    assert(stats.resumed == 1);
+    printf("PASS: repeat client resumes without blocking the gateway\n");
+}
+
+/* openssl s_client without tickets, the second run resuming the session
+ * the first saved: resumption through the session ID cache */
+static void test_session_id_cache(struct gateway_ctx *gw) {
+    struct tls_session_stats before;
+    struct tls_session_stats after;
+    char cmd[1024];
+    int served = 0;
+    int status;
+    pid_t pid;
+
+    gateway_tls_stats(gw, &before);
+    pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        snprintf(cmd, sizeof(cmd),
+                 "for arg in '-sess_out %s/sess' '-sess_in %s/sess'; do "
+                 "printf 'GET /health HTTP/1.0\\r\\n\\r\\n' | "
+                 "openssl s_client -quiet -tls1_2 -no_ticket -connect 127.0.0.1:%d $arg "
+                 ">/dev/null 2>&1 || exit 1; done", g_dir, g_dir, gateway_port(gw));
+        _exit(system(cmd) == 0 ? 0 : 1);
+    }
+    for (int i = 0; i < 2000 && served < 2; i++) {
+        if (serve_one(gw)) {
+            served++;
+        } else {
+            usleep(5000);
+        }
+    }
+    assert(waitpid(pid, &status, 0) == pid);
+    assert(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    assert(served == 2);
+
+    gateway_tls_stats(gw, &after);
+    assert(after.handshakes == before.handshakes + 2);
+    assert(after.resumed == before.resumed + 1);
+    printf("PASS: session ID cache resumes clients without tickets\n");
+}
+
+/* A client that connects and says nothing only holds its own slot */
+static void test_silent_client(struct gateway_ctx *gw) {
+    int idle = tcp_connect(gateway_port(gw));
+
+    assert(serve_one(gw) == 0);
+    assert(client_request(gw) == 1);
+    close(idle);
+    printf("PASS: silent client does not stall the listener\n");
+}
+
+int main(void) {
+    struct gateway_config cfg = {0};
+    struct gateway_ctx *gw;
+    char cmd[128];
+
+    cfg.bind_addr = "127.0.0.1";
+
+    /* Half a TLS configuration never falls back to plaintext */
+    cfg.tls_cert = "/nonexistent/cert.pem";
+    assert(gateway_init(&cfg) == NULL);
+    cfg.tls_key = "/nonexistent/key.pem";
+    assert(gateway_init(&cfg) == NULL);
+
+    if (system("command -v openssl >/dev/null 2>&1") != 0) {
+        printf("SKIP: openssl not available\n");
+        return 0;
+    }
+    assert(mkdtemp(g_dir) != NULL);
+    assert(make_cert() == 0);
+    cfg.tls_cert = g_cert;
+    cfg.tls_key = g_key;
+
+    if (!mbedtls_tls_server_supported()) {
+        assert(gateway_init(&cfg) == NULL);
+        printf("SKIP: mbedTLS built without MBEDTLS_SSL_SRV_C\n");
+    } else {
+        setenv("SSL_CERT_FILE", g_cert, 1);
+        gw = gateway_init(&cfg);
+        assert(gw != NULL && gateway_is_tls(gw));
+        test_native_resumption(gw);
+        test_session_id_cache(gw);
+        test_silent_client(gw);
+        gateway_destroy(gw);
+        assert(mbedtls_tls_cleanup() == 0);
+    }
+
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", g_dir);
+    assert(system(cmd) == 0);
+    printf("ALL PASS: gateway tls\n");
+    return 0;
+}
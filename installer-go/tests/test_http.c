@@ -0,0 +1,1097 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <sys/wait.h>
+
+#include <mbedtls/ssl.h>
+
+#include "../src/http.h"
+#include "../src/http_pool.h"
+#include "../src/http_stats.h"
+
+/* Bytes received on a server connection but not consumed yet, so that
+ * pipelined requests survive being read together */
+struct conn_buf {
+    char data[16384];
+    size_t len;
+};
+
+/* Read one request (headers plus Content-Length body). Returns -1 on EOF.
+ * body_len/body_sum: length and byte sum of the request body */
+static int read_request(int fd, struct conn_buf *in, size_t *body_len, unsigned long *body_sum) {
+    char *end;
+    size_t head_len;
+    size_t want;
+    size_t got = 0;
+
+    in->data[in->len] = '\0';
+    while (!(end = strstr(in->data, "\r\n\r\n"))) {
+        ssize_t n = recv(fd, in->data + in->len, sizeof(in->data) - in->len - 1, 0);
+        if (n <= 0) {
+            return -1;
+        }
+        in->len += (size_t)n;
+        in->data[in->len] = '\0';
+    }
+
+    {
+        const char *cl = strstr(in->data, "Content-Length: ");
+        want = cl && cl < end ? (size_t)atoi(cl + 16) : 0;
+    }
+    head_len = (size_t)(end + 4 - in->data);
+    memmove(in->data, in->data + head_len, in->len - head_len);
+    in->len -= head_len;
+
+    *body_sum = 0;
+    while (got < want) {
+        size_t take;
+        if (in->len == 0) {
+            ssize_t n = recv(fd, in->data, sizeof(in->data) - 1, 0);
+            if (n <= 0) {
+                return -1;
+            }
+            in->len = (size_t)n;
+        }
+        take = in->len < want - got ? in->len : want - got;
+        for (size_t i = 0; i < take; i++) {
+            *body_sum += (unsigned char)in->data[i];
+        }
+        memmove(in->data, in->data + take, in->len - take);
+        in->len -= take;
+        got += take;
+    }
+    *body_len = got;
+    return 0;
+}
+
+/* Send a chunked response in small pieces so the client sees chunk sizes,
+ * payloads and CRLFs split across reads. */
+static void send_chunked(int fd, const char *body) {
+    const char *pieces[] = {
+        "HTTP/1.1 200 OK\r\nTransfer-Encoding: chunked\r\n\r\n",
+        "2;ext=1\r", "\n", NULL, "\r\n", "", NULL, "\r\n",
+        "0\r\nX-Trailer: yes\r\n", "\r\n"
+    };
+    char first[3];
+    char size_line[16];
+
+    snprintf(first, sizeof(first), "%.2s", body);
+    snprintf(size_line, sizeof(size_line), "%zx\r\n", strlen(body) - 2);
+    pieces[3] = first;
+    pieces[5] = size_line;
+    pieces[6] = body + 2;
+
+    for (size_t i = 0; i < sizeof(pieces) / sizeof(pieces[0]); i++) {
+        send(fd, pieces[i], strlen(pieces[i]), 0);
+        usleep(2000);
+    }
+}
+
+#define MODE_PLAIN      0
+#define MODE_CHUNKED    1
+#define MODE_LARGE      2   /* First response carries LARGE_BODY_LEN bytes */
+#define MODE_ECHO       3   /* Body reports request body length and byte sum */
+#define MODE_GZIP       4   /* gzip-encoded gzip_body, in small pieces */
+#define MODE_PIPELINE   5   /* Answer only once per_conn requests have arrived */
+#define MODE_HEADERS    6   /* MANY_HEADERS extra headers, odd casing, duplicates */
+#define MODE_RETRY      7   /* Responses 0, 2 and 3 are 503 "busy", Retry-After: 0 */
+#define MODE_BUSY       8   /* Every response is 503 "busy", Retry-After: 3600 */
+
+#define MANY_HEADERS    40
+
+#define LARGE_BODY_LEN  (200 * 1024)
+
+static void send_large(int fd) {
+    static char body[LARGE_BODY_LEN];
+    char head[128];
+
+    for (size_t i = 0; i < sizeof(body); i++) {
+        body[i] = (char)('a' + i % 26);
+    }
+    snprintf(head, sizeof(head), "HTTP/1.1 200 OK\r\nContent-Length: %zu\r\n\r\n",
+             sizeof(body));
+    send(fd, head, strlen(head), 0);
+    for (size_t sent = 0; sent < sizeof(body);) {
+        ssize_t n = send(fd, body + sent, sizeof(body) - sent, 0);
+        if (n <= 0) {
+            return;
+        }
+        sent += (size_t)n;
+    }
+}
+
+/* gzip of build_gzip_text(), generated with zlib */
+static const unsigned char gzip_body[] = {
+    0x1f, 0x8b, 0x08, 0x00, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x6d, 0xd2,
+    0x2b, 0x0e, 0xc3, 0x40, 0x00, 0x03, 0xd1, 0xbb, 0x2c, 0x0e, 0xa8, 0xed,
+    0x7c, 0x7b, 0x95, 0xaa, 0x20, 0x60, 0xa5, 0x90, 0x14, 0x54, 0x61, 0x51,
+    0xee, 0x9e, 0xd2, 0x6a, 0x96, 0x0e, 0x7a, 0xb2, 0xfc, 0x3a, 0xcb, 0x67,
+    0xdd, 0x6b, 0x79, 0x96, 0x7a, 0x6c, 0xf5, 0xab, 0x72, 0x75, 0xff, 0xc5,
+    0x28, 0x41, 0xe9, 0x51, 0x06, 0x94, 0x11, 0x65, 0x42, 0x99, 0x51, 0x16,
+    0x14, 0x3d, 0x98, 0xa8, 0x16, 0xd9, 0xa2, 0x5b, 0x84, 0x8b, 0x72, 0x91,
+    0x2e, 0xda, 0x45, 0xbc, 0xa8, 0x37, 0xf5, 0x6e, 0x6c, 0x4e, 0xbd, 0xa9,
+    0x37, 0xf5, 0xa6, 0xde, 0xd4, 0x9b, 0x7a, 0x53, 0x6f, 0xea, 0x43, 0x7d,
+    0xa8, 0x4f, 0xe3, 0x32, 0xd4, 0x87, 0xfa, 0x50, 0x1f, 0xea, 0x43, 0x7d,
+    0xa8, 0x0f, 0xf5, 0xfd, 0x4f, 0xff, 0xbe, 0x01, 0x81, 0x64, 0xcc, 0x72,
+    0xf0, 0x02, 0x00, 0x00,
+};
+
+static size_t build_gzip_text(char *buf, size_t size) {
+    size_t n = (size_t)snprintf(buf, size, "[");
+
+    for (int i = 1; i <= 40; i++) {
+        n += (size_t)snprintf(buf + n, size - n, "%s{\"name\":\"ether%d\"}", i > 1 ? "," : "", i);
+    }
+    n += (size_t)snprintf(buf + n, size - n, "]");
+    return n;
+}
+
+static void send_many_headers(int fd, const char *body) {
+    char resp[4096];
+    size_t n = (size_t)snprintf(resp, sizeof(resp), "HTTP/1.1 200 OK\r\n");
+
+    for (int i = 0; i < MANY_HEADERS; i++) {
+        n += (size_t)snprintf(resp + n, sizeof(resp) - n, "X-Header-%d:\tvalue-%d  \r\n", i, i);
+    }
+    n += (size_t)snprintf(resp + n, sizeof(resp) - n,
+                          "Set-Cookie: a=1\r\nset-cookie: b=2\r\nRetry-After: 7\r\n"
+                          "Connection: Keep-Alive, x-close-ish\r\n"
+                          "Content-Encoding: x-gzip-ish\r\n"
+                          "not a header\r\nCONTENT-length: %zu\r\n\r\n%s",
+                          strlen(body), body);
+    send(fd, resp, n, 0);
+}
+
+static void send_gzip(int fd) {
+    char head[128];
+
+    snprintf(head, sizeof(head),
+             "HTTP/1.1 200 OK\r\nContent-Encoding: gzip\r\nContent-Length: %zu\r\n\r\n",
+             sizeof(gzip_body));
+    send(fd, head, strlen(head), 0);
+    for (size_t sent = 0; sent < sizeof(gzip_body); sent += 40) {
+        size_t n = sizeof(gzip_body) - sent < 40 ? sizeof(gzip_body) - sent : 40;
+        send(fd, gzip_body + sent, n, 0);
+        usleep(2000);
+    }
+}
+
+/* Serve `total` responses, closing each connection after `per_conn` of them.
+ * Bodies are "c<connection>r<request>" so the client can see reuse. */
+static void serve(int listen_fd, int per_conn, int total, int mode) {
+    static struct conn_buf in;
+    int conns = 0;
+    int served = 0;
+
+    while (served < total) {
+        int fd = accept(listen_fd, NULL, NULL);
+        if (fd < 0) {
+            return;
+        }
+        conns++;
+        in.len = 0;
+        if (mode == MODE_PIPELINE) {
+            size_t req_len;
+            unsigned long req_sum;
+            int got = 0;
+            while (got < per_conn && read_request(fd, &in, &req_len, &req_sum) == 0) {
+                got++;
+            }
+            for (int r = 1; r <= got; r++) {
+                char resp[128];
+                snprintf(resp, sizeof(resp),
+                         "HTTP/1.1 200 OK\r\nContent-Length: 4\r\n\r\nc%dr%d", conns, r);
+                send(fd, resp, strlen(resp), 0);
+            }
+            served += got;
+            close(fd);
+            continue;
+        }
+        for (int r = 1; r <= per_conn && served < total; r++) {
+            char body[64];
+            char resp[256];
+            size_t req_len;
+            unsigned long req_sum;
+            if (read_request(fd, &in, &req_len, &req_sum) != 0) {
+                break;
+            }
+            if (mode == MODE_ECHO) {
+                snprintf(body, sizeof(body), "n%zus%lu", req_len, req_sum);
+            } else {
+                snprintf(body, sizeof(body), "c%dr%d", conns, r);
+            }
+            if (mode == MODE_LARGE && served == 0) {
+                send_large(fd);
+                served++;
+                continue;
+            }
+            if (mode == MODE_GZIP) {
+                send_gzip(fd);
+                served++;
+                continue;
+            }
+            if (mode == MODE_HEADERS) {
+                send_many_headers(fd, body);
+                served++;
+                continue;
+            }
+            if (mode == MODE_RETRY && (served == 0 || served == 2 || served == 3)) {
+                const char *busy = "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 0\r\n"
+                                   "Content-Length: 4\r\n\r\nbusy";
+                send(fd, busy, strlen(busy), 0);
+                served++;
+                continue;
+            }
+            if (mode == MODE_BUSY) {
+                const char *busy = "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 3600\r\n"
+                                   "Content-Length: 4\r\n\r\nbusy";
+                send(fd, busy, strlen(busy), 0);
+                served++;
+                continue;
+            }
+            if (mode == MODE_CHUNKED) {
+                send_chunked(fd, body);
+                served++;
+                continue;
+            }
+            snprintf(resp, sizeof(resp),
+                     "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n"
+                     "Content-Length: %zu\r\n\r\n%s",
+                     strlen(body), body);
+            send(fd, resp, strlen(resp), 0);
+            served++;
+        }
+        close(fd);
+    }
+}
+
+/* Listening socket on the loopback address of family, or -1 if unsupported */
+static int listen_loopback(int family, int backlog, uint16_t *port) {
+    struct sockaddr_storage addr;
+    socklen_t addr_len = family == AF_INET6 ? sizeof(struct sockaddr_in6) :
+                                              sizeof(struct sockaddr_in);
+    int fd = socket(family, SOCK_STREAM, 0);
+
+    if (fd < 0) {
+        return -1;
+    }
+    memset(&addr, 0, sizeof(addr));
+    if (family == AF_INET6) {
+        ((struct sockaddr_in6 *)&addr)->sin6_family = AF_INET6;
+        ((struct sockaddr_in6 *)&addr)->sin6_addr = in6addr_loopback;
+    } else {
+        ((struct sockaddr_in *)&addr)->sin_family = AF_INET;
+        ((struct sockaddr_in *)&addr)->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    }
+    if (bind(fd, (struct sockaddr *)&addr, addr_len) != 0 || listen(fd, backlog) != 0 ||
+        getsockname(fd, (struct sockaddr *)&addr, &addr_len) != 0) {
+        close(fd);
+        return -1;
+    }
+    *port = ntohs(family == AF_INET6 ? ((struct sockaddr_in6 *)&addr)->sin6_port :
+                                       ((struct sockaddr_in *)&addr)->sin_port);
+    return fd;
+}
+
+static pid_t fork_server(int fd, int per_conn, int total, int mode) {
+    pid_t pid = fork();
+
+    assert(pid >= 0);
+    if (pid == 0) {
+        serve(fd, per_conn, total, mode);
+        _exit(0);
+    }
+    close(fd);
+    return pid;
+}
+
+static pid_t start_server(int per_conn, int total, int mode, uint16_t *port) {
+    int fd = listen_loopback(AF_INET, 4, port);
+
+    assert(fd >= 0);
+    return fork_server(fd, per_conn, total, mode);
+}
+
+static void expect_body(struct http_client *client, const char *method, const char *want) {
+    struct http_response resp;
+    int ret;
+
+    memset(&resp, 0, sizeof(resp));
+    if (strcmp(method, "POST") == 0) {
+        ret = http_post(client, "/echo", NULL, 0, "{\"a\":1}", 7, &resp);
+    } else {
+        ret = http_get(client, "/", NULL, 0, &resp);
+    }
+    assert(ret == 0);
+    assert(resp.status_code == 200);
+    assert(strcmp(resp.body, want) == 0);
+    assert(resp.body_len == strlen(want));
+}
+
+static void test_keep_alive_reuses_connection(void) {
+    uint16_t port;
+    int status;
+    pid_t pid = start_server(4, 4, MODE_PLAIN, &port);
+    struct http_client *client = http_client_create("127.0.0.1", port, false);
+    struct http_response resp;
+
+    assert(client != NULL);
+    expect_body(client, "GET", "c1r1");
+    expect_body(client, "POST", "c1r2");
+    expect_body(client, "GET", "c1r3");
+
+    /* Header views point into the client's receive buffer */
+    assert(http_get(client, "/", NULL, 0, &resp) == 0);
+    assert(strcmp(resp.body, "c1r4") == 0);
+    assert(strcmp(http_response_get_header(&resp, "content-type"), "text/plain") == 0);
+    assert(strcmp(http_response_get_header(&resp, "Content-Length"), "4") == 0);
+    assert(http_response_get_header(&resp, "X-Missing") == NULL);
+    http_client_destroy(client);
+
+    waitpid(pid, &status, 0);
+    printf("PASS: keep-alive reuses one connection\n");
+}
+
+static void test_stale_connection_reconnects(void) {
+    uint16_t port;
+    int status;
+    pid_t pid = start_server(1, 3, MODE_PLAIN, &port);
+    struct http_client *client = http_client_create("127.0.0.1", port, false);
+
+    assert(client != NULL);
+    expect_body(client, "GET", "c1r1");
+    expect_body(client, "GET", "c2r1");
+    usleep(50000);
+    expect_body(client, "POST", "c3r1");
+    http_client_destroy(client);
+
+    waitpid(pid, &status, 0);
+    printf("PASS: stale connection reconnects\n");
+}
+
+static void test_chunked_response_keeps_alive(void) {
+    uint16_t port;
+    int status;
+    pid_t pid = start_server(2, 2, MODE_CHUNKED, &port);
+    struct http_client *client = http_client_create("127.0.0.1", port, false);
+
+    assert(client != NULL);
+    expect_body(client, "GET", "c1r1");
+    expect_body(client, "POST", "c1r2");
+    http_client_destroy(client);
+
+    waitpid(pid, &status, 0);
+    printf("PASS: chunked response decoded without waiting for close\n");
+}
+
+struct stream_check {
+    size_t total;
+    size_t calls;
+    size_t max_chunk;
+    int in_order;
+};
+
+static int check_chunk(const char *data, size_t len, void *user_data) {
+    struct stream_check *check = user_data;
+
+    for (size_t i = 0; i < len; i++) {
+        if (data[i] != (char)('a' + (check->total + i) % 26)) {
+            check->in_order = 0;
+        }
+    }
+    check->total += len;
+    check->calls++;
+    if (len > check->max_chunk) {
+        check->max_chunk = len;
+    }
+    return 0;
+}
+
+static void test_stream_large_body(void) {
+    uint16_t port;
+    int status;
+    pid_t pid = start_server(2, 2, MODE_LARGE, &port);
+    struct http_client *client = http_client_create("127.0.0.1", port, false);
+    struct stream_check check = {0, 0, 0, 1};
+    struct http_response resp;
+
+    assert(client != NULL);
+    assert(http_get_stream(client, "/big", NULL, 0, check_chunk, &check, &resp) == 0);
+    assert(resp.status_code == 200);
+    assert(resp.body_len == LARGE_BODY_LEN);
+    assert(check.total == LARGE_BODY_LEN);
+    assert(check.in_order);
+    assert(check.max_chunk <= HTTP_STREAM_BUF_SIZE);
+    assert(check.calls > 1);
+    expect_body(client, "GET", "c1r2");
+    http_client_destroy(client);
+
+    waitpid(pid, &status, 0);
+    printf("PASS: large body streamed in bounded chunks\n");
+}
+
+static void test_ipv6_literal(void) {
+    uint16_t port;
+    int status;
+    int fd = listen_loopback(AF_INET6, 4, &port);
+    struct http_client *client;
+    pid_t pid;
+
+    if (fd < 0) {
+        printf("SKIP: no IPv6 loopback\n");
+        return;
+    }
+    pid = fork_server(fd, 1, 1, MODE_PLAIN);
+    client = http_client_create("::1", port, false);
+    assert(client != NULL);
+    expect_body(client, "GET", "c1r1");
+    http_client_destroy(client);
+
+    waitpid(pid, &status, 0);
+    printf("PASS: IPv6 address connects\n");
+}
+
+static const struct http_retry_policy one_attempt = { 1, 1, 1, false };
+
+static void test_connect_deadline(void) {
+    uint16_t port;
+    int fd = listen_loopback(AF_INET, 0, &port);
+    int filler = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr;
+    struct http_client *client;
+    struct http_response resp;
+    struct timeval start;
+    struct timeval end;
+    long elapsed_ms;
+
+    /* Never accept and fill the backlog, so further connects stall */
+    assert(fd >= 0 && filler >= 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert(connect(filler, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+
+    client = http_client_create("127.0.0.1", port, false);
+    assert(client != NULL);
+    http_client_set_timeout(client, 300);
+    http_client_set_retry(client, &one_attempt);  /* Time a single connect */
+
+    gettimeofday(&start, NULL);
+    assert(http_get(client, "/", NULL, 0, &resp) == HTTP_ERR_TIMEOUT);
+    gettimeofday(&end, NULL);
+    elapsed_ms = (end.tv_sec - start.tv_sec) * 1000 + (end.tv_usec - start.tv_usec) / 1000;
+    assert(elapsed_ms >= 250 && elapsed_ms < 2000);
+
+    http_client_destroy(client);
+    close(filler);
+    close(fd);
+    printf("PASS: stalled connect bounded by deadline\n");
+}
+
+static void test_pool_shares_connections(void) {
+    uint16_t port;
+    int status;
+    pid_t pid = start_server(3, 4, MODE_PLAIN, &port);
+    struct http_client *a = http_client_create("127.0.0.1", port, false);
+    struct http_client *b = http_client_create("127.0.0.1", port, false);
+    struct http_pool_stats before;
+    struct http_pool_stats after;
+
+    assert(a != NULL && b != NULL);
+    http_pool_get_stats(&before);
+    expect_body(a, "GET", "c1r1");
+    expect_body(b, "GET", "c1r2");
+    http_client_destroy(a);
+
+    /* A short-lived client to the same origin reuses the pooled socket */
+    a = http_client_create("127.0.0.1", port, false);
+    expect_body(a, "POST", "c1r3");
+    http_pool_get_stats(&after);
+    assert(after.reused == before.reused + 2);
+
+    /* Idle connections past the timeout are closed */
+    http_pool_configure(0, 0, 50);
+    usleep(100000);
+    http_pool_prune();
+    http_pool_get_stats(&after);
+    assert(after.expired > before.expired);
+    expect_body(b, "GET", "c2r1");
+    http_pool_configure(0, 0, HTTP_POOL_IDLE_TIMEOUT_MS);
+
+    http_client_destroy(a);
+    http_client_destroy(b);
+    waitpid(pid, &status, 0);
+    printf("PASS: pool shares connections per origin\n");
+}
+
+static void test_large_post_body(void) {
+    static char body[300 * 1024];
+    uint16_t port;
+    int status;
+    pid_t pid = start_server(2, 2, MODE_ECHO, &port);
+    struct http_client *client = http_client_create("127.0.0.1", port, false);
+    struct http_response resp;
+    unsigned long sum = 0;
+    char want[64];
+
+    for (size_t i = 0; i < sizeof(body); i++) {
+        body[i] = (char)('A' + i % 23);
+        sum += (unsigned char)body[i];
+    }
+    snprintf(want, sizeof(want), "n%zus%lu", sizeof(body), sum);
+
+    assert(client != NULL);
+    assert(http_post(client, "/big", NULL, 0, body, sizeof(body), &resp) == 0);
+    assert(strcmp(resp.body, want) == 0);
+    expect_body(client, "POST", "n7s520");
+    http_client_destroy(client);
+
+    waitpid(pid, &status, 0);
+    printf("PASS: large request body sent without a size ceiling\n");
+}
+
+struct body_copy {
+    char data[1024];
+    size_t len;
+};
+
+static int copy_body(const char *data, size_t len, void *user_data) {
+    struct body_copy *copy = user_data;
+
+    assert(copy->len + len < sizeof(copy->data));
+    memcpy(copy->data + copy->len, data, len);
+    copy->len += len;
+    return 0;
+}
+
+static void test_gzip_response(void) {
+    char want[1024];
+    size_t want_len = build_gzip_text(want, sizeof(want));
+    struct body_copy copy = {{0}, 0};
+    struct http_pool_stats before;
+    struct http_pool_stats after;
+    uint16_t port;
+    int status;
+    pid_t pid = start_server(2, 2, MODE_GZIP, &port);
+    struct http_client *client = http_client_create("127.0.0.1", port, false);
+    struct http_response resp;
+
+    assert(client != NULL);
+    http_pool_get_stats(&before);
+    assert(http_get(client, "/rest/interface", NULL, 0, &resp) == 0);
+    assert(resp.status_code == 200);
+    assert(resp.body_len == want_len);
+    assert(memcmp(resp.body, want, want_len) == 0 && resp.body[want_len] == '\0');
+
+    /* Streamed and on the same kept-alive connection */
+    assert(http_get_stream(client, "/rest/interface", NULL, 0, copy_body, &copy, &resp) == 0);
+    assert(copy.len == want_len && memcmp(copy.data, want, want_len) == 0);
+    assert(resp.body_len == want_len);
+    http_pool_get_stats(&after);
+    assert(after.reused == before.reused + 1);
+    http_client_destroy(client);
+
+    waitpid(pid, &status, 0);
+    printf("PASS: gzip response inflated\n");
+}
+
+static void run_batch(struct http_client *client, const char **want, int count) {
+    struct body_copy copies[8];
+    struct http_batch_item items[8];
+    const char *paths[] = {"/a", "/b", "/c", "/d", "/e", "/f", "/g", "/h"};
+
+    assert(count <= 8);
+    memset(copies, 0, sizeof(copies));
+    for (int i = 0; i < count; i++) {
+        items[i].path = paths[i];
+        items[i].on_body = copy_body;
+        items[i].user_data = &copies[i];
+    }
+    assert(http_get_batch(client, NULL, 0, items, count) == 0);
+    for (int i = 0; i < count; i++) {
+        assert(items[i].result == 0);
+        assert(items[i].status_code == 200);
+        assert(copies[i].len == strlen(want[i]));
+        assert(memcmp(copies[i].data, want[i], copies[i].len) == 0);
+    }
+}
+
+static void test_pipelined_batch(void) {
+    const char *pipelined[] = {"c1r1", "c1r2", "c1r3", "c1r4"};
+    const char *split[] = {"c1r1", "c1r2", "c2r1", "c2r2", "c3r1"};
+    uint16_t port;
+    int status;
+    pid_t pid;
+    struct http_client *client;
+
+    /* The server only answers once all four requests are in */
+    http_pool_flush();
+    pid = start_server(4, 4, MODE_PIPELINE, &port);
+    client = http_client_create("127.0.0.1", port, false);
+    assert(client != NULL);
+    run_batch(client, pipelined, 4);
+    http_client_destroy(client);
+    http_pool_flush();
+    waitpid(pid, &status, 0);
+
+    /* Server closes after two responses: the rest is sent again */
+    pid = start_server(2, 5, MODE_PLAIN, &port);
+    client = http_client_create("127.0.0.1", port, false);
+    assert(client != NULL);
+    run_batch(client, split, 5);
+    http_client_destroy(client);
+    http_pool_flush();
+    waitpid(pid, &status, 0);
+    printf("PASS: pipelined GET batch answered in order\n");
+}
+
+static void test_many_headers(void) {
+    uint16_t port;
+    int status;
+    pid_t pid = start_server(2, 2, MODE_HEADERS, &port);
+    struct http_client *client = http_client_create("127.0.0.1", port, false);
+    struct http_response resp;
+    int i;
+
+    assert(client != NULL);
+    assert(http_get(client, "/", NULL, 0, &resp) == 0);
+    assert(resp.status_code == 200);
+    assert(strcmp(resp.body, "c1r1") == 0);
+
+    /* Nothing dropped past the old 16-header limit, values trimmed */
+    assert(resp.num_headers == MANY_HEADERS + 6);
+    assert(strcmp(resp.headers[0].name, "X-Header-0") == 0);
+    assert(strcmp(resp.headers[0].value, "value-0") == 0);
+    assert(strcmp(http_response_get_header(&resp, "x-header-39"), "value-39") == 0);
+    assert(strcmp(http_response_get_header(&resp, "X-HEADER-17"), "value-17") == 0);
+    assert(http_response_get_header(&resp, "X-Header-40") == NULL);
+
+    /* First of duplicate names wins; known headers noted during the scan */
+    assert(strcmp(http_response_get_header(&resp, "Set-Cookie"), "a=1") == 0);
+    i = resp.known[HTTP_HDR_RETRY_AFTER];
+    assert(i >= 0 && strcmp(resp.headers[i].value, "7") == 0);
+    i = resp.known[HTTP_HDR_CONTENT_LENGTH];
+    assert(i >= 0 && strcmp(resp.headers[i].name, "CONTENT-length") == 0);
+    assert(resp.known[HTTP_HDR_TRANSFER_ENCODING] == -1);
+
+    /* Framed by the odd-cased Content-Length, so the connection is reused;
+     * list values match whole tokens, not "close" or "gzip" inside one */
+    expect_body(client, "GET", "c1r2");
+    http_client_destroy(client);
+    http_pool_flush();
+    waitpid(pid, &status, 0);
+    printf("PASS: many headers kept and looked up by hash\n");
+}
+
+static void test_request_timing(void) {
+    const char *wire = "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n"
+                       "Content-Length: 4\r\n\r\nc1r1";
+    const uint32_t ran = (1u << HTTP_PHASE_SEND) | (1u << HTTP_PHASE_TTFB) |
+                         (1u << HTTP_PHASE_TRANSFER) | (1u << HTTP_PHASE_TOTAL);
+    const uint32_t connect = (1u << HTTP_PHASE_DNS) | (1u << HTTP_PHASE_CONNECT);
+    struct http_origin_stats origins[HTTP_STATS_MAX_ORIGINS];
+    uint16_t port;
+    int status;
+    int n;
+    pid_t pid = start_server(2, 2, MODE_PLAIN, &port);
+    struct http_client *client = http_client_create("127.0.0.1", port, false);
+    struct http_response resp;
+
+    assert(client != NULL);
+    http_stats_reset();
+
+    assert(http_get(client, "/", NULL, 0, &resp) == 0);
+    assert(resp.timing.done == (ran | connect));
+    assert(!resp.timing.reused);
+    assert(resp.timing.bytes_sent > 0);
+    assert(resp.timing.bytes_received == strlen(wire));
+    assert(resp.timing.us[HTTP_PHASE_TOTAL] >= resp.timing.us[HTTP_PHASE_TTFB]);
+
+    /* Second request rides the kept-alive connection: no connect phases */
+    assert(http_get(client, "/", NULL, 0, &resp) == 0);
+    assert(resp.timing.done == ran);
+    assert(resp.timing.reused);
+    assert(resp.timing.us[HTTP_PHASE_DNS] == 0);
+
+    n = http_stats_get(origins, HTTP_STATS_MAX_ORIGINS);
+    assert(n == 1);
+    assert(strcmp(origins[0].hostname, "127.0.0.1") == 0 && origins[0].port == port);
+    assert(origins[0].requests == 2 && origins[0].reused == 1 && origins[0].errors == 0);
+    assert(origins[0].phases[HTTP_PHASE_CONNECT].count == 1);
+    assert(origins[0].phases[HTTP_PHASE_TTFB].count == 2);
+    assert(origins[0].bytes_received == 2 * strlen(wire));
+
+    http_client_destroy(client);
+    http_pool_flush();
+    waitpid(pid, &status, 0);
+    printf("PASS: request phases timed and accounted per origin\n");
+}
+
+static void test_retry_policy(void) {
+    struct http_retry_policy policy;
+    struct http_response resp;
+    struct body_copy got = {{0}, 0};
+    uint16_t port;
+    int status;
+    pid_t pid = start_server(5, 5, MODE_RETRY, &port);
+    struct http_client *client = http_client_create("127.0.0.1", port, false);
+
+    assert(client != NULL);
+
+    /* GET retries the 503; the busy body never reaches the stream */
+    assert(http_get_stream(client, "/", NULL, 0, copy_body, &got, &resp) == 0);
+    assert(resp.status_code == 200);
+    assert(got.len == 4 && memcmp(got.data, "c1r2", 4) == 0);
+
+    /* POST is not idempotent by default: the 503 comes straight back */
+    assert(http_post(client, "/", NULL, 0, "{}", 2, &resp) == 0);
+    assert(resp.status_code == 503);
+    assert(strcmp(resp.body, "busy") == 0);
+
+    /* ...unless the client opts in */
+    http_retry_get_default(&policy);
+    policy.retry_post = true;
+    http_client_set_retry(client, &policy);
+    assert(http_post(client, "/", NULL, 0, "{}", 2, &resp) == 0);
+    assert(resp.status_code == 200);
+    assert(strcmp(resp.body, "c1r5") == 0);
+
+    http_client_destroy(client);
+    http_pool_flush();
+    waitpid(pid, &status, 0);
+
+    /* A Retry-After past the longest wait is not retried, so the stream
+     * gets the error body */
+    pid = start_server(1, 1, MODE_BUSY, &port);
+    client = http_client_create("127.0.0.1", port, false);
+    assert(client != NULL);
+    got.len = 0;
+    assert(http_get_stream(client, "/", NULL, 0, copy_body, &got, &resp) == 0);
+    assert(resp.status_code == 503);
+    assert(got.len == 4 && memcmp(got.data, "busy", 4) == 0);
+    http_client_destroy(client);
+    http_pool_flush();
+    waitpid(pid, &status, 0);
+    printf("PASS: retry policy honours idempotency and Retry-After\n");
+}
+
+struct async_result {
+    struct body_copy copy;  /* First, so copy_body can stream into it */
+    int result;
+    int status;
+    char body[64];
+    int order;              /* Completion order, from 1 */
+};
+
+static int g_done_seq;
+
+static void record_done(struct http_client *client, int result,
+                        const struct http_response *response, void *user_data) {
+    struct async_result *r = user_data;
+
+    (void)client;
+    r->result = result;
+    r->status = response->status_code;
+    snprintf(r->body, sizeof(r->body), "%s", response->body);
+    r->order = ++g_done_seq;
+}
+
+static void test_async_engine(void) {
+    struct http_engine *engine = http_engine_create();
+    struct http_client *clients[5];
+    struct async_result results[5];
+    uint16_t plain_port;
+    uint16_t chunked_port;
+    uint16_t stall_port;
+    int status;
+    pid_t plain = start_server(1, 2, MODE_PLAIN, &plain_port);
+    pid_t chunked = start_server(1, 1, MODE_CHUNKED, &chunked_port);
+    int stall_fd = listen_loopback(AF_INET, 4, &stall_port);   /* Accepts, never answers */
+
+    assert(engine != NULL && stall_fd >= 0);
+    memset(results, 0, sizeof(results));
+    g_done_seq = 0;
+    clients[0] = http_client_create("127.0.0.1", stall_port, false);
+    clients[1] = http_client_create("127.0.0.1", plain_port, false);
+    clients[2] = http_client_create("127.0.0.1", plain_port, false);
+    clients[3] = http_client_create("127.0.0.1", chunked_port, false);
+    clients[4] = http_client_create("127.0.0.1", stall_port, false);
+
+    /* The stalled origin goes first and must not hold up the others */
+    assert(http_engine_submit(engine, clients[0], "GET", "/", NULL, 0, NULL, 0, 300,
+                              NULL, record_done, &results[0]) == 0);
+    assert(http_engine_submit(engine, clients[1], "GET", "/", NULL, 0, NULL, 0, 0,
+                              NULL, record_done, &results[1]) == 0);
+    assert(http_engine_submit(engine, clients[2], "POST", "/", NULL, 0, "{}", 2, 0,
+                              NULL, record_done, &results[2]) == 0);
+    assert(http_engine_submit(engine, clients[3], "GET", "/", NULL, 0, NULL, 0, 0,
+                              copy_body, record_done, &results[3]) == 0);
+    assert(http_engine_submit(engine, clients[4], "GET", "/", NULL, 0, NULL, 0, 0,
+                              NULL, record_done, &results[4]) == 0);
+    assert(http_engine_submit(engine, clients[1], "GET", "/", NULL, 0, NULL, 0, 0,
+                              NULL, record_done, &results[1]) == HTTP_ERR_BUSY);
+
+    while (http_engine_run(engine, -1) > 2) {
+    }
+    for (int i = 1; i <= 3; i++) {
+        assert(results[i].result == 0 && results[i].status == 200);
+        assert(results[i].order <= 3);
+    }
+    assert(results[1].body[0] == 'c' && strcmp(results[1].body + 2, "r1") == 0);
+    assert(results[2].body[0] == 'c' && strcmp(results[2].body + 2, "r1") == 0);
+    assert(strcmp(results[1].body, results[2].body) != 0);     /* Two connections */
+    assert(results[3].copy.len == 4 && memcmp(results[3].copy.data, "c1r1", 4) == 0);
+    assert(results[3].body[0] == '\0');     /* Streamed, not buffered */
+
+    /* Deadline, then cancellation of the other stalled request */
+    while (http_engine_run(engine, -1) > 1) {
+    }
+    assert(results[0].result == HTTP_ERR_TIMEOUT && results[0].order == 4);
+    http_engine_cancel(clients[4]);
+    assert(results[4].result == HTTP_ERR_ABORTED && results[4].order == 5);
+    assert(http_engine_run(engine, 0) == 0);
+
+    for (int i = 0; i < 5; i++) {
+        http_client_destroy(clients[i]);
+    }
+    http_engine_destroy(engine);
+    http_pool_flush();
+    close(stall_fd);
+    waitpid(plain, &status, 0);
+    waitpid(chunked, &status, 0);
+    printf("PASS: async engine multiplexes origins with per-request deadlines\n");
+}
+
+static void test_pool_active_cap(void) {
+    struct http_engine *engine = http_engine_create();
+    struct http_conn *conns[3];
+    struct http_client *clients[3];
+    struct async_result results[2];
+    struct http_pool_stats stats;
+    struct http_response resp;
+    uint16_t port;
+    int status;
+    pid_t pid;
+
+    /* Leases past the per-origin cap are refused; other origins are not */
+    http_pool_configure(0, 2, 0);
+    conns[0] = http_pool_acquire("127.0.0.1", 9, false);
+    conns[1] = http_pool_acquire("127.0.0.1", 9, false);
+    assert(conns[0] && conns[1]);
+    errno = 0;
+    assert(http_pool_acquire("127.0.0.1", 9, false) == NULL && errno == EBUSY);
+    conns[2] = http_pool_acquire("127.0.0.1", 10, false);
+    assert(conns[2] != NULL);
+    http_pool_get_stats(&stats);
+    assert(stats.leased == 3 && stats.refused >= 1);
+    http_pool_release(conns[0], 0);
+    conns[0] = http_pool_acquire("127.0.0.1", 9, false);
+    assert(conns[0] != NULL);
+    for (int i = 0; i < 3; i++) {
+        http_pool_release(conns[i], 0);
+    }
+    http_pool_flush();
+
+    /* The engine queues past the cap and starts the request on the
+     * connection the first one hands back; blocking calls are refused */
+    http_pool_configure(0, 1, 0);
+    pid = start_server(2, 2, MODE_PLAIN, &port);
+    memset(results, 0, sizeof(results));
+    g_done_seq = 0;
+    for (int i = 0; i < 3; i++) {
+        clients[i] = http_client_create("127.0.0.1", port, false);
+        assert(clients[i] != NULL);
+    }
+    assert(http_engine_submit(engine, clients[0], "GET", "/", NULL, 0, NULL, 0, 0,
+                              NULL, record_done, &results[0]) == 0);
+    assert(http_engine_submit(engine, clients[1], "GET", "/", NULL, 0, NULL, 0, 0,
+                              NULL, record_done, &results[1]) == 0);
+    memset(&resp, 0, sizeof(resp));
+    assert(http_get(clients[2], "/", NULL, 0, &resp) == HTTP_ERR_BUSY);
+
+    while (http_engine_run(engine, -1) > 0) {
+    }
+    assert(results[0].result == 0 && strcmp(results[0].body, "c1r1") == 0);
+    assert(results[1].result == 0 && strcmp(results[1].body, "c1r2") == 0);
+    assert(results[0].order == 1 && results[1].order == 2);
+
+    for (int i = 0; i < 3; i++) {
+        http_client_destroy(clients[i]);
+    }
+    http_engine_destroy(engine);
+    http_pool_flush();
+    http_pool_configure(0, HTTP_POOL_MAX_ACTIVE_PER_HOST, 0);
+    waitpid(pid, &status, 0);
+    printf("PASS: pool caps active connections per origin\n");
+}
+
+/* A connection the server closed must not push a live one out of the pool */
+static void test_pool_keeps_live_idle(void) {
+    struct http_pool_stats before;
+    struct http_pool_stats after;
+    struct http_conn *live;
+    struct http_conn *dead;
+    int fds[2];
+
+    http_pool_flush();
+    http_pool_configure(1, 0, 0);
+    assert(socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    live = http_pool_acquire("127.0.0.1", 9, false);
+    dead = http_pool_acquire("127.0.0.1", 9, false);
+    assert(live && dead && live != dead);
+    live->socket_fd = fds[0];
+    live->connected = 1;
+    http_pool_release(live, 1);
+    http_pool_release(dead, 0);
+
+    http_pool_get_stats(&before);
+    assert(before.idle == 1);
+    assert(http_pool_acquire("127.0.0.1", 9, false) == live);
+    http_pool_get_stats(&after);
+    assert(after.reused == before.reused + 1);
+
+    /* A closed entry makes way for a live one */
+    dead = http_pool_acquire("127.0.0.1", 9, false);
+    http_pool_release(dead, 0);
+    http_pool_release(live, 1);
+    http_pool_get_stats(&after);
+    assert(after.idle == 1);
+    assert(http_pool_acquire("127.0.0.1", 9, false) == live);
+    http_pool_release(live, 0);
+
+    http_pool_flush();
+    close(fds[1]);
+    http_pool_configure(HTTP_POOL_MAX_IDLE_PER_HOST, 0, 0);
+    printf("PASS: pool keeps live idle connections over closed ones\n");
+}
+
+static void test_tls_shared_trust(void) {
+    struct mbedtls_ctx a;
+    struct mbedtls_ctx b;
+
+    http_pool_flush();
+    assert(mbedtls_tls_cleanup() == 0);
+    assert(mbedtls_init(&a, "api.telegram.org") == 0);
+    assert(mbedtls_init(&b, "api.openai.com") == 0);
+    assert(a.conf == b.conf);
+    assert(a.ssl != b.ssl);
+    assert(mbedtls_tls_cleanup() == -1);
+
+    mbedtls_tls_free(&a);
+    assert(mbedtls_tls_cleanup() == -1);
+    mbedtls_tls_free(&b);
+    assert(mbedtls_tls_cleanup() == 0);
+
+    /* Usable again after a cleanup */
+    assert(mbedtls_init(&a, "api.telegram.org") == 0);
+    mbedtls_tls_free(&a);
+    assert(mbedtls_tls_cleanup() == 0);
+    printf("PASS: TLS contexts share one CA chain and config\n");
+}
+
+/* Position of the first suite using the given cipher, or -1 */
+static int first_with_cipher(const int *order, int gcm) {
+    for (int i = 0; order[i] != 0; i++) {
+        const char *name = mbedtls_ssl_get_ciphersuite_name(order[i]);
+        if ((gcm && strstr(name, "-GCM-")) || (!gcm && strstr(name, "CHACHA20"))) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+static void test_tls_cipher_order(void) {
+    const int *all = mbedtls_ssl_list_ciphersuites();
+    const int *order;
+    int n = 0;
+    int gcm;
+    int chacha;
+
+    while (all[n] != 0) n++;
+
+    http_pool_flush();
+    assert(mbedtls_tls_cleanup() == 0);
+    setenv("TLS_CIPHER_PREFERENCE", "chacha", 1);
+    assert(mbedtls_tls_cipher_preference() == TLS_PREFER_CHACHA20);
+    order = mbedtls_tls_ciphersuite_order();
+    assert(order != NULL);
+
+    /* Same suites as the library default, reordered */
+    for (int i = 0; i < n; i++) {
+        int found = 0;
+        for (int j = 0; order[j] != 0; j++) found |= order[j] == all[i];
+        assert(found);
+    }
+    assert(order[n] == 0);
+
+    gcm = first_with_cipher(order, 1);
+    chacha = first_with_cipher(order, 0);
+    assert(chacha == -1 || chacha == 0);
+
+    assert(mbedtls_tls_cleanup() == 0);
+    setenv("TLS_CIPHER_PREFERENCE", "aes", 1);
+    order = mbedtls_tls_ciphersuite_order();
+    assert(mbedtls_tls_cipher_preference() == TLS_PREFER_AES_GCM);
+    assert(gcm == -1 || first_with_cipher(order, 1) == 0);
+
+    assert(mbedtls_tls_cleanup() == 0);
+    unsetenv("TLS_CIPHER_PREFERENCE");
+    printf("PASS: ciphersuites ordered by the preferred AEAD\n");
+}
+
+static void test_tls_max_fragment(void) {
+    http_pool_flush();
+    assert(mbedtls_tls_cleanup() == 0);
+    setenv("TLS_MAX_FRAGMENT", "1024", 1);
+#if defined(MBEDTLS_SSL_MAX_FRAGMENT_LENGTH)
+    assert(mbedtls_tls_max_fragment() == 1024);
+
+    /* Not a TLS fragment length: back to what the input buffer needs */
+    assert(mbedtls_tls_cleanup() == 0);
+    setenv("TLS_MAX_FRAGMENT", "3000", 1);
+    if (MBEDTLS_SSL_IN_CONTENT_LEN >= MBEDTLS_SSL_MAX_CONTENT_LEN) {
+        assert(mbedtls_tls_max_fragment() == 0);
+    } else {
+        assert(mbedtls_tls_max_fragment() <= MBEDTLS_SSL_IN_CONTENT_LEN ||
+               mbedtls_tls_max_fragment() == 512);
+    }
+#else
+    /* Nothing to negotiate with */
+    assert(mbedtls_tls_max_fragment() == 0);
+#endif
+    assert(mbedtls_tls_cleanup() == 0);
+    unsetenv("TLS_MAX_FRAGMENT");
+    printf("PASS: max_fragment_length follows the build and TLS_MAX_FRAGMENT\n");
+}
+
+int main(void) {
+    test_keep_alive_reuses_connection();
+    test_stale_connection_reconnects();
+    test_chunked_response_keeps_alive();
+    test_stream_large_body();
+    test_ipv6_literal();
+    test_connect_deadline();
+    test_pool_shares_connections();
+    test_large_post_body();
+    test_gzip_response();
+    test_pipelined_batch();
+    test_many_headers();
+    test_request_timing();
+    test_retry_policy();
+    test_async_engine();
+    test_pool_active_cap();
+    test_pool_keeps_live_idle();
+    test_tls_shared_trust();
+    test_tls_cipher_order();
+    test_tls_max_fragment();
+
+    printf("ALL PASS: http client\n");
+    return 0;
+}
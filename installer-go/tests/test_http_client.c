@@ -1,30 +1,202 @@
 #include <assert.h>
+#include <signal.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
 
 #include "../src/http_client.h"
 
-int main(void) {
-    curl_http_client *client = curl_http_client_create();
-    assert(client != NULL);
+/* Answer every request on a connection with "c<connection>r<request>" */
+static void serve_conn(int fd, int conn) {
+    char buf[8192];
+    size_t len = 0;
+    int req = 0;
+
+    for (;;) {
+        char *end;
+        const char *cl;
+        size_t want;
+        char resp[128];
+        char body[32];
+
+        buf[len] = '\0';
+        while (!(end = strstr(buf, "\r\n\r\n"))) {
+            ssize_t n = recv(fd, buf + len, sizeof(buf) - len - 1, 0);
+            if (n <= 0) {
+                return;
+            }
+            len += (size_t)n;
+            buf[len] = '\0';
+        }
+        cl = strstr(buf, "Content-Length: ");
+        want = (size_t)(end + 4 - buf) + (cl && cl < end ? (size_t)atoi(cl + 16) : 0);
+        while (len < want) {
+            ssize_t n = recv(fd, buf + len, sizeof(buf) - len - 1, 0);
+            if (n <= 0) {
+                return;
+            }
+            len += (size_t)n;
+        }
+        memmove(buf, buf + want, len - want);
+        len -= want;
+
+        snprintf(body, sizeof(body), "c%dr%d", conn, ++req);
+        snprintf(resp, sizeof(resp),
+                 "HTTP/1.1 200 OK\r\nContent-Type: text/plain\r\n"
+                 "Content-Length: %zu\r\n\r\n%s", strlen(body), body);
+        send(fd, resp, strlen(resp), MSG_NOSIGNAL);
+    }
+}
+
+static pid_t start_server(uint16_t *port) {
+    struct sockaddr_in addr;
+    socklen_t addr_len = sizeof(addr);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    pid_t pid;
+
+    assert(fd >= 0);
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    assert(listen(fd, 8) == 0);
+    assert(getsockname(fd, (struct sockaddr *)&addr, &addr_len) == 0);
+    *port = ntohs(addr.sin_port);
+
+    pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        signal(SIGCHLD, SIG_IGN);
+        for (int conn = 1;; conn++) {
+            int c = accept(fd, NULL, NULL);
+            if (c < 0) {
+                _exit(0);
+            }
+            if (fork() == 0) {
+                close(fd);
+                serve_conn(c, conn);
+                _exit(0);
+            }
+            close(c);
+        }
+    }
+    close(fd);
+    return pid;
+}
 
+struct done_state {
+    int calls;
+    int ok;
+};
+
+static void count_done(int result, curl_http_response *response, void *user_data) {
+    struct done_state *state = user_data;
+
+    state->calls++;
+    if (result == 0 && response->status_code == 200 && response->body &&
+        response->body[0] == 'c') {
+        state->ok++;
+    }
+}
+
+/* Real TLS endpoint, opt-in: TEST_HTTPBIN_URL=https://httpbin.org */
+static void test_tls_smoke(void) {
+    const char *base = getenv("TEST_HTTPBIN_URL");
+    curl_http_client *client;
     curl_http_response response;
-    int ret = curl_http_get(client, "https://httpbin.org/get", &response);
-    assert(ret == 0);
+    char url[256];
+
+    if (!base || base[0] == '\0') {
+        printf("SKIP: set TEST_HTTPBIN_URL to run the TLS GET/POST smoke test\n");
+        return;
+    }
+
+    client = curl_http_client_create();
+    assert(client != NULL);
+
+    snprintf(url, sizeof(url), "%s/get", base);
+    assert(curl_http_get(client, url, &response) == 0);
     assert(response.status_code == 200);
-    assert(response.body != NULL);
-    assert(strstr(response.body, "\"url\"") != NULL);
+    assert(response.body != NULL && strstr(response.body, "\"url\"") != NULL);
     curl_http_response_free(&response);
 
-    ret = curl_http_post(client, "https://httpbin.org/post", "{\"hello\":\"world\"}", &response);
-    assert(ret == 0);
+    snprintf(url, sizeof(url), "%s/post", base);
+    assert(curl_http_post(client, url, "{\"hello\":\"world\"}", &response) == 0);
     assert(response.status_code == 200);
-    assert(response.body != NULL);
-    assert(strstr(response.body, "\"hello\": \"world\"") != NULL);
+    assert(response.body != NULL && strstr(response.body, "\"hello\": \"world\"") != NULL);
+    curl_http_response_free(&response);
+
+    curl_http_client_destroy(client);
+    printf("PASS: GET/POST over TLS\n");
+}
+
+int main(void) {
+    curl_http_client *client;
+    curl_http_response response;
+    struct done_state state = {0, 0};
+    const char *headers[] = { "X-Test: 1" };
+    char url[64];
+    uint16_t port;
+    int status;
+    pid_t pid = start_server(&port);
+
+    test_tls_smoke();
+
+    snprintf(url, sizeof(url), "http://127.0.0.1:%u/", port);
+
+    /* Separate clients share the connection */
+    client = curl_http_client_create();
+    assert(client != NULL);
+    assert(curl_http_post(client, url, "{}", &response) == 0);
+    assert(response.status_code == 200 && strcmp(response.body, "c1r1") == 0);
     curl_http_response_free(&response);
+    curl_http_client_destroy(client);
 
+    client = curl_http_client_create();
+    assert(client != NULL);
+    assert(curl_http_get(client, url, &response) == 0);
+    assert(strcmp(response.body, "c1r2") == 0);
+    curl_http_response_free(&response);
     curl_http_client_destroy(client);
 
-    printf("ALL PASS: http_client create/destroy/get\n");
+    assert(curl_http_request(url, headers, 1, "{\"a\":1}", &response) == 0);
+    assert(strcmp(response.body, "c1r3") == 0);
+    curl_http_response_free(&response);
+    printf("PASS: connections shared across clients\n");
+
+    /* Submitted transfers run side by side and complete from the poll */
+    for (int i = 0; i < 3; i++) {
+        assert(curl_http_submit(url, headers, 1, "{}", count_done, &state) == 0);
+    }
+    while (curl_http_poll(100) > 0) {
+    }
+    assert(state.calls == 3 && state.ok == 3);
+    printf("PASS: submitted transfers complete from the poll\n");
+
+    /* A blocking call also drives transfers in flight */
+    state.calls = state.ok = 0;
+    assert(curl_http_submit(url, NULL, 0, "{}", count_done, &state) == 0);
+    assert(curl_http_request(url, NULL, 0, "{}", &response) == 0);
+    curl_http_response_free(&response);
+    while (curl_http_poll(100) > 0) {
+    }
+    assert(state.calls == 1 && state.ok == 1);
+
+    /* Shutdown reports what is still in flight */
+    state.calls = state.ok = 0;
+    assert(curl_http_submit(url, NULL, 0, "{}", count_done, &state) == 0);
+    curl_http_shutdown();
+    assert(state.calls == 1 && state.ok == 0);
+    assert(curl_http_poll(0) == 0);
+    printf("PASS: blocking calls and shutdown settle submitted transfers\n");
+
+    kill(pid, SIGTERM);
+    waitpid(pid, &status, 0);
+    printf("ALL PASS: curl http client\n");
     return 0;
 }
@@ -0,0 +1,119 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../src/http_stats.h"
+
+static struct http_timing timing(uint32_t ttfb_us, int reused) {
+    struct http_timing t;
+
+    memset(&t, 0, sizeof(t));
+    t.reused = reused;
+    if (!reused) {
+        t.us[HTTP_PHASE_DNS] = 150;
+        t.us[HTTP_PHASE_CONNECT] = 900;
+        t.done |= (1u << HTTP_PHASE_DNS) | (1u << HTTP_PHASE_CONNECT);
+    }
+    t.us[HTTP_PHASE_SEND] = 40;
+    t.us[HTTP_PHASE_TTFB] = ttfb_us;
+    t.us[HTTP_PHASE_TOTAL] = ttfb_us + 1000;
+    t.done |= (1u << HTTP_PHASE_SEND) | (1u << HTTP_PHASE_TTFB) | (1u << HTTP_PHASE_TOTAL);
+    t.bytes_sent = 100;
+    t.bytes_received = 1000;
+    return t;
+}
+
+static void test_per_origin_histograms(void) {
+    struct http_origin_stats out[HTTP_STATS_MAX_ORIGINS];
+    struct http_timing t;
+    const struct http_phase_stats *ttfb;
+
+    http_stats_reset();
+    t = timing(500, 0);
+    http_stats_record("api.example.com", 443, true, &t, 0);
+    for (int i = 0; i < 8; i++) {
+        t = timing(3000, 1);
+        http_stats_record("api.example.com", 443, true, &t, 0);
+    }
+    t = timing(40000, 1);
+    http_stats_record("api.example.com", 443, true, &t, -7);
+    t = timing(200, 0);
+    http_stats_record("router.lan", 443, true, &t, 0);
+
+    assert(http_stats_get(out, HTTP_STATS_MAX_ORIGINS) == 2);
+    assert(strcmp(out[0].hostname, "router.lan") == 0);  /* Most recent first */
+    assert(strcmp(out[1].hostname, "api.example.com") == 0);
+    assert(out[1].requests == 10);
+    assert(out[1].errors == 1);
+    assert(out[1].reused == 9);
+    assert(out[1].bytes_sent == 1000);
+    assert(out[1].bytes_received == 10000);
+
+    /* Connect phases only counted when they ran; TLS never did here */
+    assert(out[1].phases[HTTP_PHASE_DNS].count == 1);
+    assert(out[1].phases[HTTP_PHASE_CONNECT].sum_us == 900);
+    assert(out[1].phases[HTTP_PHASE_TLS].count == 0);
+
+    /* 0.5ms -> <1ms bucket, 3ms -> [2,4), 40ms -> [32,64) */
+    ttfb = &out[1].phases[HTTP_PHASE_TTFB];
+    assert(ttfb->count == 10);
+    assert(ttfb->max_us == 40000);
+    assert(ttfb->buckets[0] == 1);
+    assert(ttfb->buckets[2] == 8);
+    assert(ttfb->buckets[6] == 1);
+    assert(http_stats_percentile_ms(ttfb, 50) == 4);
+    assert(http_stats_percentile_ms(ttfb, 95) == 64);
+    assert(http_stats_percentile_ms(&out[1].phases[HTTP_PHASE_TLS], 50) == 0);
+    printf("PASS: per-origin phase histograms\n");
+}
+
+static void test_lru_eviction(void) {
+    struct http_origin_stats out[HTTP_STATS_MAX_ORIGINS];
+    struct http_timing t = timing(1000, 1);
+    char host[32];
+
+    http_stats_reset();
+    for (int i = 0; i < HTTP_STATS_MAX_ORIGINS; i++) {
+        snprintf(host, sizeof(host), "host%d", i);
+        http_stats_record(host, 80, false, &t, 0);
+    }
+    http_stats_record("host0", 80, false, &t, 0);
+
+    /* host1 is now the least recently used */
+    http_stats_record("new", 80, false, &t, 0);
+    assert(http_stats_get(out, HTTP_STATS_MAX_ORIGINS) == HTTP_STATS_MAX_ORIGINS);
+    for (int i = 0; i < HTTP_STATS_MAX_ORIGINS; i++) {
+        assert(strcmp(out[i].hostname, "host1") != 0);
+    }
+    assert(strcmp(out[0].hostname, "new") == 0);
+    assert(strcmp(out[1].hostname, "host0") == 0);
+    assert(out[1].requests == 2);
+    printf("PASS: least recently used origin evicted\n");
+}
+
+static void test_format_json(void) {
+    char buf[8192];
+    char tiny[32];
+    struct http_timing t = timing(2500, 0);
+
+    http_stats_reset();
+    assert(http_stats_format_json(buf, sizeof(buf)) > 0);
+    assert(strcmp(buf, "{\"origins\":[]}") == 0);
+
+    http_stats_record("api.telegram.org", 443, true, &t, 0);
+    assert(http_stats_format_json(buf, sizeof(buf)) > 0);
+    assert(strstr(buf, "\"origin\":\"https://api.telegram.org:443\"") != NULL);
+    assert(strstr(buf, "\"ttfb\":{\"count\":1,\"avg_us\":2500,\"max_us\":2500,\"p50_ms\":4") != NULL);
+    assert(strstr(buf, "\"tls\":{\"count\":0,") != NULL);
+    assert(http_stats_format_json(tiny, sizeof(tiny)) == -1);
+    assert(strcmp(http_phase_name(HTTP_PHASE_TRANSFER), "transfer") == 0);
+    printf("PASS: JSON report\n");
+}
+
+int main(void) {
+    test_per_origin_histograms();
+    test_lru_eviction();
+    test_format_json();
+    printf("ALL PASS: http stats\n");
+    return 0;
+}
@@ -0,0 +1,197 @@
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "../vendor/inflate.h"
+
+/* Generated with zlib: gzip member with FNAME (dynamic Huffman), zlib
+ * stream of the same text, a stored block, and a bare fixed-Huffman block */
+static const unsigned char gzip_interfaces[] = {
+    0x1f, 0x8b, 0x08, 0x08, 0x00, 0x00, 0x00, 0x00, 0x02, 0x03, 0x69, 0x66,
+    0x61, 0x63, 0x65, 0x2e, 0x6a, 0x73, 0x6f, 0x6e, 0x00, 0xad, 0xd3, 0xbf,
+    0x0a, 0xc2, 0x30, 0x10, 0x06, 0xf0, 0x77, 0xc9, 0x28, 0x45, 0x92, 0xb6,
+    0xe9, 0x1f, 0x37, 0xed, 0x63, 0x88, 0x43, 0x24, 0x51, 0x03, 0x6d, 0x90,
+    0x34, 0x19, 0xa4, 0xf8, 0xee, 0x9e, 0x4b, 0x86, 0x6f, 0xd1, 0xe1, 0xb6,
+    0xfb, 0x6e, 0xf8, 0xf1, 0x71, 0x70, 0xe7, 0x4d, 0xec, 0xbd, 0x15, 0x07,
+    0xb1, 0x53, 0xa2, 0x12, 0xc1, 0x2c, 0x8e, 0x66, 0x97, 0x1e, 0x2e, 0x7e,
+    0x73, 0x7a, 0x3d, 0x4b, 0xa6, 0xb8, 0xa4, 0x4c, 0x49, 0x69, 0x29, 0x29,
+    0xc4, 0x1c, 0x82, 0x0f, 0x77, 0x5a, 0xdc, 0xcc, 0xbc, 0x3a, 0xda, 0x58,
+    0xbf, 0x9a, 0xeb, 0xec, 0x6c, 0x59, 0xbd, 0xab, 0xa2, 0xd7, 0xa0, 0xd7,
+    0x7f, 0xeb, 0x29, 0xe6, 0x5f, 0x78, 0x03, 0x78, 0xc3, 0x89, 0xb7, 0x80,
+    0xb7, 0xac, 0x77, 0xd1, 0xa0, 0x6b, 0xce, 0xea, 0x1d, 0xe0, 0x1d, 0x27,
+    0xde, 0x03, 0xde, 0xb3, 0xde, 0x65, 0x00, 0x7d, 0xe0, 0xac, 0x3e, 0x02,
+    0x3e, 0x72, 0xe2, 0x47, 0xfc, 0x23, 0xc9, 0x7a, 0x98, 0x13, 0xf2, 0x8a,
+    0xb3, 0xfc, 0x84, 0x3a, 0xc3, 0x9f, 0x5e, 0x3e, 0xed, 0x69, 0x46, 0x8b,
+    0x64, 0x04, 0x00, 0x00,
+};
+static const unsigned char zlib_interfaces[] = {
+    0x78, 0xda, 0xad, 0xd3, 0xbf, 0x0a, 0xc2, 0x30, 0x10, 0x06, 0xf0, 0x77,
+    0xc9, 0x28, 0x45, 0x92, 0xb6, 0xe9, 0x1f, 0x37, 0xed, 0x63, 0x88, 0x43,
+    0x24, 0x51, 0x03, 0x6d, 0x90, 0x34, 0x19, 0xa4, 0xf8, 0xee, 0x9e, 0x4b,
+    0x86, 0x6f, 0xd1, 0xe1, 0xb6, 0xfb, 0x6e, 0xf8, 0xf1, 0x71, 0x70, 0xe7,
+    0x4d, 0xec, 0xbd, 0x15, 0x07, 0xb1, 0x53, 0xa2, 0x12, 0xc1, 0x2c, 0x8e,
+    0x66, 0x97, 0x1e, 0x2e, 0x7e, 0x73, 0x7a, 0x3d, 0x4b, 0xa6, 0xb8, 0xa4,
+    0x4c, 0x49, 0x69, 0x29, 0x29, 0xc4, 0x1c, 0x82, 0x0f, 0x77, 0x5a, 0xdc,
+    0xcc, 0xbc, 0x3a, 0xda, 0x58, 0xbf, 0x9a, 0xeb, 0xec, 0x6c, 0x59, 0xbd,
+    0xab, 0xa2, 0xd7, 0xa0, 0xd7, 0x7f, 0xeb, 0x29, 0xe6, 0x5f, 0x78, 0x03,
+    0x78, 0xc3, 0x89, 0xb7, 0x80, 0xb7, 0xac, 0x77, 0xd1, 0xa0, 0x6b, 0xce,
+    0xea, 0x1d, 0xe0, 0x1d, 0x27, 0xde, 0x03, 0xde, 0xb3, 0xde, 0x65, 0x00,
+    0x7d, 0xe0, 0xac, 0x3e, 0x02, 0x3e, 0x72, 0xe2, 0x47, 0xfc, 0x23, 0xc9,
+    0x7a, 0x98, 0x13, 0xf2, 0x8a, 0xb3, 0xfc, 0x84, 0x3a, 0xc3, 0x9f, 0x5e,
+    0x3e, 0x16, 0x4e, 0x50, 0x1e,
+};
+static const unsigned char zlib_stored[] = {
+    0x78, 0x01, 0x01, 0x14, 0x00, 0xeb, 0xff, 0x68, 0x65, 0x6c, 0x6c, 0x6f,
+    0x2c, 0x20, 0x68, 0x65, 0x6c, 0x6c, 0x6f, 0x2c, 0x20, 0x68, 0x65, 0x6c,
+    0x6c, 0x6f, 0x21, 0x4b, 0x1e, 0x06, 0xf6,
+};
+static const unsigned char raw_fixed[] = {
+    0xcb, 0x48, 0xcd, 0xc9, 0xc9, 0xd7, 0x51, 0xc8, 0x40, 0xa2, 0x14, 0x01,
+};
+
+static const char hello[] = "hello, hello, hello!";
+
+static struct inflate_stream stream;
+
+struct collect {
+    char data[4096];
+    size_t len;
+    int calls;
+    int abort_after;    /* Abort on this call (0: never) */
+};
+
+static int collect_out(const unsigned char *data, size_t len, void *user_data) {
+    struct collect *c = user_data;
+
+    c->calls++;
+    if (c->abort_after && c->calls >= c->abort_after) {
+        return -1;
+    }
+    assert(c->len + len < sizeof(c->data));
+    memcpy(c->data + c->len, data, len);
+    c->len += len;
+    return 0;
+}
+
+/* Same text as the vectors: a /rest/interface style listing */
+static size_t build_interfaces(char *buf, size_t size) {
+    size_t n = (size_t)snprintf(buf, size, "[");
+
+    for (int i = 0; i < 12; i++) {
+        n += (size_t)snprintf(buf + n, size - n,
+            "%s{\".id\":\"*%X\",\"name\":\"ether%d\",\"type\":\"ether\","
+            "\"mtu\":\"1500\",\"running\":\"%s\",\"disabled\":\"false\"}",
+            i ? "," : "", i + 1, i + 1, i % 3 ? "true" : "false");
+    }
+    n += (size_t)snprintf(buf + n, size - n, "]");
+    return n;
+}
+
+/* Inflate in pieces of step bytes; returns the last status */
+static int inflate_all(enum inflate_format format, const unsigned char *in, size_t len,
+                       size_t step, struct collect *out) {
+    int rc = INFLATE_OK;
+
+    memset(out, 0, sizeof(*out));
+    inflate_init(&stream, format);
+    for (size_t pos = 0; pos < len && rc == INFLATE_OK; pos += step) {
+        size_t n = len - pos < step ? len - pos : step;
+        rc = inflate_write(&stream, in + pos, n, collect_out, out);
+    }
+    return rc;
+}
+
+static void test_formats(void) {
+    char want[2048];
+    size_t want_len = build_interfaces(want, sizeof(want));
+    struct collect out;
+
+    assert(inflate_all(INFLATE_GZIP, gzip_interfaces, sizeof(gzip_interfaces),
+                       sizeof(gzip_interfaces), &out) == INFLATE_DONE);
+    assert(out.len == want_len && memcmp(out.data, want, want_len) == 0);
+
+    assert(inflate_all(INFLATE_ZLIB, zlib_interfaces, sizeof(zlib_interfaces),
+                       sizeof(zlib_interfaces), &out) == INFLATE_DONE);
+    assert(out.len == want_len && memcmp(out.data, want, want_len) == 0);
+
+    assert(inflate_all(INFLATE_ZLIB, zlib_stored, sizeof(zlib_stored),
+                       sizeof(zlib_stored), &out) == INFLATE_DONE);
+    assert(out.len == strlen(hello) && memcmp(out.data, hello, out.len) == 0);
+
+    assert(inflate_all(INFLATE_RAW, raw_fixed, sizeof(raw_fixed),
+                       sizeof(raw_fixed), &out) == INFLATE_DONE);
+    assert(out.len == strlen(hello) && memcmp(out.data, hello, out.len) == 0);
+
+    /* Servers that send "deflate" without the zlib wrapper */
+    assert(inflate_all(INFLATE_ZLIB, raw_fixed, sizeof(raw_fixed),
+                       sizeof(raw_fixed), &out) == INFLATE_DONE);
+    assert(out.len == strlen(hello) && memcmp(out.data, hello, out.len) == 0);
+    printf("PASS: gzip, zlib, stored, fixed and raw deflate streams\n");
+}
+
+static void test_split_input(void) {
+    char want[2048];
+    size_t want_len = build_interfaces(want, sizeof(want));
+    struct collect out;
+
+    for (size_t step = 1; step <= 17; step += 4) {
+        assert(inflate_all(INFLATE_GZIP, gzip_interfaces, sizeof(gzip_interfaces),
+                           step, &out) == INFLATE_DONE);
+        assert(out.len == want_len && memcmp(out.data, want, want_len) == 0);
+        assert(inflate_all(INFLATE_ZLIB, zlib_stored, sizeof(zlib_stored),
+                           step, &out) == INFLATE_DONE);
+        assert(out.len == strlen(hello));
+    }
+
+    /* Truncated input is not an error, only unfinished */
+    assert(inflate_all(INFLATE_GZIP, gzip_interfaces, sizeof(gzip_interfaces) - 4,
+                       64, &out) == INFLATE_OK);
+    assert(out.len == want_len);
+    printf("PASS: input split at any byte\n");
+}
+
+static void test_corrupt_input(void) {
+    unsigned char bad[sizeof(gzip_interfaces)];
+    struct collect out;
+
+    /* CRC-32 mismatch */
+    memcpy(bad, gzip_interfaces, sizeof(bad));
+    bad[sizeof(bad) - 6] ^= 0x01;
+    assert(inflate_all(INFLATE_GZIP, bad, sizeof(bad), sizeof(bad), &out) == INFLATE_ERR_DATA);
+
+    /* Adler-32 mismatch */
+    memcpy(bad, zlib_interfaces, sizeof(zlib_interfaces));
+    bad[sizeof(zlib_interfaces) - 1] ^= 0x01;
+    assert(inflate_all(INFLATE_ZLIB, bad, sizeof(zlib_interfaces), sizeof(zlib_interfaces),
+                       &out) == INFLATE_ERR_DATA);
+
+    /* Not gzip at all */
+    assert(inflate_all(INFLATE_GZIP, (const unsigned char *)hello, sizeof(hello),
+                       sizeof(hello), &out) == INFLATE_ERR_DATA);
+
+    /* Errors are sticky */
+    assert(inflate_write(&stream, gzip_interfaces, sizeof(gzip_interfaces),
+                         collect_out, &out) == INFLATE_ERR_DATA);
+    printf("PASS: corrupt streams rejected\n");
+}
+
+static void test_sink_abort(void) {
+    struct collect out;
+
+    memset(&out, 0, sizeof(out));
+    out.abort_after = 1;
+    inflate_init(&stream, INFLATE_GZIP);
+    assert(inflate_write(&stream, gzip_interfaces, sizeof(gzip_interfaces),
+                         collect_out, &out) == INFLATE_ERR_ABORT);
+    printf("PASS: output callback can stop the stream\n");
+}
+
+int main(void) {
+    test_formats();
+    test_split_input();
+    test_corrupt_input();
+    test_sink_abort();
+
+    printf("ALL PASS: inflate\n");
+    return 0;
+}
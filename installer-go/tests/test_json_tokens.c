@@ -0,0 +1,235 @@
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "../src/json.h"
+
+#define RECORDS 120
+
+/* A /rest/interface style listing, well past the inline token count */
+static char *interface_listing(size_t *len_out) {
+    size_t cap = RECORDS * 160 + 8;
+    char *buf = malloc(cap);
+    size_t len = 0;
+
+    assert(buf);
+    buf[len++] = '[';
+    for (int i = 0; i < RECORDS; i++) {
+        int n = snprintf(buf + len, cap - len,
+                         "%s{\".id\":\"*%X\",\"name\":\"ether%d\",\"type\":\"ether\","
+                         "\"mtu\":\"1500\",\"running\":\"%s\",\"disabled\":\"false\"}",
+                         i ? "," : "", i + 1, i + 1, (i % 3) ? "true" : "false");
+        assert(n > 0 && (size_t)n < cap - len);
+        len += (size_t)n;
+    }
+    buf[len++] = ']';
+    buf[len] = '\0';
+    *len_out = len;
+    return buf;
+}
+
+static void test_small_stays_inline(void) {
+    struct json_ctx ctx;
+    const char *doc = "{\"content\":\"hello\",\"tokens\":12}";
+
+    json_init(&ctx);
+    assert(json_parse(&ctx, doc, strlen(doc)) == 5);
+    assert(ctx.tokens == ctx.inline_tokens);
+    assert(ctx.heap == NULL);
+    assert(json_get_int(&ctx, "tokens", 0) == 12);
+    json_free(&ctx);
+    printf("PASS: small document parses without allocating\n");
+}
+
+static void test_grows_on_heap(void) {
+    struct json_ctx ctx;
+    struct json_ctx ref;
+    jsmntok_t *big = malloc(4096 * sizeof(*big));
+    size_t len;
+    char *doc = interface_listing(&len);
+    int expect = 1 + RECORDS * 13;
+    int r;
+
+    assert(big);
+    json_init(&ctx);
+    r = json_parse(&ctx, doc, len);
+    assert(r == expect);
+    assert(ctx.tokens == ctx.heap && ctx.cap >= (size_t)expect);
+    assert(ctx.tokens[0].type == JSMN_ARRAY && ctx.tokens[0].end == (int)len);
+
+    /* Resuming across reallocations gives the same tokens as one pass */
+    jsmn_init(&ref.parser);
+    assert(jsmn_parse(&ref.parser, doc, len, big, 4096) == expect);
+    for (int i = 0; i < expect; i++) {
+        assert(ctx.tokens[i].type == big[i].type);
+        assert(ctx.tokens[i].start == big[i].start && ctx.tokens[i].end == big[i].end);
+        assert(ctx.tokens[i].size == big[i].size);
+    }
+    assert(ctx.tokens[0].size == RECORDS);
+
+    /* The grown buffer is kept for the next document */
+    assert(json_parse(&ctx, doc, len) == expect);
+    assert(ctx.tokens == ctx.heap);
+    json_free(&ctx);
+    assert(ctx.heap == NULL && ctx.tokens == ctx.inline_tokens);
+
+    free(big);
+    free(doc);
+    printf("PASS: large listing grows token storage in one parse\n");
+}
+
+static void test_scratch(void) {
+    struct json_ctx ctx;
+    jsmntok_t *scratch = malloc(2048 * sizeof(*scratch));
+    size_t len;
+    char *doc = interface_listing(&len);
+
+    assert(scratch);
+    json_init(&ctx);
+    json_set_scratch(&ctx, scratch, 2048);
+    assert(json_parse(&ctx, doc, len) == 1 + RECORDS * 13);
+    assert(ctx.tokens == scratch);
+    assert(ctx.heap == NULL);
+    json_free(&ctx);
+
+    /* Too small a scratch array is passed over for the heap */
+    json_init(&ctx);
+    json_set_scratch(&ctx, scratch, 300);
+    assert(json_parse(&ctx, doc, len) == 1 + RECORDS * 13);
+    assert(ctx.tokens == ctx.heap);
+    json_free(&ctx);
+
+    free(scratch);
+    free(doc);
+    printf("PASS: caller scratch array used before the heap\n");
+}
+
+static void test_token_reset(void) {
+    struct json_ctx ctx;
+    const char *doc = "{\"a\":{\"b\":[1,2]},\"c\":\"d\"}";
+    const char *cut = "{\"a\":{\"b\":[1,2";
+
+    /* Stale token contents must not leak into a new parse */
+    json_init(&ctx);
+    memset(ctx.inline_tokens, 0, sizeof(ctx.inline_tokens));
+    assert(json_parse(&ctx, doc, strlen(doc)) == 9);
+    assert(ctx.tokens[0].end == (int)strlen(doc));
+    assert(ctx.tokens[2].type == JSMN_OBJECT && ctx.tokens[2].end == 16);
+    assert(ctx.tokens[4].type == JSMN_ARRAY && ctx.tokens[4].end == 15);
+
+    assert(json_parse(&ctx, cut, strlen(cut)) == JSMN_ERROR_PART);
+    json_free(&ctx);
+    printf("PASS: tokens start out reset\n");
+}
+
+static void test_subtree_index(void) {
+    struct json_ctx ctx;
+    const char *doc = "{\"a\":{\"b\":[1,{\"x\":2}]},\"list\":[[1,2],{\"k\":\"v\"},\"s\"],\"c\":\"d\"}";
+    const jsmntok_t *list;
+    const jsmntok_t *elem;
+    const jsmntok_t *c;
+    char out[16];
+
+    json_init(&ctx);
+    assert(json_parse(&ctx, doc, strlen(doc)) == 20);
+    assert(ctx.tokens[0].next == 20);
+    assert(ctx.tokens[2].next == 9);    /* "a" value ends at "list" */
+    assert(ctx.tokens[1].next == 2);
+
+    /* Keys after nested containers are found */
+    c = json_find_key(&ctx, "c");
+    assert(c && json_extract_string(&ctx, c, out, sizeof(out)) == 1 && strcmp(out, "d") == 0);
+    assert(json_find_key(&ctx, "b") == NULL);
+    assert(json_object_get(&ctx, json_find_key(&ctx, "a"), "b")->type == JSMN_ARRAY);
+
+    list = json_find_key(&ctx, "list");
+    assert(json_array_len(&ctx, list) == 3);
+    assert(json_array_get(&ctx, list, 0)->type == JSMN_ARRAY);
+    elem = json_array_get(&ctx, list, 1);
+    assert(elem && elem->type == JSMN_OBJECT);
+    assert(json_extract_string(&ctx, json_object_get(&ctx, elem, "k"), out, sizeof(out)) == 1);
+    assert(strcmp(out, "v") == 0);
+    elem = json_array_get(&ctx, list, 2);
+    assert(elem && elem->type == JSMN_STRING && ctx.data[elem->start] == 's');
+    assert(json_array_get(&ctx, list, 3) == NULL);
+    assert(json_array_get(&ctx, list, -1) == NULL);
+    assert(json_array_get(&ctx, c, 0) == NULL);
+
+    /* Members after a closed container count toward their own parent */
+    assert(json_parse(&ctx, "{\"a\":[1,2],\"b\":3,\"c\":4}", 23) == 9);
+    assert(ctx.tokens[0].size == 3);
+    list = json_find_key(&ctx, "a");
+    assert(json_array_len(&ctx, list) == 2);
+    elem = json_array_get(&ctx, list, 1);
+    assert(elem && ctx.data[elem->start] == '2');
+    assert(json_array_get(&ctx, list, 2) == NULL);
+    assert(json_get_int(&ctx, "c", 0) == 4);
+
+    assert(json_parse(&ctx, "{\"o\":{\"p\":1},\"q\":3,\"r\":4}", 25) == 9);
+    assert(ctx.tokens[0].size == 3);
+    elem = json_find_key(&ctx, "o");
+    assert(elem && elem->size == 1);
+    assert(json_get_int(&ctx, "r", 0) == 4);
+
+    /* Unbalanced closers are rejected */
+    assert(json_parse(&ctx, "{}}", 3) == JSMN_ERROR_INVAL);
+    json_free(&ctx);
+    printf("PASS: subtree index drives key lookup and array access\n");
+}
+
+static void test_iterator(void) {
+    struct json_ctx ctx;
+    struct json_iter it;
+    const jsmntok_t *record;
+    const jsmntok_t *key;
+    const jsmntok_t *value;
+    size_t len;
+    char *doc = interface_listing(&len);
+    char name[32];
+    char want[32];
+    int records = 0;
+    int fields;
+
+    json_init(&ctx);
+    assert(json_parse(&ctx, doc, len) > 0);
+    assert(json_iter_init(&it, &ctx, &ctx.tokens[0]) && !it.object);
+
+    while ((record = json_iter_next(&it, NULL)) != NULL) {
+        struct json_iter rit;
+
+        assert(record->type == JSMN_OBJECT);
+        assert(json_iter_init(&rit, &ctx, record) && rit.object);
+        fields = 0;
+        while ((value = json_iter_next(&rit, &key)) != NULL) {
+            assert(key->type == JSMN_STRING);
+            assert(value->type == JSMN_STRING);
+            fields++;
+        }
+        assert(fields == 6);
+
+        snprintf(want, sizeof(want), "ether%d", records + 1);
+        assert(json_extract_string(&ctx, json_object_get(&ctx, record, "name"),
+                                   name, sizeof(name)) > 0);
+        assert(strcmp(name, want) == 0);
+        records++;
+    }
+    assert(records == RECORDS);
+    assert(json_iter_next(&it, NULL) == NULL);
+
+    assert(!json_iter_init(&it, &ctx, &ctx.tokens[2]));
+    json_free(&ctx);
+    free(doc);
+    printf("PASS: iterator walks RouterOS records\n");
+}
+
+int main(void) {
+    test_small_stays_inline();
+    test_grows_on_heap();
+    test_scratch();
+    test_token_reset();
+    test_subtree_index();
+    test_iterator();
+    printf("ALL PASS: json tokens\n");
+    return 0;
+}
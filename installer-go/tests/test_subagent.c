@@ -4,6 +4,47 @@
 #include <unistd.h>
 
 #include "../src/subagent.h"
+#include "../src/task_handlers.h"
+
+static void test_format_records(void) {
+    const char *list = "[{\".id\":\"*1\",\"name\":\"ether1\",\"running\":true,\"stats\":{\"rx\":1}},"
+                       "{\".id\":\"*2\",\"name\":\"ether2\",\"running\":false}]";
+    const char *one = "{\"uptime\":\"1d\",\"cpu-load\":3}";
+    const char *cut = "[{\"name\":\"ether1\"},{\"name\":\"ether2\"},{\"name\":\"eth";
+    char out[128];
+    char small[48];
+
+    assert(task_format_records(list, strlen(list), out, sizeof(out)) == 2);
+    assert(strcmp(out, ".id=*1 name=ether1 running=true\n"
+                       ".id=*2 name=ether2 running=false\n") == 0);
+
+    assert(task_format_records(one, strlen(one), out, sizeof(out)) == 1);
+    assert(strcmp(out, "uptime=1d cpu-load=3\n") == 0);
+
+    /* Only whole records are kept */
+    assert(task_format_records(list, strlen(list), small, sizeof(small)) == 1);
+    assert(strcmp(small, ".id=*1 name=ether1 running=true\n(1 more)\n") == 0);
+
+    /* A record wider than the share falls back to the raw reply */
+    assert(task_format_records(one, strlen(one), small, 16) == 0);
+    assert(strcmp(small, "{\"uptime\":\"1d\",") == 0);
+    assert(task_format_records(list, strlen(list), small, 24) == 0);
+    assert(strncmp(small, "[{\".id\":\"*1\"", 12) == 0 && strlen(small) == 23);
+
+    /* A listing cut off by the reply buffer keeps its whole records */
+    assert(task_format_records(cut, strlen(cut), out, sizeof(out)) == 2);
+    assert(strcmp(out, "name=ether1\nname=ether2\n(reply truncated)\n") == 0);
+    assert(task_format_records(cut, strlen(cut), small, sizeof(small)) == 2);
+    assert(strcmp(small, "name=ether1\nname=ether2\n(reply truncated)\n") == 0);
+    /* The note is dropped rather than cut when it does not fit */
+    assert(task_format_records(cut, strlen(cut), small, 40) == 2);
+    assert(strcmp(small, "name=ether1\nname=ether2\n") == 0);
+
+    assert(task_format_records("[]", 2, out, sizeof(out)) == 0 && out[0] == '\0');
+    assert(task_format_records("[{\"a\":", 7, out, sizeof(out)) == -1);
+    assert(task_format_records("\"text\"", 6, out, sizeof(out)) == -1);
+    assert(strcmp(out, "\"text\"") == 0);
+}
 
 int main(void) {
     struct subagent_ctx *ctx = subagent_init(2, 8);
@@ -11,6 +52,8 @@ int main(void) {
     char out[4096];
     int i;
 
+    test_format_records();
+
     assert(ctx != NULL);
     assert(subagent_submit(ctx, "analyze", "{\"target\":\"ether1\"}", id, sizeof(id)) == 0);
     assert(id[0] != '\0');
@@ -0,0 +1,432 @@
+/*
+ * TLS client tests against a local `openssl s_server` with a throwaway
+ * self-signed certificate for localhost, trusted through SSL_CERT_FILE or
+ * through a public-key pin. Skipped when no openssl binary is available.
+ */
+
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+#include "../src/http.h"
+#include "../src/http_pool.h"
+#include "../src/http_stats.h"
+#include "../vendor/mbedtls_integration.h"
+
+static char g_dir[] = "/tmp/mikroclaw-tls-XXXXXX";
+static char g_cert[64];
+static char g_key[64];
+
+static int make_cert(void) {
+    char cmd[512];
+
+    snprintf(g_cert, sizeof(g_cert), "%s/cert.pem", g_dir);
+    snprintf(g_key, sizeof(g_key), "%s/key.pem", g_dir);
+    snprintf(cmd, sizeof(cmd),
+             "openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:prime256v1 -nodes "
+             "-keyout %s -out %s -days 2 -subj /CN=localhost "
+             "-addext subjectAltName=DNS:localhost >/dev/null 2>&1", g_key, g_cert);
+    return system(cmd) == 0 ? 0 : -1;
+}
+
+static uint16_t free_port(void) {
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert(bind(fd, (struct sockaddr *)&addr, sizeof(addr)) == 0);
+    assert(getsockname(fd, (struct sockaddr *)&addr, &len) == 0);
+    close(fd);
+    return ntohs(addr.sin_port);
+}
+
+static int tcp_connect(uint16_t port) {
+    struct sockaddr_in addr;
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port = htons(port);
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/* A test CA, and a leaf it issues for name (cert/key under g_dir) */
+static int make_ca(void) {
+    char cmd[512];
+
+    snprintf(cmd, sizeof(cmd),
+             "openssl req -x509 -newkey ec -pkeyopt ec_paramgen_curve:prime256v1 -nodes "
+             "-keyout %s/ca.key -out %s/ca.pem -days 2 -subj '/CN=MikroClaw Test CA' "
+             "-addext basicConstraints=critical,CA:TRUE "
+             "-addext keyUsage=critical,keyCertSign >/dev/null 2>&1", g_dir, g_dir);
+    return system(cmd) == 0 ? 0 : -1;
+}
+
+static int make_leaf(const char *name) {
+    char cmd[1024];
+
+    snprintf(cmd, sizeof(cmd),
+             "cd %s && printf 'subjectAltName=DNS:%s\\n' > %s.ext && "
+             "openssl req -newkey ec -pkeyopt ec_paramgen_curve:prime256v1 -nodes "
+             "-keyout %s.key -out %s.csr -subj /CN=%s >/dev/null 2>&1 && "
+             "openssl x509 -req -in %s.csr -CA ca.pem -CAkey ca.key -CAcreateserial "
+             "-days 2 -extfile %s.ext -out %s.pem >/dev/null 2>&1",
+             g_dir, name, name, name, name, name, name, name, name);
+    return system(cmd) == 0 ? 0 : -1;
+}
+
+/* openssl s_server -www: answers each GET with a status page describing the
+ * session ("New, ..." or "Reused, ...") and closes the connection. chain,
+ * if set, is sent after the certificate. */
+static pid_t start_server_with(uint16_t port, const char *cert, const char *key,
+                               const char *chain) {
+    char accept_arg[32];
+    pid_t pid;
+
+    snprintf(accept_arg, sizeof(accept_arg), "127.0.0.1:%u", port);
+    pid = fork();
+    assert(pid >= 0);
+    if (pid == 0) {
+        int null_fd = open("/dev/null", O_WRONLY);
+        dup2(null_fd, STDOUT_FILENO);
+        dup2(null_fd, STDERR_FILENO);
+        if (chain) {
+            execlp("openssl", "openssl", "s_server", "-quiet", "-www",
+                   "-accept", accept_arg, "-cert", cert, "-key", key,
+                   "-cert_chain", chain, (char *)NULL);
+        } else {
+            execlp("openssl", "openssl", "s_server", "-quiet", "-www",
+                   "-accept", accept_arg, "-cert", cert, "-key", key, (char *)NULL);
+        }
+        _exit(127);
+    }
+
+    /* Wait for the listener */
+    for (int i = 0; i < 100; i++) {
+        int fd = tcp_connect(port);
+        if (fd >= 0) {
+            close(fd);
+            return pid;
+        }
+        usleep(50000);
+    }
+    kill(pid, SIGTERM);
+    waitpid(pid, NULL, 0);
+    return -1;
+}
+
+static pid_t start_server(uint16_t port) {
+    return start_server_with(port, g_cert, g_key, NULL);
+}
+
+static void stop_server(pid_t pid) {
+    int status;
+
+    http_pool_flush();
+    kill(pid, SIGTERM);
+    waitpid(pid, &status, 0);
+}
+
+static void test_session_resumption(uint16_t port) {
+    struct http_client *client = http_client_create("localhost", port, true);
+    struct http_origin_stats origins[HTTP_STATS_MAX_ORIGINS];
+    struct tls_session_stats before;
+    struct tls_session_stats after;
+    struct http_response resp;
+    int n;
+
+    assert(client != NULL);
+    mbedtls_tls_session_stats(&before);
+
+    /* Full handshake; the server closes after the reply */
+    assert(http_get(client, "/", NULL, 0, &resp) == 0);
+    assert(resp.status_code == 200);
+    assert(strstr(resp.body, "New, ") != NULL);
+    assert(resp.timing.done & (1u << HTTP_PHASE_TLS));
+    assert(!resp.timing.tls_resumed);
+
+    /* The reconnect offers the cached session */
+    assert(http_get(client, "/", NULL, 0, &resp) == 0);
+    assert(strstr(resp.body, "Reused, ") != NULL);
+    assert(resp.timing.tls_resumed);
+
+    /* A flushed cache means a full handshake again */
+    mbedtls_tls_session_flush();
+    assert(http_get(client, "/", NULL, 0, &resp) == 0);
+    assert(strstr(resp.body, "New, ") != NULL);
+    assert(!resp.timing.tls_resumed);
+
+    mbedtls_tls_session_stats(&after);
+    assert(after.handshakes - before.handshakes == 3);
+    assert(after.offered - before.offered == 1);
+    assert(after.resumed - before.resumed == 1);
+
+    n = http_stats_get(origins, HTTP_STATS_MAX_ORIGINS);
+    assert(n >= 1);
+    assert(strcmp(origins[0].hostname, "localhost") == 0);
+    assert(origins[0].tls_resumed == 1);
+    assert(origins[0].phases[HTTP_PHASE_TLS].count == 3);
+
+    http_client_destroy(client);
+    printf("PASS: reconnects resume the cached TLS session\n");
+}
+
+/* Block until the socket is ready the way the TLS layer asked */
+static void wait_want(int fd, int want) {
+    struct pollfd pfd = { fd, want == TLS_WANT_READ ? POLLIN : POLLOUT, 0 };
+
+    assert(want == TLS_WANT_READ || want == TLS_WANT_WRITE);
+    assert(poll(&pfd, 1, 5000) == 1);
+}
+
+static void test_nonblocking_io(uint16_t port) {
+    const char *req = "GET / HTTP/1.0\r\n\r\n";
+    struct mbedtls_ctx ctx;
+    char body[16384];
+    size_t got = 0;
+    int waits = 0;
+    int step;
+    int fd = tcp_connect(port);
+
+    assert(fd >= 0);
+    assert(fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK) == 0);
+    mbedtls_tls_session_flush();
+    assert(mbedtls_init(&ctx, "localhost") == 0);
+    assert(mbedtls_connect_socket(&ctx, fd) == 0);
+    assert(mbedtls_tls_want(&ctx) == 0);
+
+    /* A full handshake cannot finish without waiting for the server */
+    while ((step = mbedtls_handshake_step(&ctx)) != 0) {
+        assert(step == TLS_WANT_READ || step == TLS_WANT_WRITE);
+        assert(mbedtls_tls_want(&ctx) == step);
+        wait_want(fd, step);
+        waits++;
+    }
+    assert(waits > 0);
+    assert(mbedtls_tls_want(&ctx) == 0);
+
+    while (mbedtls_send(&ctx, req, strlen(req)) < 0) {
+        assert(errno == EAGAIN);
+        wait_want(fd, mbedtls_tls_want(&ctx));
+    }
+
+    for (;;) {
+        int n = mbedtls_recv(&ctx, body + got, sizeof(body) - 1 - got);
+        if (n == 0) break;
+        if (n < 0) {
+            assert(errno == EAGAIN);
+            assert(mbedtls_tls_pending(&ctx) == 0);
+            wait_want(fd, mbedtls_tls_want(&ctx));
+            continue;
+        }
+        got += (size_t)n;
+        assert(got < sizeof(body) - 1);
+    }
+    body[got] = '\0';
+    assert(strncmp(body, "HTTP/1.0 200", 12) == 0);
+    assert(strstr(body, "New, ") != NULL);
+
+    mbedtls_tls_close(&ctx);
+    mbedtls_tls_free(&ctx);
+    close(fd);
+    printf("PASS: handshake and I/O report want-read/want-write on a non-blocking socket\n");
+}
+
+struct engine_result {
+    int done;
+    int result;
+    int status;
+    int resumed;
+};
+
+static void engine_done(struct http_client *client, int result,
+                        const struct http_response *response, void *user_data) {
+    struct engine_result *r = user_data;
+
+    (void)client;
+    r->done = 1;
+    r->result = result;
+    r->status = response ? response->status_code : 0;
+    r->resumed = response ? response->timing.tls_resumed : 0;
+}
+
+static void test_engine_tls(uint16_t port) {
+    struct http_engine *engine = http_engine_create();
+    struct http_client *clients[3];
+    struct engine_result results[3];
+
+    assert(engine != NULL);
+    memset(results, 0, sizeof(results));
+    for (int i = 0; i < 3; i++) {
+        clients[i] = http_client_create("localhost", port, true);
+        assert(clients[i] != NULL);
+        assert(http_engine_submit(engine, clients[i], "GET", "/", NULL, 0, NULL, 0, 5000,
+                                  NULL, engine_done, &results[i]) == 0);
+    }
+    while (http_engine_run(engine, -1) > 0) {
+    }
+    for (int i = 0; i < 3; i++) {
+        assert(results[i].done && results[i].result == 0 && results[i].status == 200);
+        http_client_destroy(clients[i]);
+    }
+    http_engine_destroy(engine);
+    http_pool_flush();
+    printf("PASS: async engine multiplexes TLS connections\n");
+}
+
+/* sha256/<base64> of the certificate's SubjectPublicKeyInfo */
+static void spki_pin(const char *cert, char *out, size_t out_len) {
+    char cmd[512];
+    char b64[64] = {0};
+    FILE *fp;
+
+    snprintf(cmd, sizeof(cmd),
+             "openssl x509 -in %s -pubkey -noout | openssl pkey -pubin -outform DER | "
+             "openssl dgst -sha256 -binary | openssl base64", cert);
+    fp = popen(cmd, "r");
+    assert(fp != NULL);
+    assert(fgets(b64, sizeof(b64), fp) != NULL);
+    pclose(fp);
+    b64[strcspn(b64, "\r\n")] = '\0';
+    snprintf(out, out_len, "sha256/%s", b64);
+}
+
+static int get_once(const char *host, uint16_t port) {
+    struct http_client *client = http_client_create(host, port, true);
+    struct http_response resp;
+    int rc;
+
+    assert(client != NULL);
+    rc = http_get(client, "/", NULL, 0, &resp);
+    if (rc == 0 && resp.status_code != 200) {
+        rc = -1;
+    }
+    http_client_destroy(client);
+    return rc;
+}
+
+static void test_pinning(uint16_t port) {
+    char pin[96];
+    char spec[256];
+    struct http_retry_policy saved;
+    struct http_retry_policy once = {1, 0, 0, false};
+
+    /* Reload the trust store without the test certificate */
+    http_pool_flush();
+    assert(mbedtls_tls_cleanup() == 0);
+    setenv("SSL_CERT_FILE", "", 1);
+    http_retry_get_default(&saved);
+    http_retry_set_default(&once);
+    spki_pin(g_cert, pin, sizeof(pin));
+
+    assert(get_once("localhost", port) != 0);
+    printf("PASS: self-signed certificate rejected without a pin\n");
+
+    assert(mbedtls_tls_pin("localhost", "sha256/AAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAAA=") == 0);
+    assert(get_once("localhost", port) != 0);
+    printf("PASS: certificate rejected on a pin mismatch\n");
+
+    mbedtls_tls_pins_clear();
+    assert(mbedtls_tls_pin("localhost", "sha256/not-base64") == -1);
+    assert(mbedtls_tls_pin("localhost", "c2hvcnQ=") == -1);
+    assert(mbedtls_tls_pin_list("localhost") == -1);
+
+    /* A pin on the leaf's own key stands in for the CA store and for the
+     * name check: the certificate only names localhost */
+    snprintf(spec, sizeof(spec), "localhost=%s;127.0.0.1=%s", pin, pin + 7);
+    assert(mbedtls_tls_pin_list(spec) == 2);
+    assert(get_once("localhost", port) == 0);
+    assert(get_once("127.0.0.1", port) == 0);
+    printf("PASS: pinned public key verifies a self-signed certificate\n");
+
+    mbedtls_tls_pins_clear();
+    http_retry_set_default(&saved);
+}
+
+/* A pinned CA replaces the CA store but not the hostname check */
+static void test_ca_pinning(void) {
+    char pin[96];
+    char path[3][96];
+    struct http_retry_policy saved;
+    struct http_retry_policy once = {1, 0, 0, false};
+    uint16_t port = free_port();
+    pid_t server;
+
+    assert(make_ca() == 0);
+    assert(make_leaf("localhost") == 0);
+    assert(make_leaf("other.example") == 0);
+    snprintf(path[0], sizeof(path[0]), "%s/ca.pem", g_dir);
+    spki_pin(path[0], pin, sizeof(pin));
+    http_retry_get_default(&saved);
+    http_retry_set_default(&once);
+    assert(mbedtls_tls_pin("localhost", pin) == 0);
+
+    snprintf(path[1], sizeof(path[1]), "%s/localhost.pem", g_dir);
+    snprintf(path[2], sizeof(path[2]), "%s/localhost.key", g_dir);
+    server = start_server_with(port, path[1], path[2], path[0]);
+    assert(server > 0);
+    assert(get_once("localhost", port) == 0);
+    stop_server(server);
+    printf("PASS: pinned CA verifies a leaf issued for the host\n");
+
+    snprintf(path[1], sizeof(path[1]), "%s/other.example.pem", g_dir);
+    snprintf(path[2], sizeof(path[2]), "%s/other.example.key", g_dir);
+    server = start_server_with(port, path[1], path[2], path[0]);
+    assert(server > 0);
+    assert(get_once("localhost", port) != 0);
+    stop_server(server);
+    printf("PASS: pinned CA does not vouch for a leaf issued for another name\n");
+
+    mbedtls_tls_pins_clear();
+    http_retry_set_default(&saved);
+}
+
+int main(void) {
+    char cmd[128];
+    uint16_t port;
+    pid_t server;
+
+    if (system("command -v openssl >/dev/null 2>&1") != 0) {
+        printf("SKIP: openssl not available\n");
+        printf("ALL PASS: tls local\n");
+        return 0;
+    }
+    assert(mkdtemp(g_dir) != NULL);
+    assert(make_cert() == 0);
+    setenv("SSL_CERT_FILE", g_cert, 1);
+
+    port = free_port();
+    server = start_server(port);
+    assert(server > 0);
+
+    test_session_resumption(port);
+    test_nonblocking_io(port);
+    test_engine_tls(port);
+    test_pinning(port);
+
+    stop_server(server);
+    test_ca_pinning();
+    assert(mbedtls_tls_cleanup() == 0);
+    snprintf(cmd, sizeof(cmd), "rm -rf %s", g_dir);
+    assert(system(cmd) == 0);
+    printf("ALL PASS: tls local\n");
+    return 0;
+}
@@ -0,0 +1,80 @@
+#!/bin/bash
+# Generate a C header of DER trust anchors for TLS_EMBEDDED_ANCHORS.
+# Usage: gen-ca-anchors.sh <pem-bundle> <cn-list> <out.h>
+set -euo pipefail
+
+BUNDLE="${1:?usage: $0 <pem-bundle> <cn-list> <out.h>}"
+LIST="${2:?usage: $0 <pem-bundle> <cn-list> <out.h>}"
+OUT="${3:?usage: $0 <pem-bundle> <cn-list> <out.h>}"
+
+command -v openssl >/dev/null 2>&1 || { echo "Error: openssl not found"; exit 1; }
+
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "$WORK_DIR"' EXIT
+
+# One PEM file per certificate
+awk -v dir="$WORK_DIR" '
+    /-----BEGIN CERTIFICATE-----/ { n++; file = sprintf("%s/cert-%04d.pem", dir, n) }
+    file { print > file }
+    /-----END CERTIFICATE-----/ { close(file); file = "" }
+' "$BUNDLE"
+
+mkdir -p "$(dirname "$OUT")"
+TMP_OUT="$OUT.tmp"
+{
+    echo "/* Generated by scripts/gen-ca-anchors.sh from $(basename "$BUNDLE") - do not edit */"
+    echo ""
+} > "$TMP_OUT"
+
+count=0
+names=()
+while IFS= read -r cn || [ -n "$cn" ]; do
+    cn="${cn%%#*}"
+    cn="$(echo "$cn" | sed -e 's/^[[:space:]]*//' -e 's/[[:space:]]*$//')"
+    [ -z "$cn" ] && continue
+
+    found=""
+    for pem in "$WORK_DIR"/cert-*.pem; do
+        subject="$(openssl x509 -in "$pem" -noout -subject -nameopt multiline 2>/dev/null |
+                   sed -n 's/^[[:space:]]*commonName[[:space:]]*= //p')"
+        if [ "$subject" = "$cn" ]; then
+            found="$pem"
+            break
+        fi
+    done
+    if [ -z "$found" ]; then
+        echo "Warning: '$cn' not in $BUNDLE, skipped" >&2
+        continue
+    fi
+
+    {
+        echo "/* $cn */"
+        echo "static const unsigned char ca_anchor_$count[] = {"
+        openssl x509 -in "$found" -outform DER | od -An -tx1 -v |
+            sed -e 's/[[:space:]]*$//' -e 's/ \([0-9a-f][0-9a-f]\)/0x\1, /g' -e 's/, $/,/' -e 's/^/    /'
+        echo "};"
+        echo ""
+    } >> "$TMP_OUT"
+    names+=("ca_anchor_$count")
+    count=$((count + 1))
+done < "$LIST"
+
+if [ "$count" -eq 0 ]; then
+    rm -f "$TMP_OUT"
+    echo "Error: no anchors from $LIST found in $BUNDLE"
+    exit 1
+fi
+
+{
+    echo "static const struct {"
+    echo "    const unsigned char *der;"
+    echo "    size_t len;"
+    echo "} ca_anchors[] = {"
+    for name in "${names[@]}"; do
+        echo "    { $name, sizeof($name) },"
+    done
+    echo "};"
+} >> "$TMP_OUT"
+
+mv "$TMP_OUT" "$OUT"
+echo "Embedded $count trust anchors in $OUT"
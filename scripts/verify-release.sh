@@ -23,6 +23,13 @@ test_fail() {
     ERRORS=$((ERRORS + 1))
 }
 
+# The native HTTP client and the modules it links against, as in the Makefile
+HTTP_SRCS="$(sed -n 's/^HTTP_SRCS = //p' Makefile)"
+if [ -z "$HTTP_SRCS" ]; then
+    echo "HTTP_SRCS not found in Makefile"
+    exit 1
+fi
+
 build_test_binary() {
     local out="$1"
     shift
@@ -64,34 +71,34 @@ else
     test_fail "size is $SIZE bytes"
 fi
 
-build_test_binary tests/test_tls_verify tests/test_tls_verify.c vendor/mbedtls_integration.c src/http.c src/json.c vendor/jsmn.c -lmbedtls -lmbedx509 -lmbedcrypto
+build_test_binary tests/test_tls_verify tests/test_tls_verify.c vendor/mbedtls_integration.c src/csprng.c $HTTP_SRCS src/json.c vendor/jsmn.c -lmbedtls -lmbedx509 -lmbedcrypto
 build_test_binary tests/test_base64 tests/test_base64.c src/base64.c
-build_test_binary tests/test_routeros_auth tests/test_routeros_auth.c src/routeros.c src/base64.c src/http.c src/json.c vendor/jsmn.c vendor/mbedtls_integration.c -lmbedtls -lmbedx509 -lmbedcrypto
-build_test_binary tests/test_json_hardening tests/test_json_hardening.c src/channels/telegram.c src/channels/allowlist.c src/cron.c src/routeros.c src/base64.c src/http.c src/json.c vendor/jsmn.c vendor/mbedtls_integration.c -lmbedtls -lmbedx509 -lmbedcrypto
-build_test_binary tests/test_telegram_parse tests/test_telegram_parse.c src/channels/telegram.c src/channels/allowlist.c src/routeros.c src/base64.c src/http.c src/json.c vendor/jsmn.c vendor/mbedtls_integration.c -lmbedtls -lmbedx509 -lmbedcrypto
+build_test_binary tests/test_routeros_auth tests/test_routeros_auth.c src/routeros.c src/base64.c $HTTP_SRCS src/json.c vendor/jsmn.c vendor/mbedtls_integration.c src/csprng.c -lmbedtls -lmbedx509 -lmbedcrypto
+build_test_binary tests/test_json_hardening tests/test_json_hardening.c src/channels/telegram.c src/channels/allowlist.c src/cron.c src/routeros.c src/base64.c $HTTP_SRCS src/json.c vendor/jsmn.c vendor/mbedtls_integration.c src/csprng.c -lmbedtls -lmbedx509 -lmbedcrypto
+build_test_binary tests/test_telegram_parse tests/test_telegram_parse.c src/channels/telegram.c src/channels/allowlist.c src/routeros.c src/base64.c $HTTP_SRCS src/json.c vendor/jsmn.c vendor/mbedtls_integration.c src/csprng.c -lmbedtls -lmbedx509 -lmbedcrypto
 build_test_binary tests/test_storage_local_path tests/test_storage_local_path.c src/storage_local.c
 build_test_binary tests/test_discord tests/test_discord.c src/channels/discord.c src/channels/allowlist.c src/http_client.c src/json.c vendor/jsmn.c -lcurl
 build_test_binary tests/test_slack tests/test_slack.c src/channels/slack.c src/channels/allowlist.c src/http_client.c src/json.c vendor/jsmn.c -lcurl
 build_test_binary tests/test_discord_inbound tests/test_discord_inbound.c src/channels/discord.c src/channels/allowlist.c src/http_client.c src/json.c vendor/jsmn.c -lcurl
 build_test_binary tests/test_slack_inbound tests/test_slack_inbound.c src/channels/slack.c src/channels/allowlist.c src/http_client.c src/json.c vendor/jsmn.c -lcurl
-build_test_binary tests/test_functions tests/test_functions.c src/functions.c src/buf.c src/memu_client.c src/routeros.c src/http.c src/http_client.c src/json.c src/base64.c src/channels/allowlist.c src/llm_stream.c src/provider_registry.c vendor/jsmn.c vendor/mbedtls_integration.c -lcurl -lmbedtls -lmbedx509 -lmbedcrypto
-build_test_binary tests/test_memu_client tests/test_memu_client.c src/memu_client.c src/json.c vendor/jsmn.c -lcurl
-build_test_binary tests/test_config_memu tests/test_config_memu.c src/config_memu.c src/memu_client.c src/json.c vendor/jsmn.c -lcurl
-build_test_binary tests/test_gateway_auth tests/test_gateway_auth.c src/gateway_auth.c -lmbedtls -lmbedx509 -lmbedcrypto
+build_test_binary tests/test_functions tests/test_functions.c src/functions.c src/buf.c src/memu_client.c src/routeros.c $HTTP_SRCS src/http_client.c src/json.c src/base64.c src/channels/allowlist.c src/llm_stream.c src/provider_registry.c vendor/jsmn.c vendor/mbedtls_integration.c src/csprng.c -lcurl -lmbedtls -lmbedx509 -lmbedcrypto
+build_test_binary tests/test_memu_client tests/test_memu_client.c src/memu_client.c src/http_client.c src/json.c vendor/jsmn.c -lcurl
+build_test_binary tests/test_config_memu tests/test_config_memu.c src/config_memu.c src/memu_client.c src/http_client.c src/json.c vendor/jsmn.c -lcurl
+build_test_binary tests/test_gateway_auth tests/test_gateway_auth.c src/gateway_auth.c vendor/mbedtls_integration.c src/csprng.c -lmbedtls -lmbedx509 -lmbedcrypto
 build_test_binary tests/test_rate_limit tests/test_rate_limit.c src/rate_limit.c
-build_test_binary tests/test_gateway_port tests/test_gateway_port.c src/gateway.c
+build_test_binary tests/test_gateway_port tests/test_gateway_port.c src/gateway.c vendor/mbedtls_integration.c src/csprng.c -lmbedtls -lmbedx509 -lmbedcrypto
 build_test_binary tests/test_task_queue tests/test_task_queue.c src/task_queue.c
-build_test_binary tests/test_subagent tests/test_subagent.c src/subagent.c src/worker_pool.c src/task_queue.c src/task_handlers.c src/tasks/investigate.c src/tasks/analyze.c src/tasks/summarize.c src/tasks/skill_invoke.c src/memu_client_stub.c src/routeros.c src/llm.c src/llm_stream.c src/provider_registry.c src/http.c src/json.c src/base64.c vendor/jsmn.c vendor/mbedtls_integration.c -lmbedtls -lmbedx509 -lmbedcrypto
+build_test_binary tests/test_subagent tests/test_subagent.c src/subagent.c src/worker_pool.c src/task_queue.c src/task_handlers.c src/tasks/investigate.c src/tasks/analyze.c src/tasks/summarize.c src/tasks/skill_invoke.c src/memu_client_stub.c src/routeros.c src/llm.c src/llm_stream.c src/provider_registry.c $HTTP_SRCS src/json.c src/base64.c vendor/jsmn.c vendor/mbedtls_integration.c src/csprng.c -lmbedtls -lmbedx509 -lmbedcrypto
 build_test_binary tests/test_cli tests/test_cli.c src/cli.c
 build_test_binary tests/test_config_validate tests/test_config_validate.c src/config_validate.c
-build_test_binary tests/test_crypto tests/test_crypto.c src/crypto.c -lmbedtls -lmbedx509 -lmbedcrypto
-build_test_binary tests/test_identity tests/test_identity.c src/identity.c src/memu_client.c src/json.c src/http_client.c vendor/jsmn.c -lcurl -lmbedtls -lmbedx509 -lmbedcrypto
+build_test_binary tests/test_crypto tests/test_crypto.c src/crypto.c src/csprng.c -lmbedtls -lmbedx509 -lmbedcrypto
+build_test_binary tests/test_identity tests/test_identity.c src/identity.c src/memu_client.c src/json.c src/http_client.c src/base64.c vendor/jsmn.c vendor/mbedtls_integration.c src/csprng.c -lcurl -lmbedtls -lmbedx509 -lmbedcrypto
 build_test_binary tests/test_channel_supervisor tests/test_channel_supervisor.c src/channel_supervisor.c
 build_test_binary tests/test_provider_registry tests/test_provider_registry.c src/provider_registry.c
 build_test_binary tests/test_llm_stream tests/test_llm_stream.c src/llm_stream.c
 build_test_binary tests/test_allowlist tests/test_allowlist.c src/channels/allowlist.c
-build_test_binary tests/test_schema -DDISABLE_WEB_SEARCH tests/test_schema.c src/functions.c src/buf.c src/memu_client_stub.c src/routeros.c src/base64.c src/http.c src/json.c vendor/jsmn.c vendor/mbedtls_integration.c -lmbedtls -lmbedx509 -lmbedcrypto
-build_test_binary tests/test_tool_security -DDISABLE_WEB_SEARCH tests/test_tool_security.c src/functions.c src/buf.c src/memu_client_stub.c src/routeros.c src/base64.c src/http.c src/json.c vendor/jsmn.c vendor/mbedtls_integration.c -lmbedtls -lmbedx509 -lmbedcrypto
+build_test_binary tests/test_schema -DDISABLE_WEB_SEARCH tests/test_schema.c src/functions.c src/buf.c src/memu_client_stub.c src/routeros.c src/base64.c $HTTP_SRCS src/json.c vendor/jsmn.c vendor/mbedtls_integration.c src/csprng.c -lmbedtls -lmbedx509 -lmbedcrypto
+build_test_binary tests/test_tool_security -DDISABLE_WEB_SEARCH tests/test_tool_security.c src/functions.c src/buf.c src/memu_client_stub.c src/routeros.c src/base64.c $HTTP_SRCS src/json.c vendor/jsmn.c vendor/mbedtls_integration.c src/csprng.c -lmbedtls -lmbedx509 -lmbedcrypto
 
 test_start "TLS verification test"
 if ./tests/test_tls_verify >/dev/null 2>&1; then
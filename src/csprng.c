@@ -0,0 +1,121 @@
+/*
+ * MikroClaw - Process-wide CSPRNG Implementation
+ */
+
+#include "csprng.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/types.h>
+
+#include <mbedtls/ctr_drbg.h>
+#include <mbedtls/entropy.h>
+
+static struct {
+    mbedtls_entropy_context entropy;
+    mbedtls_ctr_drbg_context ctr_drbg;
+    bool seeded;
+    pid_t owner;            /* Process the DRBG was last seeded in */
+} g_rng;
+
+static int drbg_ready(void) {
+    const char *pers = "mikroclaw-csprng";
+    pid_t pid = getpid();
+
+    if (g_rng.seeded) {
+        if (g_rng.owner == pid) {
+            return 0;
+        }
+        /* Forked: mix in the pid as well as fresh entropy */
+        if (mbedtls_ctr_drbg_reseed(&g_rng.ctr_drbg, (const unsigned char *)&pid,
+                                    sizeof(pid)) != 0) {
+            return -1;
+        }
+        g_rng.owner = pid;
+        return 0;
+    }
+
+    mbedtls_entropy_init(&g_rng.entropy);
+    mbedtls_ctr_drbg_init(&g_rng.ctr_drbg);
+    if (mbedtls_ctr_drbg_seed(&g_rng.ctr_drbg, mbedtls_entropy_func, &g_rng.entropy,
+                              (const unsigned char *)pers, strlen(pers)) != 0) {
+        mbedtls_ctr_drbg_free(&g_rng.ctr_drbg);
+        mbedtls_entropy_free(&g_rng.entropy);
+        return -1;
+    }
+    g_rng.seeded = true;
+    g_rng.owner = pid;
+    return 0;
+}
+
+static int urandom_fill(unsigned char *out, size_t len) {
+    int fd = open("/dev/urandom", O_RDONLY);
+    size_t offset = 0;
+
+    if (fd < 0) {
+        return -1;
+    }
+
+    while (offset < len) {
+        ssize_t got = read(fd, out + offset, len - offset);
+        if (got < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            close(fd);
+            return -1;
+        }
+        if (got == 0) {
+            close(fd);
+            return -1;
+        }
+        offset += (size_t)got;
+    }
+
+    close(fd);
+    return 0;
+}
+
+int csprng_bytes(void *out, size_t len) {
+    unsigned char *p = out;
+
+    if (!out || len == 0) {
+        return -1;
+    }
+    if (drbg_ready() != 0) {
+        return urandom_fill(p, len);
+    }
+
+    /* The DRBG caps a single request */
+    while (len > 0) {
+        size_t take = len < MBEDTLS_CTR_DRBG_MAX_REQUEST ? len : MBEDTLS_CTR_DRBG_MAX_REQUEST;
+        if (mbedtls_ctr_drbg_random(&g_rng.ctr_drbg, p, take) != 0) {
+            return urandom_fill(p, len);
+        }
+        p += take;
+        len -= take;
+    }
+    return 0;
+}
+
+int csprng_mbedtls(void *p_rng, unsigned char *out, size_t len) {
+    (void)p_rng;
+    if (len == 0) {
+        return 0;
+    }
+    return csprng_bytes(out, len) == 0 ? 0 : MBEDTLS_ERR_CTR_DRBG_ENTROPY_SOURCE_FAILED;
+}
+
+int csprng_reseed(void) {
+    if (!g_rng.seeded) {
+        return drbg_ready();
+    }
+    if (mbedtls_ctr_drbg_reseed(&g_rng.ctr_drbg, NULL, 0) != 0) {
+        return -1;
+    }
+    g_rng.owner = getpid();
+    return 0;
+}
@@ -0,0 +1,30 @@
+/*
+ * MikroClaw - Process-wide CSPRNG
+ * One CTR-DRBG, seeded from the mbedTLS entropy pool on first use, serves
+ * every consumer in the process: gateway tokens and pairing codes, AES-GCM
+ * nonces, identity keys and the TLS contexts. A forked child would otherwise
+ * replay the parent's output, so the generator notices a pid change and
+ * reseeds from fresh entropy before handing out bytes.
+ */
+
+#ifndef MIKROCLAW_CSPRNG_H
+#define MIKROCLAW_CSPRNG_H
+
+#include <stddef.h>
+
+/* Fill out with random bytes. Falls back to /dev/urandom if the DRBG cannot
+ * be seeded.
+ * returns: 0 on success, -1 on failure
+ */
+int csprng_bytes(void *out, size_t len);
+
+/* mbedTLS f_rng adapter (mbedtls_ssl_conf_rng etc); p_rng is ignored */
+int csprng_mbedtls(void *p_rng, unsigned char *out, size_t len);
+
+/* Reseed from fresh entropy. Call in a child right after fork(); the pid
+ * check would catch it on the next draw anyway.
+ * returns: 0 on success, -1 on failure
+ */
+int csprng_reseed(void);
+
+#endif /* MIKROCLAW_CSPRNG_H */
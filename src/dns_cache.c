@@ -0,0 +1,178 @@
+/*
+ * MikroClaw - In-process DNS cache Implementation
+ */
+
+#include "dns_cache.h"
+#include "http.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <netdb.h>
+#include <time.h>
+
+struct dns_entry {
+    char hostname[HTTP_MAX_HOSTNAME];
+    struct dns_cache_addr addrs[DNS_CACHE_MAX_ADDRS];
+    int count;              /* 0: cached lookup failure */
+    long long expires;      /* Monotonic seconds */
+    long long last_used;
+    int in_use;
+    int needs_refresh;      /* Served stale since the last revalidation */
+};
+
+static struct dns_entry g_entries[DNS_CACHE_MAX_ENTRIES];
+static struct dns_cache_stats g_stats;
+static int g_ttl_s = DNS_CACHE_TTL_S;
+static int g_negative_ttl_s = DNS_CACHE_NEGATIVE_TTL_S;
+
+static long long monotonic_s(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec;
+}
+
+/* Query the system resolver
+ * returns: number of addresses stored in out, or 0 on failure
+ */
+static int lookup(const char *hostname, struct dns_cache_addr *out) {
+    struct addrinfo hints;
+    struct addrinfo *res = NULL;
+    int count = 0;
+
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    hints.ai_flags = AI_ADDRCONFIG;
+
+    if (getaddrinfo(hostname, NULL, &hints, &res) != 0) {
+        return 0;
+    }
+    for (struct addrinfo *ai = res; ai && count < DNS_CACHE_MAX_ADDRS; ai = ai->ai_next) {
+        if (ai->ai_addrlen > sizeof(out[count].addr)) continue;
+        memcpy(&out[count].addr, ai->ai_addr, ai->ai_addrlen);
+        out[count].addr_len = ai->ai_addrlen;
+        out[count].family = ai->ai_family;
+        count++;
+    }
+    freeaddrinfo(res);
+    return count;
+}
+
+static struct dns_entry *find_entry(const char *hostname) {
+    for (int i = 0; i < DNS_CACHE_MAX_ENTRIES; i++) {
+        if (g_entries[i].in_use && strcmp(g_entries[i].hostname, hostname) == 0) {
+            return &g_entries[i];
+        }
+    }
+    return NULL;
+}
+
+/* Take a free slot, or evict the least recently used entry */
+static struct dns_entry *claim_entry(const char *hostname) {
+    struct dns_entry *victim = &g_entries[0];
+
+    for (int i = 0; i < DNS_CACHE_MAX_ENTRIES; i++) {
+        if (!g_entries[i].in_use) {
+            victim = &g_entries[i];
+            break;
+        }
+        if (g_entries[i].last_used < victim->last_used) {
+            victim = &g_entries[i];
+        }
+    }
+    memset(victim, 0, sizeof(*victim));
+    snprintf(victim->hostname, sizeof(victim->hostname), "%s", hostname);
+    victim->in_use = 1;
+    return victim;
+}
+
+static void store(struct dns_entry *e, const struct dns_cache_addr *addrs, int count,
+                  long long now) {
+    memcpy(e->addrs, addrs, (size_t)count * sizeof(addrs[0]));
+    e->count = count;
+    e->expires = now + (count > 0 ? g_ttl_s : g_negative_ttl_s);
+    e->needs_refresh = 0;
+}
+
+static int copy_out(const struct dns_entry *e, struct dns_cache_addr *out, int max) {
+    int n = e->count < max ? e->count : max;
+    memcpy(out, e->addrs, (size_t)n * sizeof(out[0]));
+    return n > 0 ? n : -1;
+}
+
+int dns_cache_resolve(const char *hostname, struct dns_cache_addr *out, int max,
+                      int *cached) {
+    struct dns_cache_addr addrs[DNS_CACHE_MAX_ADDRS];
+    struct dns_entry *e;
+    long long now = monotonic_s();
+    int count;
+
+    if (cached) *cached = 1;
+    if (!hostname || !hostname[0] || !out || max <= 0) return -1;
+
+    e = find_entry(hostname);
+    if (e) {
+        e->last_used = now;
+        if (now < e->expires) {
+            if (e->count == 0) {
+                g_stats.negative_hits++;
+                return -1;
+            }
+            g_stats.hits++;
+            return copy_out(e, out, max);
+        }
+        if (e->count > 0 && now < e->expires + DNS_CACHE_STALE_S) {
+            g_stats.stale_hits++;
+            e->needs_refresh = 1;
+            return copy_out(e, out, max);
+        }
+    }
+
+    if (cached) *cached = 0;
+    g_stats.misses++;
+    count = lookup(hostname, addrs);
+    if (!e) e = claim_entry(hostname);
+    e->last_used = now;
+    store(e, addrs, count, now);
+    return copy_out(e, out, max);
+}
+
+void dns_cache_invalidate(const char *hostname) {
+    struct dns_entry *e = hostname ? find_entry(hostname) : NULL;
+    if (e) {
+        memset(e, 0, sizeof(*e));
+    }
+}
+
+void dns_cache_revalidate(void) {
+    for (int i = 0; i < DNS_CACHE_MAX_ENTRIES; i++) {
+        struct dns_entry *e = &g_entries[i];
+        struct dns_cache_addr addrs[DNS_CACHE_MAX_ADDRS];
+        int count;
+
+        if (!e->in_use || !e->needs_refresh) continue;
+
+        e->needs_refresh = 0;
+        g_stats.revalidations++;
+        count = lookup(e->hostname, addrs);
+        if (count > 0) {
+            store(e, addrs, count, monotonic_s());
+        }
+        /* On failure keep serving the stale addresses until they age out */
+    }
+}
+
+void dns_cache_set_ttl(int ttl_s, int negative_ttl_s) {
+    if (ttl_s > 0) g_ttl_s = ttl_s;
+    if (negative_ttl_s > 0) g_negative_ttl_s = negative_ttl_s;
+}
+
+void dns_cache_flush(void) {
+    memset(g_entries, 0, sizeof(g_entries));
+}
+
+void dns_cache_get_stats(struct dns_cache_stats *stats) {
+    if (stats) {
+        *stats = g_stats;
+    }
+}
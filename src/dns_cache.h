@@ -0,0 +1,58 @@
+/*
+ * MikroClaw - In-process DNS cache
+ * Shared by every HTTP client in the process. getaddrinfo() does not expose
+ * record TTLs, so entries live for a configurable TTL; failed lookups are
+ * cached for a shorter negative TTL. Expired entries are still served for
+ * DNS_CACHE_STALE_S while dns_cache_revalidate() refreshes them off the
+ * request path.
+ */
+
+#ifndef MIKROCLAW_DNS_CACHE_H
+#define MIKROCLAW_DNS_CACHE_H
+
+#include <stdint.h>
+#include <sys/socket.h>
+
+#define DNS_CACHE_MAX_ENTRIES       16
+#define DNS_CACHE_MAX_ADDRS         8
+#define DNS_CACHE_TTL_S             300
+#define DNS_CACHE_NEGATIVE_TTL_S    30
+#define DNS_CACHE_STALE_S           3600
+
+/* Resolved address (port unset) */
+struct dns_cache_addr {
+    struct sockaddr_storage addr;
+    socklen_t addr_len;
+    int family;
+};
+
+struct dns_cache_stats {
+    unsigned long hits;             /* Served fresh from the cache */
+    unsigned long stale_hits;       /* Served expired, queued for refresh */
+    unsigned long negative_hits;    /* Cached lookup failure */
+    unsigned long misses;           /* Resolved synchronously */
+    unsigned long revalidations;    /* Background refreshes performed */
+};
+
+/* Resolve hostname to IPv4/IPv6 stream addresses, via the cache
+ * out: filled with up to max addresses in resolver preference order
+ * cached: set to 1 if served from the cache without a lookup (may be NULL)
+ * returns: number of addresses, or -1 if the name does not resolve
+ */
+int dns_cache_resolve(const char *hostname, struct dns_cache_addr *out, int max,
+                      int *cached);
+
+/* Drop a host's entry, e.g. after none of its addresses accepted a connect */
+void dns_cache_invalidate(const char *hostname);
+
+/* Refresh entries served stale since the last call. Call from an idle point
+ * of the main loop; blocks on the resolver only for those entries. */
+void dns_cache_revalidate(void);
+
+/* Set positive and negative TTLs in seconds (<= 0 keeps the current value) */
+void dns_cache_set_ttl(int ttl_s, int negative_ttl_s);
+
+void dns_cache_flush(void);
+void dns_cache_get_stats(struct dns_cache_stats *stats);
+
+#endif /* MIKROCLAW_DNS_CACHE_H */
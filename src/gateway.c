@@ -3,6 +3,9 @@
  */
 
 #include "gateway.h"
+#include "../vendor/mbedtls_integration.h"
+#include <errno.h>
+#include <poll.h>
 #include <string.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -11,24 +14,195 @@
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <fcntl.h>
+#include <time.h>
+
+#define GATEWAY_TLS_CLIENTS     8       /* TLS clients handshaking or awaiting a reply */
+#define GATEWAY_TLS_TIMEOUT_MS  5000    /* From accept to a whole first read, and per write */
 
 struct gateway_ctx {
     int listen_fd;
     int port;
     char bind_addr[64];
+    struct tls_server *tls;     /* NULL: plaintext listener */
+};
+
+/* A TLS client from accept until gateway_respond. Its handshake and first
+ * read advance on each gateway_poll as far as the non-blocking socket
+ * allows, so a slow or silent client never stalls the main loop. */
+struct gateway_tls_client {
+    struct gateway_ctx *owner;  /* NULL: slot free */
+    int fd;
+    struct mbedtls_ctx tls;
+    bool handshaken;
+    bool served;                /* Request handed out, awaiting gateway_respond */
+    long long deadline_ms;
+    char ip[64];
 };
 
+/* gateway_respond only gets the fd, so the slots are looked up by it */
+static struct gateway_tls_client g_tls_clients[GATEWAY_TLS_CLIENTS];
+
+static long long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void tls_client_drop(struct gateway_tls_client *c) {
+    mbedtls_tls_free(&c->tls);
+    close(c->fd);
+    c->owner = NULL;
+}
+
+static struct gateway_tls_client *tls_client_free_slot(void) {
+    for (int i = 0; i < GATEWAY_TLS_CLIENTS; i++) {
+        if (!g_tls_clients[i].owner) return &g_tls_clients[i];
+    }
+    return NULL;
+}
+
+/* Take waiting connections while slots are free; the rest stay queued in
+ * the listen backlog */
+static void tls_accept_pending(struct gateway_ctx *ctx) {
+    struct gateway_tls_client *c;
+
+    while ((c = tls_client_free_slot()) != NULL) {
+        struct sockaddr_in addr;
+        socklen_t addr_len = sizeof(addr);
+        int fd = accept(ctx->listen_fd, (struct sockaddr *)&addr, &addr_len);
+
+        if (fd < 0) return;
+        fcntl(fd, F_SETFL, O_NONBLOCK);
+        if (mbedtls_tls_accept(ctx->tls, &c->tls, fd) != 0) {
+            close(fd);
+            continue;
+        }
+        if (!inet_ntop(AF_INET, &addr.sin_addr, c->ip, sizeof(c->ip))) {
+            snprintf(c->ip, sizeof(c->ip), "unknown");
+        }
+        c->owner = ctx;
+        c->fd = fd;
+        c->handshaken = false;
+        c->served = false;
+        c->deadline_ms = monotonic_ms() + GATEWAY_TLS_TIMEOUT_MS;
+    }
+}
+
+/* Handshake step, then the first read once it completes
+ * returns 1 with the request, 0 to wait for the socket, -1 to drop */
+static int tls_client_advance(struct gateway_tls_client *c, char *request, size_t max_request) {
+    int n;
+
+    if (!c->handshaken) {
+        int step = mbedtls_handshake_step(&c->tls);
+        if (step == TLS_WANT_READ || step == TLS_WANT_WRITE) return 0;
+        if (step != 0) return -1;
+        c->handshaken = true;
+    }
+    n = mbedtls_recv(&c->tls, request, max_request - 1);
+    if (n > 0) {
+        request[n] = '\0';
+        return 1;
+    }
+    return (n < 0 && errno == EAGAIN) ? 0 : -1;
+}
+
+static int tls_poll(struct gateway_ctx *ctx, char *request, size_t max_request,
+                    int *client_fd, char *client_ip, size_t client_ip_len) {
+    struct pollfd pfds[GATEWAY_TLS_CLIENTS];
+    long long now;
+
+    /* A request whose reply went elsewhere (or nowhere) still holds a slot */
+    for (int i = 0; i < GATEWAY_TLS_CLIENTS; i++) {
+        if (g_tls_clients[i].owner == ctx && g_tls_clients[i].served) {
+            tls_client_drop(&g_tls_clients[i]);
+        }
+    }
+    tls_accept_pending(ctx);
+
+    for (int i = 0; i < GATEWAY_TLS_CLIENTS; i++) {
+        struct gateway_tls_client *c = &g_tls_clients[i];
+        int want = c->owner == ctx ? mbedtls_tls_want(&c->tls) : 0;
+
+        pfds[i].fd = want ? c->fd : -1;
+        pfds[i].events = want == TLS_WANT_WRITE ? POLLOUT : POLLIN;
+        pfds[i].revents = 0;
+    }
+    (void)poll(pfds, GATEWAY_TLS_CLIENTS, 0);
+
+    now = monotonic_ms();
+    for (int i = 0; i < GATEWAY_TLS_CLIENTS; i++) {
+        struct gateway_tls_client *c = &g_tls_clients[i];
+        int ret;
+
+        if (c->owner != ctx) continue;
+        /* Fresh clients are stepped at once (their hello may be in already);
+         * the rest only when the socket is ready the way TLS wants it */
+        if (pfds[i].fd >= 0 && pfds[i].revents == 0) {
+            if (now >= c->deadline_ms) tls_client_drop(c);
+            continue;
+        }
+        ret = tls_client_advance(c, request, max_request);
+        if (ret == 1) {
+            c->served = true;
+            *client_fd = c->fd;
+            if (client_ip && client_ip_len > 0) {
+                snprintf(client_ip, client_ip_len, "%s", c->ip);
+            }
+            return 1;
+        }
+        if (ret < 0 || now >= c->deadline_ms) {
+            tls_client_drop(c);
+        }
+    }
+    return 0;
+}
+
+/* Write the whole response, waiting out a full socket buffer within the
+ * timeout, then close the session */
+static int tls_respond(struct gateway_tls_client *c, const char *response) {
+    size_t len = strlen(response);
+    size_t sent = 0;
+
+    while (sent < len) {
+        int n = mbedtls_send(&c->tls, response + sent, len - sent);
+        if (n > 0) {
+            sent += (size_t)n;
+            continue;
+        }
+        if (n < 0 && errno == EAGAIN) {
+            struct pollfd pfd = { c->fd, 0, 0 };
+            pfd.events = mbedtls_tls_want(&c->tls) == TLS_WANT_READ ? POLLIN : POLLOUT;
+            if (poll(&pfd, 1, GATEWAY_TLS_TIMEOUT_MS) > 0) continue;
+        }
+        break;
+    }
+    mbedtls_tls_close(&c->tls);
+    tls_client_drop(c);
+    return sent == len ? 0 : -1;
+}
+
 struct gateway_ctx *gateway_init(const struct gateway_config *config) {
     if (!config) return NULL;
 
     struct gateway_ctx *ctx = calloc(1, sizeof(*ctx));
     if (!ctx) return NULL;
 
+    /* Half a TLS configuration must not fall back to plaintext */
+    if (config->tls_cert || config->tls_key) {
+        ctx->tls = mbedtls_tls_server_create(config->tls_cert, config->tls_key);
+        if (!ctx->tls) {
+            free(ctx);
+            return NULL;
+        }
+    }
+
     ctx->port = config->port;
     snprintf(ctx->bind_addr, sizeof(ctx->bind_addr), "%s",
              (config->bind_addr && config->bind_addr[0] != '\0') ? config->bind_addr : "0.0.0.0");
     ctx->listen_fd = socket(AF_INET, SOCK_STREAM, 0);
     if (ctx->listen_fd < 0) {
+        mbedtls_tls_server_free(ctx->tls);
         free(ctx);
         return NULL;
     }
@@ -43,6 +217,7 @@ struct gateway_ctx *gateway_init(const struct gateway_config *config) {
     addr.sin_family = AF_INET;
     if (inet_pton(AF_INET, ctx->bind_addr, &addr.sin_addr) != 1) {
         close(ctx->listen_fd);
+        mbedtls_tls_server_free(ctx->tls);
         free(ctx);
         return NULL;
     }
@@ -50,6 +225,7 @@ struct gateway_ctx *gateway_init(const struct gateway_config *config) {
     
     if (bind(ctx->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
         close(ctx->listen_fd);
+        mbedtls_tls_server_free(ctx->tls);
         free(ctx);
         return NULL;
     }
@@ -57,6 +233,7 @@ struct gateway_ctx *gateway_init(const struct gateway_config *config) {
     /* Listen */
     if (listen(ctx->listen_fd, 5) < 0) {
         close(ctx->listen_fd);
+        mbedtls_tls_server_free(ctx->tls);
         free(ctx);
         return NULL;
     }
@@ -79,6 +256,12 @@ struct gateway_ctx *gateway_init(const struct gateway_config *config) {
 void gateway_destroy(struct gateway_ctx *ctx) {
     if (!ctx) return;
     close(ctx->listen_fd);
+    for (int i = 0; i < GATEWAY_TLS_CLIENTS; i++) {
+        if (g_tls_clients[i].owner == ctx) {
+            tls_client_drop(&g_tls_clients[i]);
+        }
+    }
+    mbedtls_tls_server_free(ctx->tls);
     free(ctx);
 }
 
@@ -90,6 +273,11 @@ int gateway_poll(struct gateway_ctx *ctx, char *request, size_t max_request,
     if (client_ip && client_ip_len > 0) {
         client_ip[0] = '\0';
     }
+    *client_fd = -1;
+
+    if (ctx->tls) {
+        return tls_poll(ctx, request, max_request, client_fd, client_ip, client_ip_len);
+    }
     
     struct sockaddr_in client_addr;
     socklen_t addr_len = sizeof(client_addr);
@@ -119,6 +307,13 @@ int gateway_poll(struct gateway_ctx *ctx, char *request, size_t max_request,
 
 int gateway_respond(int client_fd, const char *response) {
     if (client_fd < 0 || !response) return -1;
+
+    for (int i = 0; i < GATEWAY_TLS_CLIENTS; i++) {
+        if (g_tls_clients[i].owner && g_tls_clients[i].served &&
+            g_tls_clients[i].fd == client_fd) {
+            return tls_respond(&g_tls_clients[i], response);
+        }
+    }
     
     send(client_fd, response, strlen(response), 0);
     close(client_fd);
@@ -131,3 +326,11 @@ int gateway_port(const struct gateway_ctx *ctx) {
     }
     return ctx->port;
 }
+
+int gateway_is_tls(const struct gateway_ctx *ctx) {
+    return ctx && ctx->tls ? 1 : 0;
+}
+
+void gateway_tls_stats(const struct gateway_ctx *ctx, struct tls_session_stats *stats) {
+    mbedtls_tls_server_stats(ctx ? ctx->tls : NULL, stats);
+}
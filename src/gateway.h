@@ -8,10 +8,13 @@
 #include <stdint.h>
 
 struct gateway_ctx;
+struct tls_session_stats;
 
 struct gateway_config {
     uint16_t port;
     const char *bind_addr;
+    const char *tls_cert;   /* PEM certificate chain; with tls_key, serve HTTPS */
+    const char *tls_key;    /* PEM private key */
 };
 
 struct gateway_ctx *gateway_init(const struct gateway_config *config);
@@ -22,4 +25,12 @@ int gateway_poll(struct gateway_ctx *ctx, char *request, size_t max_request,
 int gateway_respond(int client_fd, const char *response);
 int gateway_port(const struct gateway_ctx *ctx);
 
+/* Whether the listener terminates TLS. Its clients are accepted into a few
+ * slots and their handshakes and first reads advance on each gateway_poll
+ * without blocking, so gateway_poll returns 1 once a request is complete. */
+int gateway_is_tls(const struct gateway_ctx *ctx);
+
+/* TLS handshakes completed and resumed (zeros for a plaintext listener) */
+void gateway_tls_stats(const struct gateway_ctx *ctx, struct tls_session_stats *stats);
+
 #endif /* GATEWAY_H */
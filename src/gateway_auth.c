@@ -1,16 +1,12 @@
 #include "gateway_auth.h"
+#include "csprng.h"
 
-#include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
-#include <fcntl.h>
 #include <string.h>
 #include <time.h>
 #include <unistd.h>
 
-#include <mbedtls/ctr_drbg.h>
-#include <mbedtls/entropy.h>
-
 #define MAX_TOKENS 16
 
 struct token_entry {
@@ -25,80 +21,22 @@ struct gateway_auth_ctx {
     struct token_entry entries[MAX_TOKENS];
 };
 
-static int random_fill_bytes(unsigned char *out, size_t len) {
-    int rc;
-    mbedtls_entropy_context entropy;
-    mbedtls_ctr_drbg_context ctr_drbg;
-    const char *pers = "mikroclaw-gateway-auth";
-
-    if (!out || len == 0) {
-        return -1;
-    }
-
-    mbedtls_entropy_init(&entropy);
-    mbedtls_ctr_drbg_init(&ctr_drbg);
-    rc = mbedtls_ctr_drbg_seed(&ctr_drbg,
-                               mbedtls_entropy_func,
-                               &entropy,
-                               (const unsigned char *)pers,
-                               strlen(pers));
-    if (rc == 0) {
-        rc = mbedtls_ctr_drbg_random(&ctr_drbg, out, len);
-        mbedtls_ctr_drbg_free(&ctr_drbg);
-        mbedtls_entropy_free(&entropy);
-        if (rc == 0) {
-            return 0;
-        }
-    }
-
-    mbedtls_ctr_drbg_free(&ctr_drbg);
-    mbedtls_entropy_free(&entropy);
-
-    {
-        int fd = open("/dev/urandom", O_RDONLY);
-        size_t offset = 0;
-
-        if (fd < 0) {
-            return -1;
-        }
-
-        while (offset < len) {
-            ssize_t got = read(fd, out + offset, len - offset);
-            if (got < 0) {
-                if (errno == EINTR) {
-                    continue;
-                }
-                close(fd);
-                return -1;
-            }
-            if (got == 0) {
-                close(fd);
-                return -1;
-            }
-            offset += (size_t)got;
-        }
-
-        close(fd);
-    }
-
-    return 0;
-}
-
 static int random_string(char *out, size_t len) {
     static const char *alphabet = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ0123456789";
     size_t alpha_len = strlen(alphabet);
+    unsigned char *r = (unsigned char *)out;
     size_t i;
-    unsigned char r[1];
 
     if (!out || len == 0) {
         return -1;
     }
 
+    /* One draw for the whole string, mapped in place */
+    if (len > 1 && csprng_bytes(r, len - 1) != 0) {
+        return -1;
+    }
     for (i = 0; i + 1 < len; i++) {
-        if (random_fill_bytes(r, sizeof(r)) != 0) {
-            return -1;
-        }
-        out[i] = alphabet[r[0] % alpha_len];
+        out[i] = alphabet[r[i] % alpha_len];
     }
     out[len - 1] = '\0';
     return 0;
@@ -113,7 +51,7 @@ struct gateway_auth_ctx *gateway_auth_init(int token_ttl_seconds) {
         return NULL;
     }
 
-    if (random_fill_bytes(bytes, sizeof(bytes)) != 0) {
+    if (csprng_bytes(bytes, sizeof(bytes)) != 0) {
         gateway_auth_destroy(ctx);
         return NULL;
     }
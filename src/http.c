@@ -4,19 +4,27 @@
  */
 
 #include "http.h"
-#include "../vendor/mbedtls_integration.h"
+#include "dns_cache.h"
+#include "http_pool.h"
+#include "http_stats.h"
+#include "../vendor/inflate.h"
 #include "../src/mikroclaw_config.h"
 
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <netdb.h>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <strings.h>
+#include <sys/epoll.h>
 #include <sys/time.h>
+#include <sys/uio.h>
+#include <time.h>
 
 #ifdef __GNUC__
 #define HTTP_WEAK __attribute__((weak))
@@ -29,11 +37,37 @@ struct http_client {
     char hostname[HTTP_MAX_HOSTNAME];
     uint16_t port;
     bool use_tls;
-    int socket_fd;
-    struct mbedtls_ctx tls_ctx;
-    int connected;
+    struct http_conn *conn; /* Pooled connection, leased during a request */
+    int timeout_ms;     /* Socket send/receive timeout */
+    int connect_timeout_ms;
+    char *rx_buf;       /* Receive buffer; responses are views into it */
+    size_t rx_cap;
+    struct inflate_stream *inflater;    /* Allocated on first compressed response */
+    char *body_buf;     /* Inflated body of a buffered response */
+    size_t body_cap;
+    size_t rx_pending_off;  /* Bytes read past the last response: the start */
+    size_t rx_pending_len;  /* of the next pipelined one */
+    struct http_header_view *hdrs;  /* Header views of the last response */
+    int hdr_cap;
+    struct http_timing timing;      /* Phases of the request in progress */
+    long long req_start_us;
+    long long sent_us;              /* When the request was fully written */
+    struct http_retry_policy retry;
+    int retry_armed;        /* A retryable status would be retried */
+    int body_delivered;     /* Body bytes reached the caller's callback */
+    struct http_async *async;       /* Request in flight on an engine */
 };
 
+/* Receive buffer sizing: start small, grow on demand up to the header room
+ * plus HTTP_MAX_RESPONSE_SIZE (buffered) or HTTP_STREAM_BUF_SIZE (streamed) */
+#define HTTP_RX_BUF_INITIAL     4096
+#define HTTP_RX_HEADER_ROOM     8192
+
+#define HTTP_REQUEST_HEAD_SIZE  4096    /* Request line plus headers */
+#define HTTP_RETRY_ORIGINS      8       /* Origins with a tracked retry budget */
+#define HTTP_TLS_RECORD_SIZE    4096    /* Header block + body start, one record */
+#define HTTP_ENGINE_EVENTS      16      /* Readiness events taken per epoll_wait */
+
 /* Set socket timeout */
 static int set_timeout(int fd, int timeout_ms) {
     struct timeval tv;
@@ -50,6 +84,10 @@ static int set_timeout(int fd, int timeout_ms) {
 }
 
 /* Create HTTP client */
+static struct http_retry_policy g_retry_default = {
+    HTTP_RETRY_MAX_ATTEMPTS, HTTP_RETRY_BASE_MS, HTTP_RETRY_MAX_MS, false
+};
+
 HTTP_WEAK struct http_client *http_client_create(const char *hostname, uint16_t port, bool use_tls) {
     struct http_client *client = calloc(1, sizeof(*client));
     if (!client) return NULL;
@@ -57,16 +95,9 @@ HTTP_WEAK struct http_client *http_client_create(const char *hostname, uint16_t
     strncpy(client->hostname, hostname, sizeof(client->hostname) - 1);
     client->port = port;
     client->use_tls = use_tls;
-    client->socket_fd = -1;
-    client->connected = 0;
-    
-    /* Initialize TLS context if needed */
-    if (use_tls) {
-        if (mbedtls_init(&client->tls_ctx, hostname) != 0) {
-            free(client);
-            return NULL;
-        }
-    }
+    client->timeout_ms = HTTP_TIMEOUT_MS;
+    client->connect_timeout_ms = HTTP_CONNECT_TIMEOUT_MS;
+    client->retry = g_retry_default;
     
     return client;
 }
@@ -75,301 +106,2035 @@ HTTP_WEAK struct http_client *http_client_create(const char *hostname, uint16_t
 HTTP_WEAK void http_client_destroy(struct http_client *client) {
     if (!client) return;
     
-    if (client->use_tls) {
-        mbedtls_tls_free(&client->tls_ctx);
+    http_engine_cancel(client);
+    http_pool_release(client->conn, 0);
+    free(client->rx_buf);
+    free(client->inflater);
+    free(client->body_buf);
+    free(client->hdrs);
+    free(client);
+}
+
+/* Set I/O and connect timeouts */
+HTTP_WEAK void http_client_set_timeout(struct http_client *client, int timeout_ms) {
+    if (!client || timeout_ms <= 0) return;
+
+    client->timeout_ms = timeout_ms;
+    client->connect_timeout_ms = timeout_ms < HTTP_CONNECT_TIMEOUT_MS ?
+                                 timeout_ms : HTTP_CONNECT_TIMEOUT_MS;
+}
+
+HTTP_WEAK void http_retry_set_default(const struct http_retry_policy *policy) {
+    if (!policy) return;
+    if (policy->max_attempts > 0) g_retry_default.max_attempts = policy->max_attempts;
+    if (policy->base_delay_ms > 0) g_retry_default.base_delay_ms = policy->base_delay_ms;
+    if (policy->max_delay_ms > 0) g_retry_default.max_delay_ms = policy->max_delay_ms;
+    g_retry_default.retry_post = policy->retry_post;
+}
+
+HTTP_WEAK void http_retry_get_default(struct http_retry_policy *policy) {
+    if (policy) *policy = g_retry_default;
+}
+
+HTTP_WEAK void http_client_set_retry(struct http_client *client,
+                                     const struct http_retry_policy *policy) {
+    if (!client || !policy) return;
+    client->retry = *policy;
+    if (client->retry.max_attempts < 1) client->retry.max_attempts = 1;
+    if (client->retry.base_delay_ms < 1) client->retry.base_delay_ms = 1;
+    if (client->retry.max_delay_ms < client->retry.base_delay_ms) {
+        client->retry.max_delay_ms = client->retry.base_delay_ms;
     }
-    
-    if (client->socket_fd >= 0) {
-        close(client->socket_fd);
+}
+
+static long long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static long long monotonic_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+/* Add the time since *since to a phase and restart the clock */
+static void phase_end(struct http_timing *timing, enum http_phase phase, long long *since) {
+    long long now = monotonic_us();
+    timing->us[phase] += (uint32_t)(now - *since);
+    timing->done |= 1u << phase;
+    *since = now;
+}
+
+static void timing_start(struct http_client *client) {
+    memset(&client->timing, 0, sizeof(client->timing));
+    client->req_start_us = monotonic_us();
+}
+
+/* Close the request's timing: copy it out and account it to the origin */
+static void timing_finish(struct http_client *client, struct http_timing *out, int result) {
+    long long since = client->req_start_us;
+
+    phase_end(&client->timing, HTTP_PHASE_TOTAL, &since);
+    if (out) *out = client->timing;
+    http_stats_record(client->hostname, client->port, client->use_tls,
+                      &client->timing, result);
+}
+
+/* Order resolved addresses for connection racing: alternate address
+ * families, starting with the resolver's preferred one (RFC 8305 4) */
+static int order_addrs(struct dns_cache_addr *res, int n, uint16_t port,
+                       struct dns_cache_addr *out) {
+    int first[HTTP_MAX_ADDRS];
+    int second[HTTP_MAX_ADDRS];
+    int n_first = 0;
+    int n_second = 0;
+    int count = 0;
+
+    for (int i = 0; i < n; i++) {
+        if (res[i].family == res[0].family) {
+            if (n_first < HTTP_MAX_ADDRS) first[n_first++] = i;
+        } else if (n_second < HTTP_MAX_ADDRS) {
+            second[n_second++] = i;
+        }
     }
-    
-    free(client);
+    for (int i = 0; count < HTTP_MAX_ADDRS && (i < n_first || i < n_second); i++) {
+        if (i < n_first) out[count++] = res[first[i]];
+        if (i < n_second && count < HTTP_MAX_ADDRS) out[count++] = res[second[i]];
+    }
+
+    for (int i = 0; i < count; i++) {
+        if (out[i].family == AF_INET6) {
+            ((struct sockaddr_in6 *)&out[i].addr)->sin6_port = htons(port);
+        } else {
+            ((struct sockaddr_in *)&out[i].addr)->sin_port = htons(port);
+        }
+    }
+    return count;
 }
 
-/* Connect to server */
-static int http_connect(struct http_client *client) {
-    if (client->connected) return 0;
-    
-    /* Resolve hostname */
-    struct hostent *host = gethostbyname(client->hostname);
-    if (!host) {
-        return HTTP_ERR_RESOLVE;
+/* Start a non-blocking connect
+ * returns: socket fd with *done set if it connected at once, or -1
+ */
+static int start_connect(const struct dns_cache_addr *addr, int *done) {
+    int fd = socket(addr->family, SOCK_STREAM, 0);
+    int flags;
+
+    *done = 0;
+    if (fd < 0) return -1;
+
+    flags = fcntl(fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) {
+        close(fd);
+        return -1;
     }
-    
-    /* Create socket */
-    client->socket_fd = socket(AF_INET, SOCK_STREAM, 0);
-    if (client->socket_fd < 0) {
-        return HTTP_ERR_CONNECT;
+    if (connect(fd, (const struct sockaddr *)&addr->addr, addr->addr_len) == 0) {
+        *done = 1;
+    } else if (errno != EINPROGRESS) {
+        close(fd);
+        return -1;
     }
-    
-    /* Set timeout */
-    if (set_timeout(client->socket_fd, HTTP_TIMEOUT_MS) < 0) {
-        close(client->socket_fd);
-        client->socket_fd = -1;
+    return fd;
+}
+
+/* Connects racing across a host's addresses: a new attempt starts every
+ * HTTP_HAPPY_EYEBALLS_MS, or at once when one fails, and the first to
+ * complete wins. The whole race is bounded by a deadline. */
+struct connect_race {
+    struct dns_cache_addr addrs[HTTP_MAX_ADDRS];   /* In the order to try */
+    int count;
+    int next;                   /* Next address to try */
+    struct pollfd pending[HTTP_MAX_ADDRS];
+    int npending;
+    long long deadline;         /* Monotonic ms */
+    long long next_start;
+};
+
+/* Resolve through the DNS cache into the race's address list
+ * returns: number of addresses, or HTTP_ERR_RESOLVE
+ */
+static int race_resolve(struct connect_race *race, const char *hostname, uint16_t port,
+                        struct http_timing *timing, int *cached) {
+    struct dns_cache_addr res[HTTP_MAX_ADDRS];
+    long long t = monotonic_us();
+    int n = dns_cache_resolve(hostname, res, HTTP_MAX_ADDRS, cached);
+
+    phase_end(timing, HTTP_PHASE_DNS, &t);
+    if (n <= 0) return HTTP_ERR_RESOLVE;
+    race->count = order_addrs(res, n, port, race->addrs);
+    return race->count;
+}
+
+static void race_begin(struct connect_race *race, int timeout_ms) {
+    race->next = 0;
+    race->npending = 0;
+    race->deadline = monotonic_ms() + timeout_ms;
+    race->next_start = 0;
+}
+
+static void race_abort(struct connect_race *race) {
+    for (int i = 0; i < race->npending; i++) {
+        close(race->pending[i].fd);
+    }
+    race->npending = 0;
+}
+
+/* Milliseconds until the race next needs attention */
+static int race_wait_ms(const struct connect_race *race) {
+    long long now = monotonic_ms();
+    long long wait = race->deadline - now;
+
+    if (race->next < race->count && race->next_start - now < wait) {
+        wait = race->next_start - now;
+    }
+    return wait > 0 ? (int)wait : 0;
+}
+
+/* Advance the race without blocking: start the attempts that are due and
+ * collect those that finished
+ * returns: 0 with *fd_out set to the winning socket (still non-blocking),
+ *          1 while attempts are in flight, or negative error
+ */
+static int race_step(struct connect_race *race, int *fd_out) {
+    for (;;) {
+        long long now = monotonic_ms();
+        int failed = 0;
+
+        if (now >= race->deadline) {
+            race_abort(race);
+            return HTTP_ERR_TIMEOUT;
+        }
+
+        if (race->next < race->count && (race->npending == 0 || now >= race->next_start)) {
+            int done;
+            int fd = start_connect(&race->addrs[race->next++], &done);
+            race->next_start = now + HTTP_HAPPY_EYEBALLS_MS;
+            if (fd >= 0 && done) {
+                race_abort(race);
+                *fd_out = fd;
+                return 0;
+            } else if (fd >= 0) {
+                race->pending[race->npending].fd = fd;
+                race->pending[race->npending].events = POLLOUT;
+                race->pending[race->npending].revents = 0;
+                race->npending++;
+            }
+            continue;
+        }
+
+        if (race->npending == 0) return HTTP_ERR_CONNECT;  /* Every address failed */
+
+        if (poll(race->pending, race->npending, 0) <= 0) return 1;
+
+        for (int i = 0; i < race->npending;) {
+            struct pollfd *p = &race->pending[i];
+            int err = 0;
+            socklen_t err_len = sizeof(err);
+
+            if (p->revents == 0) {
+                i++;
+                continue;
+            }
+            if (getsockopt(p->fd, SOL_SOCKET, SO_ERROR, &err, &err_len) == 0 && err == 0) {
+                *fd_out = p->fd;
+                *p = race->pending[--race->npending];
+                race_abort(race);
+                return 0;
+            }
+            close(p->fd);
+            *p = race->pending[--race->npending];
+            race->next_start = 0;   /* Failed: try the next address now */
+            failed = 1;
+        }
+        if (!failed) return 1;
+    }
+}
+
+/* Run a race to the end
+ * returns: 0 with *fd_out set to a blocking socket, or negative error
+ */
+static int connect_race(struct connect_race *race, int timeout_ms, int *fd_out) {
+    int ret;
+
+    race_begin(race, timeout_ms);
+    while ((ret = race_step(race, fd_out)) == 1) {
+        if (poll(race->pending, race->npending, race_wait_ms(race)) < 0 && errno != EINTR) {
+            race_abort(race);
+            return HTTP_ERR_CONNECT;
+        }
+    }
+    if (ret != 0) return ret;
+
+    int flags = fcntl(*fd_out, F_GETFL, 0);
+    if (flags < 0 || fcntl(*fd_out, F_SETFL, flags & ~O_NONBLOCK) < 0) {
+        close(*fd_out);
         return HTTP_ERR_CONNECT;
     }
+    return 0;
+}
+
+/* Resolve hostname (IPv4 and IPv6, through the shared DNS cache) and
+ * connect within timeout_ms. If no cached address accepts, the entry may
+ * be outdated: drop it and resolve once more. */
+static int connect_addrs(const char *hostname, uint16_t port, int timeout_ms, int *fd_out,
+                         struct http_timing *timing) {
+    struct connect_race race;
+    int ret = HTTP_ERR_RESOLVE;
+
+    for (int attempt = 0; attempt < 2; attempt++) {
+        int cached;
+        if (race_resolve(&race, hostname, port, timing, &cached) < 0) return HTTP_ERR_RESOLVE;
+
+        long long t = monotonic_us();
+        ret = connect_race(&race, timeout_ms, fd_out);
+        phase_end(timing, HTTP_PHASE_CONNECT, &t);
+        if (ret != HTTP_ERR_CONNECT || !cached) break;
+        dns_cache_invalidate(hostname);
+    }
+    return ret;
+}
+
+/* Lease a pooled connection to the client's origin and make sure it is
+ * connected, with this client's socket timeout applied */
+static int http_connect(struct http_client *client) {
+    if (!client->conn) {
+        client->conn = http_pool_acquire(client->hostname, client->port, client->use_tls);
+        if (!client->conn) {
+            if (errno == EBUSY) return HTTP_ERR_BUSY;
+            return client->use_tls ? HTTP_ERR_TLS : HTTP_ERR_NOMEM;
+        }
+    }
+
+    struct http_conn *conn = client->conn;
+    client->timing.reused = conn->connected;
+    if (conn->connected) {
+        if (conn->timeout_ms != client->timeout_ms) {
+            set_timeout(conn->socket_fd, client->timeout_ms);
+            conn->timeout_ms = client->timeout_ms;
+        }
+        return 0;
+    }
     
-    /* Connect */
-    struct sockaddr_in addr = {0};
-    addr.sin_family = AF_INET;
-    addr.sin_port = htons(client->port);
-    memcpy(&addr.sin_addr, host->h_addr, host->h_length);
+    int ret = connect_addrs(client->hostname, client->port,
+                            client->connect_timeout_ms, &conn->socket_fd, &client->timing);
+    if (ret != 0) {
+        return ret;
+    }
     
-    if (connect(client->socket_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
-        close(client->socket_fd);
-        client->socket_fd = -1;
+    /* Set timeout */
+    if (set_timeout(conn->socket_fd, client->timeout_ms) < 0) {
+        http_conn_close(conn);
         return HTTP_ERR_CONNECT;
     }
+    conn->timeout_ms = client->timeout_ms;
     
     /* TLS handshake if needed */
     if (client->use_tls) {
-        client->tls_ctx.socket_fd = client->socket_fd;
-        if (mbedtls_connect_socket(&client->tls_ctx, client->socket_fd) != 0 ||
-            mbedtls_handshake(&client->tls_ctx) != 0) {
-            close(client->socket_fd);
-            client->socket_fd = -1;
+        long long t = monotonic_us();
+        conn->tls_ctx.socket_fd = conn->socket_fd;
+        ret = mbedtls_connect_socket(&conn->tls_ctx, conn->socket_fd) != 0 ||
+              mbedtls_handshake(&conn->tls_ctx) != 0;
+        phase_end(&client->timing, HTTP_PHASE_TLS, &t);
+        client->timing.tls_resumed = !ret && conn->tls_ctx.resumed;
+        if (ret) {
+            http_conn_close(conn);
             return HTTP_ERR_TLS;
         }
     }
     
-    client->connected = 1;
+    conn->connected = 1;
+    conn->requests = 0;
     return 0;
 }
 
-/* Send data */
-static int http_send(struct http_client *client, const char *data, size_t len) {
+/* Write all of buf over TLS */
+static int tls_send_all(struct http_conn *conn, const char *buf, size_t len) {
     size_t sent = 0;
-    
+
     while (sent < len) {
-        ssize_t n = client->use_tls ? 
-            mbedtls_send(&client->tls_ctx, data + sent, len - sent) :
-            send(client->socket_fd, data + sent, len - sent, 0);
-        
-        if (n < 0) {
-            if (errno == EINTR) continue;
-            return HTTP_ERR_SEND;
-        }
-        
-        if (n == 0) {
-            return HTTP_ERR_SEND;  /* Connection closed */
-        }
-        
-        sent += n;
+        int n = mbedtls_send(&conn->tls_ctx, buf + sent, len - sent);
+        if (n <= 0) return HTTP_ERR_SEND;
+        sent += (size_t)n;
     }
-    
     return 0;
 }
 
-/* Receive data */
-static int http_recv(struct http_client *client, char *buf, size_t max_len, size_t *out_len) {
-    size_t total = 0;
-    
-    while (total < max_len - 1) {
-        ssize_t n = client->use_tls ?
-            mbedtls_recv(&client->tls_ctx, buf + total, max_len - total - 1) :
-            recv(client->socket_fd, buf + total, max_len - total - 1, 0);
-        
+/* Send the header block and the caller's body without joining them first.
+ * Plain TCP uses gather writes (sendmsg, so a peer that closed the socket
+ * yields EPIPE rather than SIGPIPE). TLS packs the header block and the
+ * start of the body into one record, then encrypts the rest of the body
+ * straight from the caller's buffer. */
+static int http_write(struct http_client *client, const char *head, size_t head_len,
+                      const char *body, size_t body_len) {
+    struct http_conn *conn = client->conn;
+
+    if (client->use_tls) {
+        char record[HTTP_TLS_RECORD_SIZE];
+        size_t take = 0;
+        int ret;
+
+        if (head_len < sizeof(record)) {
+            take = sizeof(record) - head_len;
+            if (take > body_len) take = body_len;
+            memcpy(record, head, head_len);
+            if (take > 0) memcpy(record + head_len, body, take);
+            ret = tls_send_all(conn, record, head_len + take);
+        } else {
+            ret = tls_send_all(conn, head, head_len);
+        }
+        if (ret != 0) return ret;
+        return tls_send_all(conn, body + take, body_len - take);
+    }
+
+    struct iovec iov[2] = {
+        { (void *)head, head_len },
+        { (void *)body, body_len }
+    };
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = iov;
+    msg.msg_iovlen = body_len > 0 ? 2 : 1;
+
+    while (msg.msg_iovlen > 0) {
+        ssize_t n = sendmsg(conn->socket_fd, &msg, MSG_NOSIGNAL);
+
         if (n < 0) {
             if (errno == EINTR) continue;
-            if (errno == EAGAIN || errno == EWOULDBLOCK) break;  /* Timeout */
-            return HTTP_ERR_RECV;
+            return HTTP_ERR_SEND;
         }
-        
         if (n == 0) {
-            break;  /* Connection closed */
+            return HTTP_ERR_SEND;  /* Connection closed */
+        }
+
+        while (n > 0 && msg.msg_iovlen > 0) {
+            if ((size_t)n >= msg.msg_iov[0].iov_len) {
+                n -= (ssize_t)msg.msg_iov[0].iov_len;
+                msg.msg_iov++;
+                msg.msg_iovlen--;
+            } else {
+                msg.msg_iov[0].iov_base = (char *)msg.msg_iov[0].iov_base + n;
+                msg.msg_iov[0].iov_len -= (size_t)n;
+                n = 0;
+            }
         }
-        
-        total += n;
     }
     
-    buf[total] = '\0';
-    *out_len = total;
     return 0;
 }
 
-/* Build HTTP request */
-static int build_request(char *buf, size_t max_len,
-                         const char *method, const char *path,
-                         const char *hostname,
-                         const struct http_header *headers, int num_headers,
-                         const char *body, size_t body_len) {
-int n = snprintf(buf, max_len,
-        "%s %s HTTP/1.1\r\n"
-        "Host: %s\r\n"
-        "User-Agent: MikroClaw/0.1.0\r\n"
-        "Accept: application/json\r\n",
-        method, path, hostname);
-    if (n < 0 || (size_t)n >= max_len) {
-        return -1;
+/* Write a request, timing it */
+static int http_send(struct http_client *client, const char *head, size_t head_len,
+                     const char *body, size_t body_len) {
+    long long t = monotonic_us();
+    int ret = http_write(client, head, head_len, body, body_len);
+
+    if (ret == 0) {
+        phase_end(&client->timing, HTTP_PHASE_SEND, &t);
+        client->timing.bytes_sent += head_len + body_len;
+        client->sent_us = t;
     }
+    return ret;
+}
 
-    if (body && body_len > 0) {
-        int written = snprintf(buf + n, max_len - n,
-            "Content-Type: application/json\r\n"
-            "Content-Length: %zu\r\n",
-            body_len);
-        if (written < 0 || (size_t)written >= (max_len - (size_t)n)) {
-            return -1;
-        }
-        n += written;
+/* Locate the blank line ending the header block.
+ * returns: header block length including the terminator, 0 if incomplete
+ */
+static size_t find_header_end(const char *buf, size_t len) {
+    for (size_t i = 0; i + 1 < len; i++) {
+        if (buf[i] != '\n') continue;
+        if (buf[i + 1] == '\n') return i + 2;
+        if (i + 2 < len && buf[i + 1] == '\r' && buf[i + 2] == '\n') return i + 3;
     }
+    return 0;
+}
 
-    /* Add custom headers */
-    for (int i = 0; i < num_headers && n < (int)max_len - 1; i++) {
-        int written = snprintf(buf + n, max_len - n, "%s: %s\r\n",
-                      headers[i].name, headers[i].value);
-        if (written < 0 || (size_t)written >= (max_len - (size_t)n)) {
-            return -1;
+/* Case-insensitive match of token against the comma-separated list in a
+ * header value (e.g. "keep-alive, close"); parameters after ';' are ignored */
+static int header_has_token(const char *value, int value_len, const char *token) {
+    size_t token_len = strlen(token);
+    int i = 0;
+
+    while (i < value_len) {
+        int start;
+        int end;
+
+        while (i < value_len && (value[i] == ' ' || value[i] == '\t' || value[i] == ',')) i++;
+        start = i;
+        while (i < value_len && value[i] != ',' && value[i] != ';') i++;
+        end = i;
+        while (end > start && (value[end - 1] == ' ' || value[end - 1] == '\t')) end--;
+        if ((size_t)(end - start) == token_len &&
+            strncasecmp(value + start, token, token_len) == 0) {
+            return 1;
         }
-        n += written;
+        while (i < value_len && value[i] != ',') i++;
     }
+    return 0;
+}
 
-    {
-        int written = snprintf(buf + n, max_len - n, "\r\n");
-        if (written < 0 || (size_t)written >= (max_len - (size_t)n)) {
-            return -1;
+/* Response framing, derived from the status line and headers */
+struct http_framing {
+    size_t header_len;
+    long long content_length;   /* -1: body runs until the peer closes */
+    int chunked;                /* Transfer-Encoding: chunked */
+    int compressed;             /* Content-Encoding: gzip or deflate */
+    enum inflate_format format;
+    int keep_alive;
+};
+
+/* Chunked transfer-encoding decoder state, carried across reads */
+enum chunk_state {
+    CHUNK_SIZE,         /* Hex chunk size */
+    CHUNK_EXT,          /* Chunk extensions up to end of line */
+    CHUNK_DATA,         /* Chunk payload */
+    CHUNK_DATA_CR,      /* CRLF after payload */
+    CHUNK_DATA_LF,
+    CHUNK_TRAILER,      /* Start of a trailer line (empty line ends message) */
+    CHUNK_TRAILER_LINE,
+    CHUNK_TRAILER_LF,
+    CHUNK_DONE
+};
+
+struct http_chunked {
+    enum chunk_state state;
+    size_t remaining;   /* Payload bytes left in the current chunk */
+    int digits;
+};
+
+static int hex_value(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+/* De-chunk newly received bytes in place
+ * buf/len: received bytes; decoded payload is compacted to the front of buf
+ * out_len: payload bytes now at buf[0..out_len)
+ * consumed: input bytes used (less than len only after the message end)
+ * returns: 1 when the last chunk and trailers are complete, 0 if more input
+ *          is needed, -1 on malformed input
+ */
+static int chunked_decode(struct http_chunked *dec, char *buf, size_t len,
+                          size_t *out_len, size_t *consumed) {
+    size_t in = 0;
+    size_t out = 0;
+
+    while (in < len && dec->state != CHUNK_DONE) {
+        char c = buf[in];
+
+        switch (dec->state) {
+            case CHUNK_SIZE: {
+                int v = hex_value(c);
+                if (v >= 0) {
+                    if (dec->digits >= (int)(sizeof(size_t) * 2) - 1) return -1;
+                    dec->remaining = dec->remaining * 16 + (size_t)v;
+                    dec->digits++;
+                    in++;
+                    break;
+                }
+                if (dec->digits == 0) return -1;
+                dec->state = CHUNK_EXT;
+                break;
+            }
+            case CHUNK_EXT:
+                in++;
+                if (c == '\n') {
+                    dec->digits = 0;
+                    dec->state = dec->remaining > 0 ? CHUNK_DATA : CHUNK_TRAILER;
+                }
+                break;
+            case CHUNK_DATA: {
+                size_t n = len - in;
+                if (n > dec->remaining) n = dec->remaining;
+                memmove(buf + out, buf + in, n);
+                out += n;
+                in += n;
+                dec->remaining -= n;
+                if (dec->remaining == 0) dec->state = CHUNK_DATA_CR;
+                break;
+            }
+            case CHUNK_DATA_CR:
+                in++;
+                if (c == '\r') dec->state = CHUNK_DATA_LF;
+                else if (c == '\n') dec->state = CHUNK_SIZE;
+                else return -1;
+                break;
+            case CHUNK_DATA_LF:
+                in++;
+                if (c != '\n') return -1;
+                dec->state = CHUNK_SIZE;
+                break;
+            case CHUNK_TRAILER:
+                if (c == '\r') {
+                    in++;
+                    dec->state = CHUNK_TRAILER_LF;
+                } else if (c == '\n') {
+                    in++;
+                    dec->state = CHUNK_DONE;
+                } else {
+                    dec->state = CHUNK_TRAILER_LINE;
+                }
+                break;
+            case CHUNK_TRAILER_LINE:
+                in++;
+                if (c == '\n') dec->state = CHUNK_TRAILER;
+                break;
+            case CHUNK_TRAILER_LF:
+                in++;
+                if (c != '\n') return -1;
+                dec->state = CHUNK_DONE;
+                break;
+            case CHUNK_DONE:
+                break;
         }
-        n += written;
     }
 
-    if (body && body_len > 0 && n + (int)body_len < (int)max_len) {
-        memcpy(buf + n, body, body_len);
-        n += body_len;
-    } else if (body && body_len > 0) {
-        return -1;
+    *out_len = out;
+    *consumed = in;
+    return dec->state == CHUNK_DONE ? 1 : 0;
+}
+
+#define HTTP_HASH_SEED  2166136261u     /* FNV-1a offset basis */
+#define HTTP_HASH_PRIME 16777619u
+
+/* FNV-1a over the lower-cased bytes of a header name */
+static uint32_t header_hash(const char *name, size_t len) {
+    uint32_t hash = HTTP_HASH_SEED;
+    for (size_t i = 0; i < len; i++) {
+        unsigned char c = (unsigned char)name[i];
+        if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+        hash = (hash ^ c) * HTTP_HASH_PRIME;
     }
+    return hash;
+}
 
-    return n;
+/* Classify a header the client acts on; their name lengths are distinct */
+static int known_header(const char *name, size_t len) {
+    switch (len) {
+        case 10: return strcasecmp(name, "Connection") == 0 ? HTTP_HDR_CONNECTION : -1;
+        case 11: return strcasecmp(name, "Retry-After") == 0 ? HTTP_HDR_RETRY_AFTER : -1;
+        case 14: return strcasecmp(name, "Content-Length") == 0 ? HTTP_HDR_CONTENT_LENGTH : -1;
+        case 16: return strcasecmp(name, "Content-Encoding") == 0 ? HTTP_HDR_CONTENT_ENCODING : -1;
+        case 17: return strcasecmp(name, "Transfer-Encoding") == 0 ? HTTP_HDR_TRANSFER_ENCODING : -1;
+        default: return -1;
+    }
 }
 
-/* Parse HTTP response */
-static int parse_response(const char *data, size_t len, struct http_response *response) {
+/* Parse status line and headers of a complete header block in one pass, in
+ * place: names and values are NUL-terminated slices of data, indexed by
+ * name hash, and the known headers are noted as they go by.
+ * http10: set for an HTTP/1.0 status line
+ */
+static int parse_head(struct http_client *client, char *data, size_t header_len,
+                      struct http_response *response, int *http10) {
+    char *p = data;
+    char *end = data + header_len;
+    int status = 0;
+    int digits = 0;
+    int count = 0;
+
     http_response_clear(response);
-    
-    /* Parse status line */
-    int status;
-    if (sscanf(data, "HTTP/%*s %d", &status) != 1) {
-        return HTTP_ERR_PARSE;
+
+    /* Status line: HTTP/<version> <code> [reason] */
+    if (header_len < 5 || memcmp(p, "HTTP/", 5) != 0) return HTTP_ERR_PARSE;
+    *http10 = header_len >= 8 && memcmp(p + 5, "1.0", 3) == 0;
+    p += 5;
+    while (p < end && *p != ' ' && *p != '\n') p++;
+    while (p < end && *p == ' ') p++;
+    while (p < end && *p >= '0' && *p <= '9' && digits < 3) {
+        status = status * 10 + (*p++ - '0');
+        digits++;
     }
+    if (digits == 0) return HTTP_ERR_PARSE;
+    p = memchr(p, '\n', (size_t)(end - p));
+    if (!p) return HTTP_ERR_PARSE;
+    p++;
     response->status_code = status;
-    
-    /* Find body start */
-    const char *body_start = strstr(data, "\r\n\r\n");
-    if (!body_start) {
-        /* Try single newlines */
-        body_start = strstr(data, "\n\n");
-        if (!body_start) {
-            return HTTP_ERR_PARSE;
-        }
-        body_start += 2;
-    } else {
-        body_start += 4;
-    }
-    
-    /* Parse headers */
-    const char *header_start = strstr(data, "\r\n");
-    if (header_start) {
-        header_start += 2;
-        
-        while (header_start < body_start && response->num_headers < HTTP_MAX_HEADERS) {
-            const char *line_end = strstr(header_start, "\r\n");
-            if (!line_end || line_end >= body_start) break;
-            
-            /* Parse header line */
-            char name[HTTP_MAX_HEADER_NAME];
-            char value[HTTP_MAX_HEADER_VALUE];
-            if (sscanf(header_start, "%63[^:]: %511[^\r]", name, value) == 2) {
-                strncpy(response->headers[response->num_headers].name, name, 
-                        HTTP_MAX_HEADER_NAME - 1);
-                strncpy(response->headers[response->num_headers].value, value,
-                        HTTP_MAX_HEADER_VALUE - 1);
-                response->num_headers++;
-            }
-            
-            header_start = line_end + 2;
+
+    while (p < end) {
+        char *name = p;
+        char *value;
+        char *value_end;
+        char *eol;
+        size_t name_len;
+        uint32_t hash = HTTP_HASH_SEED;
+        int kind;
+
+        /* Name, hashed case-insensitively as it is scanned */
+        while (p < end && *p != ':' && *p != '\n') {
+            unsigned char c = (unsigned char)*p++;
+            if (c >= 'A' && c <= 'Z') c += 'a' - 'A';
+            hash = (hash ^ c) * HTTP_HASH_PRIME;
         }
-    }
-    
-    /* Extract body */
-    size_t body_len = len - (body_start - data);
-    if (body_len > 0) {
-        if (body_len > HTTP_MAX_RESPONSE_SIZE - 1) {
-            body_len = HTTP_MAX_RESPONSE_SIZE - 1;
+        eol = memchr(p, '\n', (size_t)(end - p));
+        if (!eol) break;
+        if (*p != ':' || p == name) {
+            p = eol + 1;    /* Blank line or not a header */
+            continue;
+        }
+        name_len = (size_t)(p - name);
+        *p++ = '\0';
+
+        while (p < eol && (*p == ' ' || *p == '\t')) p++;
+        value = p;
+        value_end = eol;
+        while (value_end > value &&
+               (value_end[-1] == '\r' || value_end[-1] == ' ' || value_end[-1] == '\t')) {
+            value_end--;
+        }
+        *value_end = '\0';
+        p = eol + 1;
+
+        if (count == client->hdr_cap) {
+            int cap = client->hdr_cap ? client->hdr_cap * 2 : 16;
+            struct http_header_view *hdrs = realloc(client->hdrs, (size_t)cap * sizeof(*hdrs));
+            if (!hdrs) return HTTP_ERR_NOMEM;
+            client->hdrs = hdrs;
+            client->hdr_cap = cap;
         }
-        memcpy(response->body, body_start, body_len);
-        response->body[body_len] = '\0';
-        response->body_len = body_len;
+        client->hdrs[count].name = name;
+        client->hdrs[count].value = value;
+        client->hdrs[count].hash = hash;
+
+        kind = known_header(name, name_len);
+        if (kind >= 0 && response->known[kind] < 0) response->known[kind] = count;
+        count++;
     }
-    
+
+    /* Chain back to front so each bucket lists headers in received order */
+    for (int i = count - 1; i >= 0; i--) {
+        int *bucket = &response->buckets[client->hdrs[i].hash & (HTTP_HEADER_BUCKETS - 1)];
+        client->hdrs[i].next = *bucket;
+        *bucket = i;
+    }
+    response->headers = client->hdrs;
+    response->num_headers = count;
     return 0;
 }
 
-/* HTTP GET */
-HTTP_WEAK int http_get(struct http_client *client, const char *path,
-                      const struct http_header *headers, int num_headers,
-                      struct http_response *response) {
-    int ret;
-    
-    ret = http_connect(client);
-    if (ret != 0) return ret;
-    
-    char request[4096];
-    int req_len = build_request(request, sizeof(request),
-                                "GET", path, client->hostname,
-                                headers, num_headers, NULL, 0);
-    if (req_len < 0) {
-        return HTTP_ERR_NOMEM;
+static const char *known_value(const struct http_response *response,
+                               enum http_known_header kind) {
+    int i = response->known[kind];
+    return i >= 0 ? response->headers[i].value : NULL;
+}
+
+/* Derive body framing from a parsed response head */
+static void parse_framing(const struct http_response *response, int http10,
+                          size_t header_len, struct http_framing *framing) {
+    const char *value;
+    int status = response->status_code;
+
+    framing->header_len = header_len;
+    framing->content_length = -1;
+
+    value = known_value(response, HTTP_HDR_CONNECTION);
+    if (http10) {
+        framing->keep_alive = value && header_has_token(value, (int)strlen(value), "keep-alive");
+    } else {
+        framing->keep_alive = !(value && header_has_token(value, (int)strlen(value), "close"));
     }
 
-    ret = http_send(client, request, req_len);
-    if (ret != 0) return ret;
-    
-    char raw_response[HTTP_MAX_RESPONSE_SIZE + 1024];
-    size_t resp_len;
-    ret = http_recv(client, raw_response, sizeof(raw_response), &resp_len);
-    if (ret != 0) return ret;
-    
-    return parse_response(raw_response, resp_len, response);
-}
+    /* Only what build_request advertises; anything else is passed through */
+    value = known_value(response, HTTP_HDR_CONTENT_ENCODING);
+    if (value && header_has_token(value, (int)strlen(value), "gzip")) {
+        framing->compressed = 1;
+        framing->format = INFLATE_GZIP;
+    } else if (value && header_has_token(value, (int)strlen(value), "deflate")) {
+        framing->compressed = 1;
+        framing->format = INFLATE_ZLIB;
+    }
 
-/* HTTP POST */
-HTTP_WEAK int http_post(struct http_client *client, const char *path,
-                       const struct http_header *headers, int num_headers,
-                       const char *body, size_t body_len,
-                       struct http_response *response) {
-    int ret;
-    
-    ret = http_connect(client);
-    if (ret != 0) return ret;
-    
-    char request[4096 + 8192];  /* Allow for larger POST bodies */
-    int req_len = build_request(request, sizeof(request),
-                                "POST", path, client->hostname,
-                                headers, num_headers, body, body_len);
-    if (req_len < 0) {
-        return HTTP_ERR_NOMEM;
+    /* These never carry a body, whatever the headers say */
+    if ((status >= 100 && status < 200) || status == 204 || status == 304) {
+        framing->content_length = 0;
+        return;
     }
-    
-    ret = http_send(client, request, req_len);
-    if (ret != 0) return ret;
-    
-    char raw_response[HTTP_MAX_RESPONSE_SIZE + 1024];
-    size_t resp_len;
-    ret = http_recv(client, raw_response, sizeof(raw_response), &resp_len);
-    if (ret != 0) return ret;
-    
-    return parse_response(raw_response, resp_len, response);
-}
 
-/* Clear response */
-HTTP_WEAK void http_response_clear(struct http_response *response) {
-    memset(response, 0, sizeof(*response));
+    /* Chunked wins over Content-Length (RFC 9112 6.3) */
+    value = known_value(response, HTTP_HDR_TRANSFER_ENCODING);
+    if (value && header_has_token(value, (int)strlen(value), "chunked")) {
+        framing->chunked = 1;
+        return;
+    }
+
+    value = known_value(response, HTTP_HDR_CONTENT_LENGTH);
+    if (value && value[0] != '\0') {
+        char *end;
+        long long cl = strtoll(value, &end, 10);
+        if (end != value && cl >= 0) {
+            framing->content_length = cl;
+            return;
+        }
+    }
+
+    framing->keep_alive = 0;
 }
 
-/* Get header value */
-HTTP_WEAK const char *http_response_get_header(const struct http_response *response, const char *name) {
+/* Grow the receive buffer towards limit, re-pointing any header views
+ * already parsed into it */
+static int http_rx_grow(struct http_client *client, size_t limit,
+                        struct http_response *response) {
+    size_t cap = client->rx_cap ? client->rx_cap * 2 : HTTP_RX_BUF_INITIAL;
+    char *old = client->rx_buf;
+    char *buf;
+
+    if (cap > limit) cap = limit;
+    buf = malloc(cap);
+    if (!buf) return HTTP_ERR_NOMEM;
+    if (old) memcpy(buf, old, client->rx_cap);
+
     for (int i = 0; i < response->num_headers; i++) {
-        if (strcasecmp(response->headers[i].name, name) == 0) {
+        client->hdrs[i].name = buf + (client->hdrs[i].name - old);
+        client->hdrs[i].value = buf + (client->hdrs[i].value - old);
+    }
+    free(old);
+    client->rx_buf = buf;
+    client->rx_cap = cap;
+    return 0;
+}
+
+static int retryable_status(int status) {
+    return status == 429 || status == 502 || status == 503 || status == 504;
+}
+
+static long long days_from_civil(int y, int m, int d) {
+    y -= m <= 2;
+    long long era = (y >= 0 ? y : y - 399) / 400;
+    long long yoe = y - era * 400;
+    long long doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    long long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + doe - 719468;
+}
+
+/* Retry-After as a wait: delta-seconds or an IMF-fixdate HTTP-date
+ * returns: milliseconds, or -1 if absent or not understood
+ */
+static long retry_after_ms(const struct http_response *response) {
+    static const char months[] = "JanFebMarAprMayJunJulAugSepOctNovDec";
+    const char *value = known_value(response, HTTP_HDR_RETRY_AFTER);
+    char mon[4];
+    int d, y, hh, mm, ss;
+
+    if (!value) return -1;
+    if (value[0] >= '0' && value[0] <= '9') {
+        char *end;
+        long secs = strtol(value, &end, 10);
+        if (*end != '\0' || secs > 86400) return -1;
+        return secs * 1000;
+    }
+    if (sscanf(value, "%*3s, %d %3s %d %d:%d:%d GMT", &d, mon, &y, &hh, &mm, &ss) == 6) {
+        const char *m = strstr(months, mon);
+        if (!m || (m - months) % 3 != 0) return -1;
+        long long at = days_from_civil(y, (int)(m - months) / 3 + 1, d) * 86400 +
+                       hh * 3600 + mm * 60 + ss;
+        long long wait = at - (long long)time(NULL);
+        if (wait > 86400) return -1;
+        return wait > 0 ? (long)wait * 1000 : 0;
+    }
+    return -1;
+}
+
+/* Whether a response with this head is certain to be retried, so its body
+ * is not the caller's: the attempt is armed, the status is retryable and
+ * any Retry-After fits the longest wait the policy allows */
+static int retry_certain(const struct http_client *client,
+                         const struct http_response *response) {
+    int status = response->status_code;
+
+    if (!client->retry_armed || !retryable_status(status)) return 0;
+    if (status != 429 && status != 503) return 1;
+    return retry_after_ms(response) <= client->retry.max_delay_ms;
+}
+
+static int discard_body(const char *data, size_t len, void *user_data) {
+    (void)data;
+    (void)len;
+    (void)user_data;
+    return 0;
+}
+
+/* Where inflated body bytes go: the caller's sink or the client's body buffer */
+struct http_inflate_sink {
+    struct http_client *client;
+    http_body_cb on_body;
+    void *user_data;
+    size_t limit;       /* Largest buffered body */
+    size_t len;         /* Inflated bytes so far */
+    int truncated;      /* Buffered body hit limit */
+    int error;          /* Why the sink stopped the stream */
+};
+
+static int http_inflate_out(const unsigned char *data, size_t len, void *user_data) {
+    struct http_inflate_sink *sink = user_data;
+    struct http_client *client = sink->client;
+
+    if (sink->on_body) {
+        client->body_delivered = sink->on_body != discard_body;
+        while (len > 0) {
+            size_t n = len < HTTP_STREAM_BUF_SIZE ? len : HTTP_STREAM_BUF_SIZE;
+            if (sink->on_body((const char *)data, n, sink->user_data) != 0) {
+                sink->error = HTTP_ERR_ABORTED;
+                return -1;
+            }
+            data += n;
+            len -= n;
+            sink->len += n;
+        }
+        return 0;
+    }
+
+    if (len > sink->limit - sink->len) {
+        len = sink->limit - sink->len;
+        sink->truncated = 1;
+    }
+    if (sink->len + len + 1 > client->body_cap) {
+        size_t cap = client->body_cap ? client->body_cap : HTTP_RX_BUF_INITIAL;
+        char *buf;
+        while (cap < sink->len + len + 1) cap *= 2;
+        if (cap > sink->limit + 1) cap = sink->limit + 1;
+        buf = realloc(client->body_buf, cap);
+        if (!buf) {
+            sink->error = HTTP_ERR_NOMEM;
+            return -1;
+        }
+        client->body_buf = buf;
+        client->body_cap = cap;
+    }
+    memcpy(client->body_buf + sink->len, data, len);
+    sink->len += len;
+    return sink->truncated ? -1 : 0;
+}
+
+/* One response being received: what http_recv keeps between reads */
+struct http_reader {
+    size_t max_len;         /* Receive buffer limit */
+    http_body_cb on_body;
+    void *user_data;
+    struct http_response *response;
+    size_t total;           /* Bytes held in the buffer */
+    size_t body_start;      /* Offset of the body in the buffer */
+    size_t body_len;        /* Body bytes received so far */
+    size_t pending;         /* Input already buffered by an earlier read */
+    int have_head;
+    struct http_framing framing;
+    struct http_chunked chunked;
+    struct http_inflate_sink sink;
+    int inflated;           /* Compressed stream complete */
+    int truncated;
+    size_t surplus_off;     /* Bytes past the end of the response */
+    size_t surplus_len;
+    long long first_byte_us;
+};
+
+static void reader_begin(struct http_client *client, struct http_reader *r, size_t max_len,
+                         http_body_cb on_body, void *user_data,
+                         struct http_response *response) {
+    memset(r, 0, sizeof(*r));
+    r->max_len = max_len;
+    r->on_body = on_body;
+    r->user_data = user_data;
+    r->response = response;
+    r->pending = client->rx_pending_len;
+    http_response_clear(response);
+    if (r->pending > 0) {
+        memmove(client->rx_buf, client->rx_buf + client->rx_pending_off, r->pending);
+        client->rx_pending_len = 0;
+    }
+}
+
+/* Body delimited by the peer closing the connection */
+static int reader_until_close(const struct http_reader *r) {
+    return r->have_head && !r->framing.chunked && r->framing.content_length < 0;
+}
+
+/* Make room for the next read at client->rx_buf + r->total
+ * returns: 0 with *room set, 1 if the buffer is full and the response is
+ *          cut short there, or negative error
+ */
+static int reader_buffer(struct http_client *client, struct http_reader *r, size_t *room) {
+    if (r->total + 1 >= client->rx_cap) {
+        if (client->rx_cap >= r->max_len) {
+            if (!r->have_head) return HTTP_ERR_PARSE;  /* Header block too large */
+            r->truncated = 1;  /* Response larger than our buffer */
+            return 1;
+        }
+        int ret = http_rx_grow(client, r->max_len, r->response);
+        if (ret != 0) return ret;
+    }
+
+    *room = client->rx_cap - r->total - 1;
+    if (r->on_body && *room > HTTP_STREAM_BUF_SIZE) *room = HTTP_STREAM_BUF_SIZE;
+    return 0;
+}
+
+/* The peer closed the connection
+ * returns: 1 if that ends the response, or negative error
+ */
+static int reader_closed(const struct http_reader *r) {
+    if (r->total == 0 && !r->have_head) return HTTP_ERR_CLOSED;
+    if (reader_until_close(r)) return 1;
+    return HTTP_ERR_RECV;  /* Connection closed mid-response */
+}
+
+/* Take n bytes just read into client->rx_buf + r->total
+ * returns: 0 if more input is needed, 1 when the response is complete, or
+ *          negative error
+ */
+static int reader_input(struct http_client *client, struct http_reader *r, size_t n) {
+    char *buf = client->rx_buf;
+    size_t start = r->total;
+
+    r->total += n;
+    client->timing.bytes_received += n;
+    if (!r->first_byte_us) {
+        r->first_byte_us = monotonic_us();
+        client->timing.us[HTTP_PHASE_TTFB] = (uint32_t)(r->first_byte_us - client->sent_us);
+        client->timing.done |= 1u << HTTP_PHASE_TTFB;
+    }
+
+    if (!r->have_head) {
+        size_t scan_from = start > 3 ? start - 3 : 0;
+        size_t header_len = find_header_end(buf + scan_from, r->total - scan_from);
+        if (header_len == 0) return 0;
+        int http10;
+        int ret = parse_head(client, buf, scan_from + header_len, r->response, &http10);
+        if (ret != 0) return ret;
+        parse_framing(r->response, http10, scan_from + header_len, &r->framing);
+
+        /* A response that is going to be retried is not the caller's */
+        if (r->on_body && retry_certain(client, r->response)) {
+            r->on_body = discard_body;
+        }
+        r->have_head = 1;
+        start = r->body_start = r->framing.header_len;
+
+        if (r->framing.compressed) {
+            if (!client->inflater) {
+                client->inflater = malloc(sizeof(*client->inflater));
+                if (!client->inflater) return HTTP_ERR_NOMEM;
+            }
+            inflate_init(client->inflater, r->framing.format);
+            r->sink.client = client;
+            r->sink.on_body = r->on_body;
+            r->sink.user_data = r->user_data;
+            r->sink.limit = r->max_len - HTTP_RX_HEADER_ROOM;
+        }
+    }
+
+    int complete = 0;
+    if (r->framing.chunked) {
+        size_t decoded;
+        size_t consumed;
+        int rc = chunked_decode(&r->chunked, buf + start, r->total - start,
+                                &decoded, &consumed);
+        if (rc < 0) return HTTP_ERR_PARSE;
+        if (rc == 1) {
+            r->surplus_off = start + consumed;
+            r->surplus_len = r->total - r->surplus_off;
+        }
+        r->total = start + decoded;
+        complete = (rc == 1);
+    } else if (r->framing.content_length >= 0) {
+        size_t want = (size_t)r->framing.content_length - r->body_len;
+        if (r->total - start >= want) {
+            r->surplus_off = start + want;
+            r->surplus_len = r->total - r->surplus_off;
+            r->total = start + want;
+            complete = 1;
+        }
+    }
+    r->body_len += r->total - start;
+
+    if (r->framing.compressed) {
+        if (r->total > r->body_start) {
+            int rc = inflate_write(client->inflater,
+                                   (const unsigned char *)buf + r->body_start,
+                                   r->total - r->body_start, http_inflate_out, &r->sink);
+            r->total = r->body_start;
+            if (rc == INFLATE_ERR_ABORT && r->sink.truncated) {
+                r->truncated = 1;
+                return 1;
+            }
+            if (rc == INFLATE_ERR_ABORT) return r->sink.error;
+            if (rc < 0) return HTTP_ERR_PARSE;
+            r->inflated = (rc == INFLATE_DONE);
+        }
+    } else if (r->on_body) {
+        if (r->total > r->body_start) {
+            client->body_delivered = r->on_body != discard_body;
+            if (r->on_body(buf + r->body_start, r->total - r->body_start, r->user_data) != 0) {
+                return HTTP_ERR_ABORTED;
+            }
+        }
+        r->total = r->body_start;
+    }
+    return complete;
+}
+
+/* Finish a complete response: point the response at its body and keep any
+ * surplus bytes as pending input
+ * keep_alive: set when the connection can carry another request
+ */
+static int reader_end(struct http_client *client, struct http_reader *r, int *keep_alive) {
+    struct http_response *response = r->response;
+
+    client->timing.bytes_received -= r->surplus_len;
+    phase_end(&client->timing, HTTP_PHASE_TRANSFER, &r->first_byte_us);
+    if (r->surplus_len > 0) {
+        /* Step past the body's terminating NUL; the read left room for it */
+        memmove(client->rx_buf + r->surplus_off + 1, client->rx_buf + r->surplus_off,
+                r->surplus_len);
+        client->rx_pending_off = r->surplus_off + 1;
+        client->rx_pending_len = r->surplus_len;
+    }
+    client->rx_buf[r->total] = '\0';
+    response->body = client->rx_buf + r->body_start;
+    response->body_len = r->body_len;
+    if (r->framing.compressed) {
+        if (r->body_len > 0 && !r->inflated && !r->truncated) {
+            return HTTP_ERR_PARSE;  /* Compressed stream cut short */
+        }
+        if (!r->on_body && r->sink.len > 0) {
+            client->body_buf[r->sink.len] = '\0';
+            response->body = client->body_buf;
+        }
+        response->body_len = r->sink.len;
+    }
+    *keep_alive = r->framing.keep_alive && !r->truncated;
+    return 0;
+}
+
+/* Read from the client's connection into buf */
+static ssize_t conn_read(struct http_client *client, char *buf, size_t len) {
+    return client->use_tls ? mbedtls_recv(&client->conn->tls_ctx, buf, len) :
+                             recv(client->conn->socket_fd, buf, len, 0);
+}
+
+/* Receive exactly one response into the client's receive buffer, framed by
+ * chunked encoding or Content-Length when present. Chunked bodies are
+ * decoded in place as they arrive, and gzip/deflate bodies are inflated
+ * behind that. Status and headers are parsed as soon as the header block
+ * is complete.
+ * max_len: receive buffer limit
+ * on_body: when set, decoded body bytes are handed over after every read and
+ *          the space after the header block is reused; otherwise the body
+ *          accumulates there (or, inflated, in the client's body buffer) and
+ *          response->body points at it
+ * keep_alive: set when the connection can carry another request
+ * Bytes read past the end of the response are kept as pending input for
+ * the next http_recv on the same connection (pipelining).
+ * returns: 0, HTTP_ERR_CLOSED if the peer closed before sending anything,
+ *          or another negative error
+ */
+static int http_recv(struct http_client *client, size_t max_len,
+                     http_body_cb on_body, void *user_data,
+                     struct http_response *response, int *keep_alive) {
+    struct http_reader r;
+    int ret = 0;
+
+    *keep_alive = 0;
+    reader_begin(client, &r, max_len, on_body, user_data, response);
+
+    while (ret == 0) {
+        size_t room;
+        ssize_t n;
+
+        ret = reader_buffer(client, &r, &room);
+        if (ret != 0) break;
+
+        if (r.pending > 0) {
+            n = (ssize_t)r.pending;
+            r.pending = 0;
+        } else {
+            n = conn_read(client, client->rx_buf + r.total, room);
+        }
+
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            if ((errno == EAGAIN || errno == EWOULDBLOCK) && reader_until_close(&r)) {
+                break;  /* Timeout on a close-delimited body: keep what we have */
+            }
+            if (errno == EAGAIN || errno == EWOULDBLOCK) return HTTP_ERR_TIMEOUT;
+            return r.total == 0 && !r.have_head ? HTTP_ERR_CLOSED : HTTP_ERR_RECV;
+        }
+        ret = n == 0 ? reader_closed(&r) : reader_input(client, &r, (size_t)n);
+    }
+    if (ret < 0) return ret;
+    return reader_end(client, &r, keep_alive);
+}
+
+/* Build the request line and headers; the body is sent separately
+ * body_len: announced as Content-Length when non-zero
+ */
+static int build_request(char *buf, size_t max_len,
+                         const char *method, const char *path,
+                         const char *hostname,
+                         const struct http_header *headers, int num_headers,
+                         const char *body, size_t body_len) {
+    int ipv6 = strchr(hostname, ':') != NULL;  /* Literal needs brackets */
+    int n = snprintf(buf, max_len,
+        "%s %s HTTP/1.1\r\n"
+        "Host: %s%s%s\r\n"
+        "User-Agent: MikroClaw/0.1.0\r\n"
+        "Accept: application/json\r\n"
+        "Accept-Encoding: gzip, deflate\r\n",
+        method, path, ipv6 ? "[" : "", hostname, ipv6 ? "]" : "");
+    if (n < 0 || (size_t)n >= max_len) {
+        return -1;
+    }
+
+    if (body && body_len > 0) {
+        int written = snprintf(buf + n, max_len - n,
+            "Content-Type: application/json\r\n"
+            "Content-Length: %zu\r\n",
+            body_len);
+        if (written < 0 || (size_t)written >= (max_len - (size_t)n)) {
+            return -1;
+        }
+        n += written;
+    }
+
+    /* Add custom headers */
+    for (int i = 0; i < num_headers && n < (int)max_len - 1; i++) {
+        int written = snprintf(buf + n, max_len - n, "%s: %s\r\n",
+                      headers[i].name, headers[i].value);
+        if (written < 0 || (size_t)written >= (max_len - (size_t)n)) {
+            return -1;
+        }
+        n += written;
+    }
+
+    {
+        int written = snprintf(buf + n, max_len - n, "\r\n");
+        if (written < 0 || (size_t)written >= (max_len - (size_t)n)) {
+            return -1;
+        }
+        n += written;
+    }
+
+    return n;
+}
+
+/* Send one request over a pooled connection and read its response. A
+ * request that fails on a reused keep-alive connection before any response
+ * byte arrives is retried once on a fresh connection: the server closed the
+ * idle socket under us. */
+static int http_exchange(struct http_client *client, const char *head, size_t head_len,
+                        const char *body, size_t body_len,
+                        http_body_cb on_body, void *user_data,
+                        struct http_response *response) {
+    size_t max_len = HTTP_RX_HEADER_ROOM +
+                     (on_body ? HTTP_STREAM_BUF_SIZE : HTTP_MAX_RESPONSE_SIZE);
+    int keep_alive;
+    int ret;
+
+    http_response_clear(response);
+    timing_start(client);
+    for (int attempt = 0; attempt < 2; attempt++) {
+        ret = http_connect(client);
+        if (ret != 0) break;
+
+        int reused = client->conn->requests > 0;
+
+        ret = http_send(client, head, head_len, body, body_len);
+        if (ret == 0) {
+            ret = http_recv(client, max_len, on_body, user_data, response, &keep_alive);
+        }
+        if (client->rx_pending_len > 0) {
+            keep_alive = 0;     /* Unsolicited bytes after the response */
+            client->rx_pending_len = 0;
+        }
+        if (ret != 0) {
+            http_conn_close(client->conn);
+            if (reused && (ret == HTTP_ERR_SEND || ret == HTTP_ERR_CLOSED)) continue;
+            if (ret == HTTP_ERR_CLOSED) ret = HTTP_ERR_RECV;
+            break;
+        }
+
+        client->conn->requests++;
+        http_pool_release(client->conn, keep_alive);
+        client->conn = NULL;
+        timing_finish(client, &response->timing, 0);
+        return 0;
+    }
+
+    http_pool_release(client->conn, 0);
+    client->conn = NULL;
+    timing_finish(client, &response->timing, ret);
+    return ret;
+}
+
+/* Per-origin retry budget, in tenths of a token */
+struct retry_budget {
+    char hostname[HTTP_MAX_HOSTNAME];
+    uint16_t port;
+    bool use_tls;
+    int tokens;
+    unsigned long last_used;    /* 0: slot free */
+};
+
+static struct retry_budget g_budgets[HTTP_RETRY_ORIGINS];
+static unsigned long g_budget_clock;
+static uint64_t g_jitter_state;
+
+static struct retry_budget *retry_budget_for(const struct http_client *client) {
+    struct retry_budget *victim = &g_budgets[0];
+
+    for (int i = 0; i < HTTP_RETRY_ORIGINS; i++) {
+        struct retry_budget *b = &g_budgets[i];
+        if (b->last_used && b->port == client->port && b->use_tls == client->use_tls &&
+            strcmp(b->hostname, client->hostname) == 0) {
+            b->last_used = ++g_budget_clock;
+            return b;
+        }
+        if (b->last_used < victim->last_used) victim = b;
+    }
+
+    snprintf(victim->hostname, sizeof(victim->hostname), "%s", client->hostname);
+    victim->port = client->port;
+    victim->use_tls = client->use_tls;
+    victim->tokens = HTTP_RETRY_BUDGET * 10;
+    victim->last_used = ++g_budget_clock;
+    return victim;
+}
+
+/* Uniform in [lo, hi] (xorshift64*, seeded once per process) */
+static long jitter_between(long lo, long hi) {
+    uint64_t x = g_jitter_state;
+
+    if (x == 0) {
+        x = (uint64_t)monotonic_us() ^ ((uint64_t)getpid() << 32) ^ 0x9e3779b97f4a7c15ull;
+    }
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    g_jitter_state = x;
+    x *= 0x2545f4914f6cdd1dull;
+    return hi <= lo ? lo : lo + (long)(x % (uint64_t)(hi - lo + 1));
+}
+
+static void sleep_ms(long ms) {
+    struct timespec ts = { ms / 1000, (ms % 1000) * 1000000L };
+    while (nanosleep(&ts, &ts) != 0 && errno == EINTR) {
+    }
+}
+
+/* Run a request under the client's retry policy (see http.h) */
+static int http_request(struct http_client *client, int idempotent,
+                        const char *head, size_t head_len,
+                        const char *body, size_t body_len,
+                        http_body_cb on_body, void *user_data,
+                        struct http_response *response) {
+    const struct http_retry_policy *policy = &client->retry;
+    long delay_ms = policy->base_delay_ms;
+
+    for (int attempt = 1; ; attempt++) {
+        struct retry_budget *budget = retry_budget_for(client);
+        int can_retry = attempt < policy->max_attempts &&
+                        budget->tokens > HTTP_RETRY_BUDGET * 10 / 2;
+        long wait_ms = -1;
+        int retryable;
+
+        client->retry_armed = can_retry && idempotent;
+        client->body_delivered = 0;
+        int ret = http_exchange(client, head, head_len, body, body_len,
+                                on_body, user_data, response);
+        client->retry_armed = 0;
+
+        if (ret == 0) {
+            retryable = idempotent && retryable_status(response->status_code);
+            if (retryable && (response->status_code == 429 || response->status_code == 503)) {
+                wait_ms = retry_after_ms(response);
+            }
+        } else {
+            retryable = ret == HTTP_ERR_CONNECT ||
+                        (idempotent && (ret == HTTP_ERR_SEND || ret == HTTP_ERR_RECV ||
+                                        ret == HTTP_ERR_TIMEOUT));
+        }
+        if (retryable && on_body && client->body_delivered) {
+            retryable = 0;  /* The caller already has part of this body */
+        }
+
+        /* Successes refill the budget slowly, failures drain it */
+        if (retryable) {
+            budget->tokens -= 10;
+            if (budget->tokens < 0) budget->tokens = 0;
+        } else if (budget->tokens < HTTP_RETRY_BUDGET * 10) {
+            budget->tokens++;
+        }
+
+        if (!retryable || !can_retry) return ret;
+        if (wait_ms < 0) {
+            delay_ms = jitter_between(policy->base_delay_ms, delay_ms * 3);
+            if (delay_ms > policy->max_delay_ms) delay_ms = policy->max_delay_ms;
+            wait_ms = delay_ms;
+        } else if (wait_ms > policy->max_delay_ms) {
+            return ret;     /* Server asks for a longer pause than we wait */
+        }
+        sleep_ms(wait_ms);
+    }
+}
+
+/* Build the header block and run the request */
+static int http_do(struct http_client *client, const char *method, const char *path,
+                   const struct http_header *headers, int num_headers,
+                   const char *body, size_t body_len,
+                   http_body_cb on_body, void *user_data,
+                   struct http_response *response) {
+    char head[HTTP_REQUEST_HEAD_SIZE];
+    int head_len = build_request(head, sizeof(head), method, path, client->hostname,
+                                 headers, num_headers, body, body_len);
+    if (head_len < 0) {
+        return HTTP_ERR_NOMEM;
+    }
+
+    return http_request(client, strcmp(method, "GET") == 0 || client->retry.retry_post,
+                        head, head_len, body, body ? body_len : 0,
+                        on_body, user_data, response);
+}
+
+/* Pipelined GETs: send every outstanding request, then read responses in
+ * order until the batch is done or the connection gives out */
+HTTP_WEAK int http_get_batch(struct http_client *client,
+                            const struct http_header *headers, int num_headers,
+                            struct http_batch_item *items, int count) {
+    size_t max_len = HTTP_RX_HEADER_ROOM + HTTP_STREAM_BUF_SIZE;
+    int first_error = 0;
+    int next = 0;   /* First item without a response */
+
+    if (!client || (!items && count > 0)) {
+        return HTTP_ERR_NOMEM;
+    }
+    for (int i = 0; i < count; i++) {
+        items[i].status_code = 0;
+        items[i].result = HTTP_ERR_SEND;
+        memset(&items[i].timing, 0, sizeof(items[i].timing));
+    }
+    timing_start(client);
+
+    while (next < count) {
+        size_t cap = (size_t)(count - next) * HTTP_REQUEST_HEAD_SIZE;
+        char *reqs = malloc(cap);
+        size_t reqs_len = 0;
+        int keep_alive = 0;
+        int progressed = 0;
+        int reused;
+        int ret;
+
+        if (!reqs) {
+            ret = HTTP_ERR_NOMEM;
+        } else {
+            ret = http_connect(client);
+        }
+        if (ret != 0) {
+            free(reqs);
+            for (int i = next; i < count; i++) {
+                items[i].result = ret;
+                timing_finish(client, &items[i].timing, ret);
+                memset(&client->timing, 0, sizeof(client->timing));
+            }
+            if (!first_error) first_error = ret;
+            break;
+        }
+        reused = client->conn->requests > 0;
+
+        for (int i = next; i < count && ret == 0; i++) {
+            int n = build_request(reqs + reqs_len, cap - reqs_len, "GET", items[i].path,
+                                  client->hostname, headers, num_headers, NULL, 0);
+            if (n < 0) ret = HTTP_ERR_NOMEM;
+            else reqs_len += (size_t)n;
+        }
+        if (ret == 0) {
+            ret = http_send(client, reqs, reqs_len, NULL, 0);
+        }
+        free(reqs);
+
+        while (ret == 0 && next < count) {
+            struct http_response response;
+            ret = http_recv(client, max_len, items[next].on_body, items[next].user_data,
+                            &response, &keep_alive);
+            if (ret != 0) break;
+
+            items[next].status_code = response.status_code;
+            items[next].result = 0;
+            timing_finish(client, &items[next].timing, 0);
+            memset(&client->timing, 0, sizeof(client->timing));
+            client->timing.reused = true;   /* The rest ride this connection */
+            client->conn->requests++;
+            progressed = 1;
+            next++;
+            if (!keep_alive && next < count) {
+                ret = HTTP_ERR_CLOSED;  /* Rest of the pipeline was dropped */
+            }
+        }
+
+        if (ret == 0) {
+            http_pool_release(client->conn, keep_alive && client->rx_pending_len == 0);
+            client->rx_pending_len = 0;
+            client->conn = NULL;
+            break;
+        }
+
+        client->rx_pending_len = 0;
+        http_conn_close(client->conn);
+        http_pool_release(client->conn, 0);
+        client->conn = NULL;
+
+        /* Nothing of the next response arrived: resend it with the rest,
+         * unless a fresh connection could not even answer it */
+        if ((ret == HTTP_ERR_CLOSED || ret == HTTP_ERR_SEND) && (progressed || reused)) {
+            continue;
+        }
+        items[next].result = ret == HTTP_ERR_CLOSED ? HTTP_ERR_RECV : ret;
+        timing_finish(client, &items[next].timing, items[next].result);
+        memset(&client->timing, 0, sizeof(client->timing));
+        if (!first_error) first_error = items[next].result;
+        next++;
+    }
+
+    return first_error;
+}
+
+/* HTTP GET */
+HTTP_WEAK int http_get(struct http_client *client, const char *path,
+                      const struct http_header *headers, int num_headers,
+                      struct http_response *response) {
+    return http_do(client, "GET", path, headers, num_headers, NULL, 0,
+                   NULL, NULL, response);
+}
+
+/* HTTP POST */
+HTTP_WEAK int http_post(struct http_client *client, const char *path,
+                       const struct http_header *headers, int num_headers,
+                       const char *body, size_t body_len,
+                       struct http_response *response) {
+    return http_do(client, "POST", path, headers, num_headers, body, body_len,
+                   NULL, NULL, response);
+}
+
+/* HTTP GET, streamed */
+HTTP_WEAK int http_get_stream(struct http_client *client, const char *path,
+                             const struct http_header *headers, int num_headers,
+                             http_body_cb on_body, void *user_data,
+                             struct http_response *response) {
+    return http_do(client, "GET", path, headers, num_headers, NULL, 0,
+                   on_body, user_data, response);
+}
+
+/* HTTP POST, streamed */
+HTTP_WEAK int http_post_stream(struct http_client *client, const char *path,
+                              const struct http_header *headers, int num_headers,
+                              const char *body, size_t body_len,
+                              http_body_cb on_body, void *user_data,
+                              struct http_response *response) {
+    return http_do(client, "POST", path, headers, num_headers, body, body_len,
+                   on_body, user_data, response);
+}
+
+/* Asynchronous engine: the same connect race, pool and response reader as
+ * the blocking calls, driven by epoll readiness instead of blocking I/O */
+
+enum http_async_state {
+    ASYNC_QUEUED,           /* Waiting for a lease under the per-origin cap */
+    ASYNC_CONNECT,
+    ASYNC_TLS,
+    ASYNC_SEND,
+    ASYNC_RECV
+};
+
+/* A request in flight on an engine */
+struct http_async {
+    struct http_engine *engine;
+    struct http_client *client;
+    enum http_async_state state;
+    char *out;                  /* Request head and body */
+    size_t out_len;
+    size_t out_sent;
+    long long deadline;         /* Monotonic ms */
+    long long phase_us;         /* Start of the phase in progress */
+    int reused;                 /* Sent on a connection that served requests */
+    int cached;                 /* Race addresses came from the DNS cache */
+    int ready;                  /* Advance on the next engine pass */
+    int watch_fd;               /* Socket registered for the current state */
+    uint32_t watch_events;
+    struct connect_race race;
+    struct http_reader reader;
+    struct http_response response;
+    http_body_cb on_body;
+    http_done_cb on_done;
+    void *user_data;
+    struct http_async *next;
+};
+
+struct http_engine {
+    int epoll_fd;
+    struct http_async *requests;
+    int count;
+};
+
+static int set_nonblocking(int fd, int on) {
+    int flags = fcntl(fd, F_GETFL, 0);
+
+    if (flags < 0) return -1;
+    return fcntl(fd, F_SETFL, on ? flags | O_NONBLOCK : flags & ~O_NONBLOCK);
+}
+
+/* Readiness to wait for after a would-block: plain for a cleartext socket;
+ * for TLS, the direction mbedTLS asked for, which can be the other one (a
+ * read that has to flush, a write that has to read) */
+static uint32_t async_wait_events(struct http_client *client, uint32_t plain) {
+    if (client->use_tls) {
+        int want = mbedtls_tls_want(&client->conn->tls_ctx);
+        if (want == TLS_WANT_READ) return EPOLLIN;
+        if (want == TLS_WANT_WRITE) return EPOLLOUT;
+    }
+    return plain;
+}
+
+/* Wait for events on fd, moving the registration over from another state */
+static int async_watch(struct http_async *req, int fd, uint32_t events) {
+    struct epoll_event ev;
+
+    if (req->watch_fd == fd && req->watch_events == events) return 0;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = events;
+    ev.data.ptr = req;
+    if (epoll_ctl(req->engine->epoll_fd, EPOLL_CTL_MOD, fd, &ev) != 0 &&
+        (errno != ENOENT || epoll_ctl(req->engine->epoll_fd, EPOLL_CTL_ADD, fd, &ev) != 0)) {
+        return -1;
+    }
+    req->watch_fd = fd;
+    req->watch_events = events;
+    return 0;
+}
+
+/* Wait for any pending connect of the race; closed losers drop out of
+ * the epoll set by themselves */
+static int async_watch_race(struct http_async *req) {
+    for (int i = 0; i < req->race.npending; i++) {
+        struct epoll_event ev;
+
+        memset(&ev, 0, sizeof(ev));
+        ev.events = EPOLLOUT;
+        ev.data.ptr = req;
+        if (epoll_ctl(req->engine->epoll_fd, EPOLL_CTL_ADD, req->race.pending[i].fd, &ev) != 0 &&
+            errno != EEXIST) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/* Put the request on its leased connection: straight to sending if it is
+ * open, else resolve and start the connect race */
+static int async_connect(struct http_async *req) {
+    struct http_client *client = req->client;
+    struct http_conn *conn = client->conn;
+    long long left = req->deadline - monotonic_ms();
+    int ret;
+
+    if (conn->connected) {
+        if (set_nonblocking(conn->socket_fd, 1) != 0) return HTTP_ERR_CONNECT;
+        req->reused = conn->requests > 0;
+        req->watch_fd = -1;
+        req->state = ASYNC_SEND;
+        req->phase_us = monotonic_us();
+        return 0;
+    }
+
+    ret = race_resolve(&req->race, client->hostname, client->port, &client->timing,
+                       &req->cached);
+    if (ret < 0) return ret;
+    race_begin(&req->race, left < client->connect_timeout_ms ? (int)left :
+                                                               client->connect_timeout_ms);
+    req->reused = 0;
+    req->watch_fd = -1;
+    req->state = ASYNC_CONNECT;
+    req->phase_us = monotonic_us();
+    return 0;
+}
+
+/* Complete a request: hand the connection back (or close it), account the
+ * timing and, when notify is set, report to the caller */
+static void async_finish(struct http_async *req, int result, int keep_alive, int notify) {
+    struct http_engine *engine = req->engine;
+    struct http_client *client = req->client;
+    struct http_conn *conn = client->conn;
+    struct http_async **link = &engine->requests;
+
+    if (req->state == ASYNC_CONNECT) race_abort(&req->race);
+    if (req->watch_fd >= 0) epoll_ctl(engine->epoll_fd, EPOLL_CTL_DEL, req->watch_fd, NULL);
+    if (client->rx_pending_len > 0) {
+        keep_alive = 0;     /* Unsolicited bytes after the response */
+        client->rx_pending_len = 0;
+    }
+    if (!conn) {
+        /* Still queued for a lease */
+    } else if (result == 0) {
+        conn->requests++;
+        if (keep_alive && set_nonblocking(conn->socket_fd, 0) != 0) keep_alive = 0;
+        http_pool_release(conn, keep_alive);
+    } else {
+        http_conn_close(conn);
+        http_pool_release(conn, 0);
+    }
+    client->conn = NULL;
+    client->async = NULL;
+    timing_finish(client, &req->response.timing, result);
+
+    while (*link != req) link = &(*link)->next;
+    *link = req->next;
+    engine->count--;
+
+    if (notify) req->on_done(client, result, &req->response, req->user_data);
+    free(req->out);
+    free(req);
+}
+
+/* Run the request's state machine until it has to wait for its socket or
+ * it is done */
+static void async_advance(struct http_async *req) {
+    struct http_client *client = req->client;
+    struct http_conn *conn = client->conn;
+    int keep_alive = 0;
+    int ret;
+
+    for (;;) {
+        ret = 0;
+
+        if (req->state == ASYNC_CONNECT) {
+            int fd;
+
+            ret = race_step(&req->race, &fd);
+            if (ret == 1) {
+                if (async_watch_race(req) == 0) return;
+                race_abort(&req->race);
+                ret = HTTP_ERR_CONNECT;
+            }
+            phase_end(&client->timing, HTTP_PHASE_CONNECT, &req->phase_us);
+            if (ret == HTTP_ERR_CONNECT && req->cached) {
+                /* No cached address accepts: resolve once more */
+                dns_cache_invalidate(client->hostname);
+                ret = async_connect(req);
+                req->cached = 0;
+                if (ret == 0) continue;
+            }
+            if (ret != 0) break;
+
+            conn->socket_fd = fd;
+            req->watch_fd = fd;     /* Possibly registered during the race */
+            req->watch_events = 0;
+            set_timeout(fd, client->timeout_ms);    /* For later blocking use */
+            conn->timeout_ms = client->timeout_ms;
+            if (client->use_tls) {
+                conn->tls_ctx.socket_fd = fd;
+                if (mbedtls_connect_socket(&conn->tls_ctx, fd) != 0) {
+                    ret = HTTP_ERR_TLS;
+                    break;
+                }
+                req->state = ASYNC_TLS;
+            } else {
+                conn->connected = 1;
+                conn->requests = 0;
+                req->state = ASYNC_SEND;
+            }
+            continue;
+        }
+
+        if (req->state == ASYNC_TLS) {
+            int step = mbedtls_handshake_step(&conn->tls_ctx);
+
+            if (step == TLS_WANT_READ || step == TLS_WANT_WRITE) {
+                if (async_watch(req, conn->socket_fd,
+                                step == TLS_WANT_READ ? EPOLLIN : EPOLLOUT) == 0) {
+                    return;
+                }
+                step = -1;
+            }
+            phase_end(&client->timing, HTTP_PHASE_TLS, &req->phase_us);
+            if (step != 0) {
+                ret = HTTP_ERR_TLS;
+                break;
+            }
+            client->timing.tls_resumed = conn->tls_ctx.resumed;
+            conn->connected = 1;
+            conn->requests = 0;
+            req->state = ASYNC_SEND;
+            continue;
+        }
+
+        if (req->state == ASYNC_SEND) {
+            while (req->out_sent < req->out_len) {
+                const char *p = req->out + req->out_sent;
+                size_t len = req->out_len - req->out_sent;
+                ssize_t n = client->use_tls ? mbedtls_send(&conn->tls_ctx, p, len) :
+                                              send(conn->socket_fd, p, len, MSG_NOSIGNAL);
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    if (async_watch(req, conn->socket_fd,
+                                    async_wait_events(client, EPOLLOUT)) == 0) return;
+                }
+                if (n <= 0) {
+                    ret = HTTP_ERR_SEND;
+                    break;
+                }
+                req->out_sent += (size_t)n;
+            }
+            if (ret != 0) break;
+
+            phase_end(&client->timing, HTTP_PHASE_SEND, &req->phase_us);
+            client->timing.bytes_sent += req->out_len;
+            client->sent_us = req->phase_us;
+            reader_begin(client, &req->reader,
+                         HTTP_RX_HEADER_ROOM +
+                         (req->on_body ? HTTP_STREAM_BUF_SIZE : HTTP_MAX_RESPONSE_SIZE),
+                         req->on_body, req->user_data, &req->response);
+            req->state = ASYNC_RECV;
+            continue;
+        }
+
+        /* ASYNC_RECV */
+        {
+            struct http_reader *r = &req->reader;
+            size_t room;
+            ssize_t n;
+
+            ret = reader_buffer(client, r, &room);
+            if (ret == 0) {
+                if (r->pending > 0) {
+                    n = (ssize_t)r->pending;
+                    r->pending = 0;
+                } else {
+                    n = conn_read(client, client->rx_buf + r->total, room);
+                }
+                if (n < 0 && errno == EINTR) continue;
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                    if (async_watch(req, conn->socket_fd,
+                                    async_wait_events(client, EPOLLIN)) == 0) return;
+                }
+                if (n < 0) {
+                    ret = r->total == 0 && !r->have_head ? HTTP_ERR_CLOSED : HTTP_ERR_RECV;
+                } else {
+                    ret = n == 0 ? reader_closed(r) : reader_input(client, r, (size_t)n);
+                }
+            }
+            if (ret == 0) continue;
+            if (ret == 1) ret = reader_end(client, r, &keep_alive);
+            break;
+        }
+    }
+
+    /* A kept-alive connection the server closed while idle: reconnect once */
+    if ((ret == HTTP_ERR_SEND || ret == HTTP_ERR_CLOSED) && req->reused) {
+        if (req->watch_fd >= 0) {
+            epoll_ctl(req->engine->epoll_fd, EPOLL_CTL_DEL, req->watch_fd, NULL);
+        }
+        http_conn_close(conn);
+        req->out_sent = 0;
+        ret = async_connect(req);
+        if (ret == 0) {
+            req->ready = 1;
+            return;
+        }
+    }
+    if (ret == HTTP_ERR_CLOSED) ret = HTTP_ERR_RECV;
+    async_finish(req, ret, keep_alive, 1);
+}
+
+HTTP_WEAK struct http_engine *http_engine_create(void) {
+    struct http_engine *engine = calloc(1, sizeof(*engine));
+
+    if (!engine) return NULL;
+    engine->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (engine->epoll_fd < 0) {
+        free(engine);
+        return NULL;
+    }
+    return engine;
+}
+
+HTTP_WEAK void http_engine_destroy(struct http_engine *engine) {
+    if (!engine) return;
+
+    while (engine->requests) {
+        async_finish(engine->requests, HTTP_ERR_ABORTED, 0, 1);
+    }
+    close(engine->epoll_fd);
+    free(engine);
+}
+
+HTTP_WEAK int http_engine_submit(struct http_engine *engine, struct http_client *client,
+                                 const char *method, const char *path,
+                                 const struct http_header *headers, int num_headers,
+                                 const char *body, size_t body_len, int deadline_ms,
+                                 http_body_cb on_body, http_done_cb on_done, void *user_data) {
+    char head[HTTP_REQUEST_HEAD_SIZE];
+    struct http_async *req;
+    int head_len;
+    int ret;
+
+    if (!engine || !client || !method || !path || !on_done) return HTTP_ERR_NOMEM;
+    if (client->async || client->conn) return HTTP_ERR_BUSY;
+    if (!body) body_len = 0;
+
+    head_len = build_request(head, sizeof(head), method, path, client->hostname,
+                             headers, num_headers, body, body_len);
+    if (head_len < 0) return HTTP_ERR_NOMEM;
+
+    req = calloc(1, sizeof(*req));
+    if (!req) return HTTP_ERR_NOMEM;
+    req->out = malloc((size_t)head_len + body_len);
+    if (!req->out) {
+        free(req);
+        return HTTP_ERR_NOMEM;
+    }
+    memcpy(req->out, head, (size_t)head_len);
+    if (body_len > 0) memcpy(req->out + head_len, body, body_len);
+    req->out_len = (size_t)head_len + body_len;
+    req->engine = engine;
+    req->client = client;
+    req->deadline = monotonic_ms() + (deadline_ms > 0 ? deadline_ms : client->timeout_ms);
+    req->watch_fd = -1;
+    req->on_body = on_body;
+    req->on_done = on_done;
+    req->user_data = user_data;
+    http_response_clear(&req->response);
+
+    client->conn = http_pool_acquire(client->hostname, client->port, client->use_tls);
+    if (!client->conn && errno != EBUSY) {
+        free(req->out);
+        free(req);
+        return client->use_tls ? HTTP_ERR_TLS : HTTP_ERR_NOMEM;
+    }
+    client->async = req;
+    client->retry_armed = 0;
+    timing_start(client);
+    req->next = engine->requests;
+    engine->requests = req;
+    engine->count++;
+
+    if (!client->conn) {
+        req->state = ASYNC_QUEUED;  /* Origin at its cap: wait for a lease */
+        return 0;
+    }
+    client->timing.reused = client->conn->connected;
+    ret = async_connect(req);
+    if (ret != 0) {
+        async_finish(req, ret, 0, 0);
+        return ret;
+    }
+    req->ready = 1;     /* Start on the next http_engine_run */
+    return 0;
+}
+
+/* Start a queued request once its origin has a lease free
+ * returns: 1 while it still has to wait, else 0 (started, or finished) */
+static int async_dequeue(struct http_async *req) {
+    struct http_client *client = req->client;
+    int ret;
+
+    client->conn = http_pool_acquire(client->hostname, client->port, client->use_tls);
+    if (!client->conn) {
+        if (errno == EBUSY) return 1;
+        async_finish(req, client->use_tls ? HTTP_ERR_TLS : HTTP_ERR_NOMEM, 0, 1);
+        return 0;
+    }
+    client->timing.reused = client->conn->connected;
+    ret = async_connect(req);
+    if (ret != 0) {
+        async_finish(req, ret, 0, 1);
+        return 0;
+    }
+    req->ready = 1;
+    return 0;
+}
+
+HTTP_WEAK int http_engine_run(struct http_engine *engine, int timeout_ms) {
+    struct epoll_event events[HTTP_ENGINE_EVENTS];
+    struct http_async *req;
+    long long now;
+    int n;
+
+    if (!engine) return 0;
+    if (!engine->requests) return 0;
+
+    /* Leases may have come back from blocking calls since the last pass */
+    for (req = engine->requests; req;) {
+        if (req->state == ASYNC_QUEUED && async_dequeue(req) == 0) {
+            req = engine->requests;
+        } else {
+            req = req->next;
+        }
+    }
+
+    /* Sleep no longer than the nearest deadline or connect attempt */
+    now = monotonic_ms();
+    for (req = engine->requests; req; req = req->next) {
+        long long due = req->ready ? now : req->deadline;
+        if (req->state == ASYNC_CONNECT && now + race_wait_ms(&req->race) < due) {
+            due = now + race_wait_ms(&req->race);
+        }
+        if (timeout_ms < 0 || due - now < timeout_ms) {
+            timeout_ms = due > now ? (int)(due - now) : 0;
+        }
+    }
+
+    n = epoll_wait(engine->epoll_fd, events, HTTP_ENGINE_EVENTS, timeout_ms);
+    for (int i = 0; i < n; i++) {
+        ((struct http_async *)events[i].data.ptr)->ready = 1;
+    }
+
+    /* Callbacks may submit or cancel requests, so rescan after each step */
+    now = monotonic_ms();
+    for (req = engine->requests; req;) {
+        if (now >= req->deadline) {
+            async_finish(req, HTTP_ERR_TIMEOUT, 0, 1);
+        } else if (req->state == ASYNC_QUEUED) {
+            if (async_dequeue(req) != 0) {
+                req = req->next;
+                continue;
+            }
+        } else if (req->ready ||
+                   (req->state == ASYNC_CONNECT && race_wait_ms(&req->race) == 0)) {
+            req->ready = 0;
+            async_advance(req);
+        } else {
+            req = req->next;
+            continue;
+        }
+        req = engine->requests;
+    }
+    return engine->count;
+}
+
+HTTP_WEAK void http_engine_cancel(struct http_client *client) {
+    if (client && client->async) {
+        async_finish(client->async, HTTP_ERR_ABORTED, 0, 1);
+    }
+}
+
+/* Clear response */
+HTTP_WEAK void http_response_clear(struct http_response *response) {
+    response->status_code = 0;
+    response->body = "";
+    response->body_len = 0;
+    response->headers = NULL;
+    response->num_headers = 0;
+    memset(&response->timing, 0, sizeof(response->timing));
+    memset(response->known, 0xff, sizeof(response->known));
+    memset(response->buckets, 0xff, sizeof(response->buckets));
+}
+
+/* Get header value */
+HTTP_WEAK const char *http_response_get_header(const struct http_response *response, const char *name) {
+    uint32_t hash = header_hash(name, strlen(name));
+
+    for (int i = response->buckets[hash & (HTTP_HEADER_BUCKETS - 1)]; i >= 0;
+         i = response->headers[i].next) {
+        if (response->headers[i].hash == hash &&
+            strcasecmp(response->headers[i].name, name) == 0) {
             return response->headers[i].value;
         }
     }
@@ -11,32 +11,108 @@
 #include <stdbool.h>
 
 /* Maximum sizes */
-#define HTTP_MAX_RESPONSE_SIZE  65536   /* 64KB max response */
+#define HTTP_MAX_RESPONSE_SIZE  65536   /* 64KB max buffered response body */
 #define HTTP_MAX_HEADER_NAME    64
 #define HTTP_MAX_HEADER_VALUE   512
 #define HTTP_MAX_HEADERS        16
 #define HTTP_MAX_HOSTNAME       256
 #define HTTP_TIMEOUT_MS         30000
+#define HTTP_CONNECT_TIMEOUT_MS 10000   /* Deadline for connecting to a host */
+#define HTTP_HAPPY_EYEBALLS_MS  250     /* Delay before racing the next address */
+#define HTTP_MAX_ADDRS          8       /* Resolved addresses tried per connect */
+#define HTTP_STREAM_BUF_SIZE    16384   /* Receive buffer for streamed responses */
+#define HTTP_RETRY_MAX_ATTEMPTS 3       /* Default attempts per request, first included */
+#define HTTP_RETRY_BASE_MS      200     /* Default smallest backoff */
+#define HTTP_RETRY_MAX_MS       10000   /* Default longest wait, Retry-After included */
+#define HTTP_RETRY_BUDGET       10      /* Retry tokens per origin; see http_client_set_retry */
 
-/* HTTP header structure */
+/* HTTP header structure (request headers) */
 struct http_header {
     char name[HTTP_MAX_HEADER_NAME];
     char value[HTTP_MAX_HEADER_VALUE];
 };
 
-/* HTTP response structure */
+/* Response header, NUL-terminated in place in the client's receive buffer */
+struct http_header_view {
+    const char *name;
+    const char *value;
+    uint32_t hash;      /* Case-insensitive hash of name */
+    int next;           /* Next header in the same hash bucket, -1 at the end */
+};
+
+#define HTTP_HEADER_BUCKETS     32      /* Response header hash buckets (power of two) */
+
+/* Headers classified while the response head is scanned */
+enum http_known_header {
+    HTTP_HDR_CONTENT_LENGTH,
+    HTTP_HDR_TRANSFER_ENCODING,
+    HTTP_HDR_CONNECTION,
+    HTTP_HDR_RETRY_AFTER,
+    HTTP_HDR_CONTENT_ENCODING,
+    HTTP_HDR_KNOWN_COUNT
+};
+
+/* Request phases, in the order they happen */
+enum http_phase {
+    HTTP_PHASE_DNS,         /* Name resolution (cache lookup when cached) */
+    HTTP_PHASE_CONNECT,     /* TCP connect, including the Happy Eyeballs race */
+    HTTP_PHASE_TLS,         /* TLS handshake */
+    HTTP_PHASE_SEND,        /* Writing the request */
+    HTTP_PHASE_TTFB,        /* Request written to first response byte */
+    HTTP_PHASE_TRANSFER,    /* First response byte to response complete */
+    HTTP_PHASE_TOTAL,       /* Whole request, retries included */
+    HTTP_PHASE_COUNT
+};
+
+/* Where the time of one request went, from monotonic timestamps taken
+ * inside the client. Phases that did not run (connect phases on a reused
+ * connection, TLS on plain HTTP, anything after a failure) are left out of
+ * done and read 0. */
+struct http_timing {
+    uint32_t us[HTTP_PHASE_COUNT];  /* Duration of each phase, microseconds */
+    uint32_t done;                  /* Bit (1 << phase) for each phase that ran */
+    bool reused;                    /* Served on an already-open connection */
+    bool tls_resumed;               /* TLS handshake resumed a cached session */
+    size_t bytes_sent;              /* Request bytes written (before TLS framing) */
+    size_t bytes_received;          /* Response bytes read, headers included, before decoding */
+};
+
+/* HTTP response structure
+ * A view into the client's receive buffer: body and header strings stay
+ * valid until the next request on the same client or its destruction.
+ * body is always NUL-terminated (an empty string when there is none).
+ * Every received header is kept, in order; there is no fixed limit.
+ * gzip/deflate bodies are inflated: body and body_len are the decoded
+ * content, and the Content-Encoding header is left as received.
+ */
 struct http_response {
     int status_code;
-    char body[HTTP_MAX_RESPONSE_SIZE];
+    const char *body;
     size_t body_len;
-    struct http_header headers[HTTP_MAX_HEADERS];
+    const struct http_header_view *headers;
     int num_headers;
+    int known[HTTP_HDR_KNOWN_COUNT];    /* Index of the first such header, -1 if absent */
+    int buckets[HTTP_HEADER_BUCKETS];   /* First header per name hash, -1 if none */
+    struct http_timing timing;          /* Also accounted per origin (http_stats.h) */
 };
 
 /* HTTP client handle */
 struct http_client;
 
+/* Streamed body sink
+ * Called with decoded body bytes as they arrive, at most
+ * HTTP_STREAM_BUF_SIZE bytes per call. Data is only valid during the call.
+ * returns: 0 to continue, non-zero to abort the transfer
+ */
+typedef int (*http_body_cb)(const char *data, size_t len, void *user_data);
+
 /* Create HTTP client
+ * Connections come from a process-wide pool (see http_pool.h): they are
+ * kept alive between requests (HTTP/1.1), shared by all clients of the same
+ * origin, and transparently re-established when the server has closed them
+ * while idle. Connecting resolves IPv4 and IPv6 addresses and races them
+ * (Happy Eyeballs). Requests advertise gzip and deflate, and compressed
+ * responses are inflated as they stream in (vendor/inflate.c).
  * hostname: server hostname
  * port: server port
  * use_tls: use HTTPS (TLS)
@@ -44,6 +120,45 @@ struct http_client;
  */
 struct http_client *http_client_create(const char *hostname, uint16_t port, bool use_tls);
 
+/* Set the request timeout
+ * timeout_ms: socket send/receive timeout; connecting is bounded by the
+ *             smaller of this and HTTP_CONNECT_TIMEOUT_MS
+ */
+void http_client_set_timeout(struct http_client *client, int timeout_ms);
+
+/* Retry policy
+ * A failed attempt is retried when it is safe and likely to help:
+ * - connect failures, for any method (nothing was sent)
+ * - for idempotent requests (GET, and POST with retry_post set): send and
+ *   receive errors, timeouts, and 429, 502, 503 and 504 responses
+ * Streamed requests are not retried once body bytes reached the callback;
+ * the body of a response that is going to be retried is not delivered.
+ * Waits use decorrelated jitter (each wait is random between base_delay_ms
+ * and three times the previous one, capped at max_delay_ms). A Retry-After
+ * header on a 429 or 503 (seconds or HTTP-date) sets the wait instead; if
+ * it is longer than max_delay_ms the response is returned as is.
+ * Retries draw on a process-wide budget per origin: every retryable failure
+ * costs a token, every success earns back a tenth of one, and retries stop
+ * while fewer than half of HTTP_RETRY_BUDGET tokens are left. A provider
+ * that is failing or throttling then sees only first attempts.
+ */
+struct http_retry_policy {
+    int max_attempts;       /* 1 disables retries */
+    int base_delay_ms;
+    int max_delay_ms;
+    bool retry_post;        /* Treat POST as idempotent (opt-in) */
+};
+
+/* Set the policy new clients start with (defaults: HTTP_RETRY_* above,
+ * POST not retried). Values <= 0 keep the current setting. */
+void http_retry_set_default(const struct http_retry_policy *policy);
+
+/* Get the policy new clients start with */
+void http_retry_get_default(struct http_retry_policy *policy);
+
+/* Set this client's retry policy (a copy is kept) */
+void http_client_set_retry(struct http_client *client, const struct http_retry_policy *policy);
+
 /* Destroy HTTP client and free resources */
 void http_client_destroy(struct http_client *client);
 
@@ -74,11 +189,110 @@ int http_post(struct http_client *client, const char *path,
               const char *body, size_t body_len,
               struct http_response *response);
 
+/* Perform HTTP GET request, streaming the body to a callback
+ * Memory use is bounded by HTTP_STREAM_BUF_SIZE regardless of body size.
+ * on_body: body sink, called zero or more times before this returns
+ * response: status and headers; body stays empty and body_len counts the
+ *           bytes handed to on_body
+ * returns: 0 on success, HTTP_ERR_ABORTED if on_body stopped the transfer,
+ *          other negative error code on failure
+ */
+int http_get_stream(struct http_client *client, const char *path,
+                    const struct http_header *headers, int num_headers,
+                    http_body_cb on_body, void *user_data,
+                    struct http_response *response);
+
+/* Perform HTTP POST request, streaming the body to a callback
+ * See http_get_stream.
+ */
+int http_post_stream(struct http_client *client, const char *path,
+                     const struct http_header *headers, int num_headers,
+                     const char *body, size_t body_len,
+                     http_body_cb on_body, void *user_data,
+                     struct http_response *response);
+
+/* One request of a pipelined GET batch */
+struct http_batch_item {
+    const char *path;
+    http_body_cb on_body;   /* Receives this response's body, as in http_get_stream */
+    void *user_data;
+    int status_code;        /* Output: response status, 0 if none */
+    int result;             /* Output: 0 or negative error code */
+    struct http_timing timing;  /* Output: this response's phases */
+};
+
+/* Perform several GET requests pipelined on one keep-alive connection
+ * All requests are written back to back and the responses read in order,
+ * so the batch costs about one round trip instead of one per request. If
+ * the server stops answering partway (closes the connection or declines
+ * pipelining), the requests still outstanding are sent again on a fresh
+ * connection; a request whose response failed midway is not repeated.
+ * The retry policy does not apply to batches.
+ * headers: additional headers sent with every request (can be NULL)
+ * returns: 0 if every item got a response, otherwise the first item error
+ */
+int http_get_batch(struct http_client *client,
+                   const struct http_header *headers, int num_headers,
+                   struct http_batch_item *items, int count);
+
+/* Asynchronous engine
+ * Drives many requests from one thread: each request is a state machine
+ * (connect, TLS handshake, send, receive) advanced on epoll readiness, so a
+ * slow origin no longer holds up the others. Requests use the same
+ * connection pool, Happy Eyeballs connect race, response decoding and
+ * timing as the blocking calls above; the retry policy does not apply.
+ * Names are resolved through the DNS cache, which may block on a miss.
+ */
+struct http_engine;
+
+/* Completion callback, called exactly once for each started request
+ * result: 0, HTTP_ERR_TIMEOUT past the deadline, HTTP_ERR_ABORTED when
+ *         cancelled, or another negative error
+ * response: valid during the call; its body and headers stay valid until
+ *           the next request on the client, as for http_get
+ */
+typedef void (*http_done_cb)(struct http_client *client, int result,
+                             const struct http_response *response, void *user_data);
+
+struct http_engine *http_engine_create(void);
+
+/* Destroy an engine, cancelling the requests still in flight */
+void http_engine_destroy(struct http_engine *engine);
+
+/* Start a request; it makes progress inside http_engine_run
+ * client: carries one request at a time and must not be used for blocking
+ *         calls until on_done has run
+ * body: copied, may be NULL
+ * deadline_ms: bound on the whole request, connect included; <= 0 uses the
+ *              client's timeout
+ * on_body: streamed body sink as in http_get_stream, or NULL to buffer
+ * user_data: passed to on_body and on_done
+ * A request to an origin already at HTTP_POOL_MAX_ACTIVE_PER_HOST leases
+ * waits in the engine, under its deadline, until one is handed back.
+ * returns: 0 if started, HTTP_ERR_BUSY if the client has a request in
+ *          flight, or another negative error (on_done is not called)
+ */
+int http_engine_submit(struct http_engine *engine, struct http_client *client,
+                       const char *method, const char *path,
+                       const struct http_header *headers, int num_headers,
+                       const char *body, size_t body_len, int deadline_ms,
+                       http_body_cb on_body, http_done_cb on_done, void *user_data);
+
+/* Wait up to timeout_ms (-1: until something happens) for socket activity
+ * or a deadline, and advance every request that can make progress.
+ * Completion callbacks run from here and may submit or cancel requests.
+ * returns: number of requests still in flight
+ */
+int http_engine_run(struct http_engine *engine, int timeout_ms);
+
+/* Abort the client's request in flight, if any (on_done gets HTTP_ERR_ABORTED) */
+void http_engine_cancel(struct http_client *client);
+
 /* Clear/reset response structure */
 void http_response_clear(struct http_response *response);
 
-/* Get header value from response by name
- * returns: header value or NULL if not found
+/* Get header value from response by name (case-insensitive, hashed)
+ * returns: value of the first header with that name, or NULL if not found
  */
 const char *http_response_get_header(const struct http_response *response, const char *name);
 
@@ -93,6 +307,10 @@ enum http_error {
     HTTP_ERR_RECV = -6,
     HTTP_ERR_TIMEOUT = -7,
     HTTP_ERR_PARSE = -8,
+    HTTP_ERR_CLOSED = -9,   /* Peer closed before sending a response */
+    HTTP_ERR_ABORTED = -10, /* Body callback stopped the transfer */
+    HTTP_ERR_BUSY = -11,    /* Client already has a request in flight, or
+                             * its origin is at the pool's connection cap */
 };
 
 #endif /* MIKROCLAW_HTTP_H */
@@ -2,6 +2,29 @@
 
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
+
+/* One transfer on the shared multi handle, found through CURLOPT_PRIVATE */
+struct curl_transfer {
+    CURL *easy;
+    curl_http_response *response;
+    int finished;
+    CURLcode result;
+    /* Submitted transfers only */
+    int async;
+    struct curl_slist *headers;
+    char *body;
+    curl_http_response owned;
+    curl_http_done_cb done;
+    void *user_data;
+    struct curl_transfer *next;
+};
+
+static CURLSH *g_share;
+static CURLM *g_multi;
+static pid_t g_owner;
+static struct curl_transfer *g_submitted;
+static int g_pending;
 
 static size_t write_callback(void *contents, size_t size, size_t nmemb, void *userp) {
     size_t chunk_size = size * nmemb;
@@ -19,12 +42,172 @@ static size_t write_callback(void *contents, size_t size, size_t nmemb, void *us
     return chunk_size;
 }
 
+/* Set up the shared handles on first use. Handles inherited across fork()
+ * belong to the parent's connections: they are left alone (not cleaned up,
+ * which would shut those connections down) and the child starts its own. */
+static int shared_init(void) {
+    static int global_done;
+
+    if (g_multi && g_owner == getpid()) {
+        return 0;
+    }
+
+    g_share = NULL;
+    g_multi = NULL;
+    g_submitted = NULL;
+    g_pending = 0;
+
+    if (!global_done) {
+        if (curl_global_init(CURL_GLOBAL_DEFAULT) != CURLE_OK) {
+            return -1;
+        }
+        global_done = 1;
+    }
+
+    g_share = curl_share_init();
+    g_multi = curl_multi_init();
+    if (!g_share || !g_multi) {
+        curl_share_cleanup(g_share);
+        curl_multi_cleanup(g_multi);
+        g_share = NULL;
+        g_multi = NULL;
+        return -1;
+    }
+    curl_share_setopt(g_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_DNS);
+    curl_share_setopt(g_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_SSL_SESSION);
+    curl_share_setopt(g_share, CURLSHOPT_SHARE, CURL_LOCK_DATA_CONNECT);
+    g_owner = getpid();
+    return 0;
+}
+
+static void set_common(CURL *curl, const char *url, curl_http_response *response) {
+    response->status_code = 0;
+    response->body = NULL;
+    response->body_len = 0;
+
+    curl_easy_setopt(curl, CURLOPT_SHARE, g_share);
+    curl_easy_setopt(curl, CURLOPT_NOSIGNAL, 1L);
+    curl_easy_setopt(curl, CURLOPT_URL, url);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_callback);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, response);
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, 30000L);
+    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, 10000L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
+    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
+}
+
+static struct curl_slist *json_headers(const char *const *headers, int num_headers) {
+    struct curl_slist *list = curl_slist_append(NULL, "Content-Type: application/json");
+
+    for (int i = 0; list && i < num_headers; i++) {
+        struct curl_slist *next = curl_slist_append(list, headers[i]);
+        if (!next) {
+            curl_slist_free_all(list);
+            return NULL;
+        }
+        list = next;
+    }
+    return list;
+}
+
+static void finish_submitted(struct curl_transfer *t) {
+    struct curl_transfer **link = &g_submitted;
+    int result = t->finished && t->result == CURLE_OK ? 0 : -1;
+
+    while (*link && *link != t) {
+        link = &(*link)->next;
+    }
+    if (*link) {
+        *link = t->next;
+    }
+    g_pending--;
+
+    if (result == 0) {
+        curl_easy_getinfo(t->easy, CURLINFO_RESPONSE_CODE, &t->owned.status_code);
+    } else {
+        curl_http_response_free(&t->owned);
+    }
+    if (t->done) {
+        t->done(result, &t->owned, t->user_data);
+    }
+    curl_http_response_free(&t->owned);
+    curl_slist_free_all(t->headers);
+    curl_easy_cleanup(t->easy);
+    free(t->body);
+    free(t);
+}
+
+/* Collect finished transfers: mark blocking ones, complete submitted ones */
+static void dispatch(void) {
+    CURLMsg *msg;
+    int left;
+
+    while ((msg = curl_multi_info_read(g_multi, &left)) != NULL) {
+        struct curl_transfer *t = NULL;
+        CURL *easy = msg->easy_handle;
+        CURLcode result = msg->data.result;
+
+        if (msg->msg != CURLMSG_DONE) {
+            continue;
+        }
+        curl_easy_getinfo(easy, CURLINFO_PRIVATE, (char **)&t);
+        curl_multi_remove_handle(g_multi, easy);
+        if (!t) {
+            continue;
+        }
+        t->finished = 1;
+        t->result = result;
+        if (t->async) {
+            finish_submitted(t);
+        }
+    }
+}
+
+/* Run one transfer to completion on the shared multi, advancing the others */
+static int run_blocking(struct curl_transfer *t) {
+    curl_easy_setopt(t->easy, CURLOPT_PRIVATE, t);
+    if (curl_multi_add_handle(g_multi, t->easy) != CURLM_OK) {
+        return -1;
+    }
+
+    while (!t->finished) {
+        int running;
+
+        if (curl_multi_perform(g_multi, &running) != CURLM_OK) {
+            break;
+        }
+        dispatch();
+        if (t->finished) {
+            break;
+        }
+        if (curl_multi_poll(g_multi, NULL, 0, 1000, NULL) != CURLM_OK) {
+            break;
+        }
+    }
+
+    if (!t->finished) {
+        curl_multi_remove_handle(g_multi, t->easy);
+        return -1;
+    }
+    if (t->result != CURLE_OK) {
+        return -1;
+    }
+    curl_easy_getinfo(t->easy, CURLINFO_RESPONSE_CODE, &t->response->status_code);
+    return 0;
+}
+
 curl_http_client *curl_http_client_create(void) {
     curl_http_client *client = calloc(1, sizeof(*client));
     if (!client) {
         return NULL;
     }
 
+    if (shared_init() != 0) {
+        free(client);
+        return NULL;
+    }
+
     client->curl = curl_easy_init();
     if (!client->curl) {
         free(client);
@@ -46,6 +229,8 @@ void curl_http_client_destroy(curl_http_client *client) {
 }
 
 int curl_http_get(curl_http_client *client, const char *url, curl_http_response *response) {
+    struct curl_transfer t;
+
     if (!client || !url || !response) {
         return -1;
     }
@@ -53,28 +238,26 @@ int curl_http_get(curl_http_client *client, const char *url, curl_http_response
     response->status_code = 0;
     response->body = NULL;
     response->body_len = 0;
+    if (shared_init() != 0) {
+        return -1;
+    }
 
-    curl_easy_setopt(client->curl, CURLOPT_URL, url);
+    memset(&t, 0, sizeof(t));
+    t.easy = client->curl;
+    t.response = response;
+    set_common(client->curl, url, response);
     curl_easy_setopt(client->curl, CURLOPT_HTTPGET, 1L);
-    curl_easy_setopt(client->curl, CURLOPT_WRITEFUNCTION, write_callback);
-    curl_easy_setopt(client->curl, CURLOPT_WRITEDATA, response);
-    curl_easy_setopt(client->curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(client->curl, CURLOPT_TIMEOUT_MS, 30000L);
-    curl_easy_setopt(client->curl, CURLOPT_CONNECTTIMEOUT_MS, 10000L);
-    curl_easy_setopt(client->curl, CURLOPT_SSL_VERIFYPEER, 1L);
-    curl_easy_setopt(client->curl, CURLOPT_SSL_VERIFYHOST, 2L);
-
-    CURLcode rc = curl_easy_perform(client->curl);
-    if (rc != CURLE_OK) {
+
+    if (run_blocking(&t) != 0) {
         curl_http_response_free(response);
         return -1;
     }
-
-    curl_easy_getinfo(client->curl, CURLINFO_RESPONSE_CODE, &response->status_code);
     return 0;
 }
 
 int curl_http_post(curl_http_client *client, const char *url, const char *body, curl_http_response *response) {
+    struct curl_transfer t;
+
     if (!client || !url || !body || !response) {
         return -1;
     }
@@ -82,36 +265,160 @@ int curl_http_post(curl_http_client *client, const char *url, const char *body,
     response->status_code = 0;
     response->body = NULL;
     response->body_len = 0;
+    if (shared_init() != 0) {
+        return -1;
+    }
 
     struct curl_slist *headers = NULL;
     headers = curl_slist_append(headers, "Content-Type: application/json");
 
-    curl_easy_setopt(client->curl, CURLOPT_URL, url);
+    memset(&t, 0, sizeof(t));
+    t.easy = client->curl;
+    t.response = response;
+    set_common(client->curl, url, response);
     curl_easy_setopt(client->curl, CURLOPT_POST, 1L);
     curl_easy_setopt(client->curl, CURLOPT_POSTFIELDS, body);
     curl_easy_setopt(client->curl, CURLOPT_POSTFIELDSIZE, (long)strlen(body));
     curl_easy_setopt(client->curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(client->curl, CURLOPT_WRITEFUNCTION, write_callback);
-    curl_easy_setopt(client->curl, CURLOPT_WRITEDATA, response);
-    curl_easy_setopt(client->curl, CURLOPT_FOLLOWLOCATION, 1L);
-    curl_easy_setopt(client->curl, CURLOPT_TIMEOUT_MS, 30000L);
-    curl_easy_setopt(client->curl, CURLOPT_CONNECTTIMEOUT_MS, 10000L);
-    curl_easy_setopt(client->curl, CURLOPT_SSL_VERIFYPEER, 1L);
-    curl_easy_setopt(client->curl, CURLOPT_SSL_VERIFYHOST, 2L);
-
-    CURLcode rc = curl_easy_perform(client->curl);
+
+    int rc = run_blocking(&t);
     curl_slist_free_all(headers);
     curl_easy_setopt(client->curl, CURLOPT_HTTPHEADER, NULL);
     curl_easy_setopt(client->curl, CURLOPT_POST, 0L);
-    if (rc != CURLE_OK) {
+    if (rc != 0) {
         curl_http_response_free(response);
         return -1;
     }
+    return 0;
+}
+
+int curl_http_request(const char *url, const char *const *headers, int num_headers,
+                      const char *body, curl_http_response *response) {
+    struct curl_transfer t;
+    struct curl_slist *list;
+    int rc;
+
+    if (!url || !body || !response) {
+        return -1;
+    }
 
-    curl_easy_getinfo(client->curl, CURLINFO_RESPONSE_CODE, &response->status_code);
+    response->status_code = 0;
+    response->body = NULL;
+    response->body_len = 0;
+    if (shared_init() != 0) {
+        return -1;
+    }
+
+    memset(&t, 0, sizeof(t));
+    t.easy = curl_easy_init();
+    t.response = response;
+    list = json_headers(headers, num_headers);
+    if (!t.easy || !list) {
+        curl_easy_cleanup(t.easy);
+        curl_slist_free_all(list);
+        return -1;
+    }
+
+    set_common(t.easy, url, response);
+    curl_easy_setopt(t.easy, CURLOPT_POST, 1L);
+    curl_easy_setopt(t.easy, CURLOPT_POSTFIELDS, body);
+    curl_easy_setopt(t.easy, CURLOPT_POSTFIELDSIZE, (long)strlen(body));
+    curl_easy_setopt(t.easy, CURLOPT_HTTPHEADER, list);
+
+    rc = run_blocking(&t);
+    curl_easy_cleanup(t.easy);
+    curl_slist_free_all(list);
+    if (rc != 0) {
+        curl_http_response_free(response);
+        return -1;
+    }
     return 0;
 }
 
+int curl_http_submit(const char *url, const char *const *headers, int num_headers,
+                     const char *body, curl_http_done_cb done, void *user_data) {
+    struct curl_transfer *t;
+    int running;
+
+    if (!url || !body || shared_init() != 0 || g_pending >= CURL_HTTP_MAX_PENDING) {
+        return -1;
+    }
+
+    t = calloc(1, sizeof(*t));
+    if (!t) {
+        return -1;
+    }
+    t->async = 1;
+    t->response = &t->owned;
+    t->done = done;
+    t->user_data = user_data;
+    t->easy = curl_easy_init();
+    t->body = strdup(body);
+    t->headers = json_headers(headers, num_headers);
+    if (!t->easy || !t->body || !t->headers) {
+        curl_easy_cleanup(t->easy);
+        free(t->body);
+        curl_slist_free_all(t->headers);
+        free(t);
+        return -1;
+    }
+
+    set_common(t->easy, url, &t->owned);
+    curl_easy_setopt(t->easy, CURLOPT_POST, 1L);
+    curl_easy_setopt(t->easy, CURLOPT_POSTFIELDS, t->body);
+    curl_easy_setopt(t->easy, CURLOPT_POSTFIELDSIZE, (long)strlen(t->body));
+    curl_easy_setopt(t->easy, CURLOPT_HTTPHEADER, t->headers);
+    curl_easy_setopt(t->easy, CURLOPT_PRIVATE, t);
+    if (curl_multi_add_handle(g_multi, t->easy) != CURLM_OK) {
+        curl_easy_cleanup(t->easy);
+        free(t->body);
+        curl_slist_free_all(t->headers);
+        free(t);
+        return -1;
+    }
+    t->next = g_submitted;
+    g_submitted = t;
+    g_pending++;
+
+    /* Get the connect going; completions are reported from curl_http_poll */
+    curl_multi_perform(g_multi, &running);
+    return 0;
+}
+
+int curl_http_poll(int timeout_ms) {
+    int running;
+
+    if (!g_multi || g_owner != getpid() || g_pending == 0) {
+        return 0;
+    }
+
+    curl_multi_perform(g_multi, &running);
+    dispatch();
+    if (g_pending > 0 && timeout_ms > 0) {
+        curl_multi_poll(g_multi, NULL, 0, timeout_ms, NULL);
+        curl_multi_perform(g_multi, &running);
+        dispatch();
+    }
+    return g_pending;
+}
+
+void curl_http_shutdown(void) {
+    if (!g_multi || g_owner != getpid()) {
+        g_multi = NULL;
+        g_share = NULL;
+        return;
+    }
+
+    while (g_submitted) {
+        curl_multi_remove_handle(g_multi, g_submitted->easy);
+        finish_submitted(g_submitted);
+    }
+    curl_multi_cleanup(g_multi);
+    curl_share_cleanup(g_share);
+    g_multi = NULL;
+    g_share = NULL;
+}
+
 void curl_http_response_free(curl_http_response *response) {
     if (!response) {
         return;
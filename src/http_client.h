@@ -4,6 +4,17 @@
 #include <curl/curl.h>
 #include <stddef.h>
 
+/* Every transfer goes through one process-wide multi handle, and all easy
+ * handles are attached to one share handle (DNS cache, TLS sessions and
+ * connection cache). Separate clients and one-shot requests to the same
+ * host therefore reuse the resolved address, the open connection and the
+ * TLS session instead of starting from scratch. Blocking calls drive the
+ * shared multi until their own transfer is done, which also advances
+ * transfers started with curl_http_submit. The handles are fork-aware: a
+ * child process starts its own instead of touching the parent's. */
+
+#define CURL_HTTP_MAX_PENDING   16      /* Transfers in flight via curl_http_submit */
+
 typedef struct curl_http_client {
     CURL *curl;
 } curl_http_client;
@@ -20,4 +31,36 @@ int curl_http_get(curl_http_client *client, const char *url, curl_http_response
 int curl_http_post(curl_http_client *client, const char *url, const char *body, curl_http_response *response);
 void curl_http_response_free(curl_http_response *response);
 
+/* POST a JSON body with extra header lines ("Name: value") and wait for it
+ * returns: 0 with response filled (free it), or -1 on transfer failure
+ */
+int curl_http_request(const char *url, const char *const *headers, int num_headers,
+                      const char *body, curl_http_response *response);
+
+/* Completion of a curl_http_submit transfer
+ * result: 0, or -1 if the transfer failed (response then has no body)
+ * response: freed after the call returns
+ */
+typedef void (*curl_http_done_cb)(int result, curl_http_response *response, void *user_data);
+
+/* Start a JSON POST as curl_http_request does, without waiting for it.
+ * It advances whenever curl_http_poll or a blocking call runs.
+ * headers, body: copied
+ * done: may be NULL
+ * returns: 0 if started, -1 if CURL_HTTP_MAX_PENDING transfers are in
+ *          flight or setup failed (done is not called)
+ */
+int curl_http_submit(const char *url, const char *const *headers, int num_headers,
+                     const char *body, curl_http_done_cb done, void *user_data);
+
+/* Advance transfers in flight, waiting up to timeout_ms for socket activity
+ * when there are any; completion callbacks run from here
+ * returns: number of transfers still in flight
+ */
+int curl_http_poll(int timeout_ms);
+
+/* Finish: transfers in flight are dropped (done gets -1) and the shared
+ * handles released */
+void curl_http_shutdown(void);
+
 #endif
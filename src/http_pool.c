@@ -0,0 +1,272 @@
+/*
+ * MikroClaw - HTTP connection pool Implementation
+ */
+
+#include "http_pool.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/socket.h>
+
+static struct http_conn *g_idle;    /* Most recently released first */
+static struct http_conn *g_leased;  /* Connections out on lease */
+static struct http_pool_stats g_stats;
+static int g_max_idle_per_host = HTTP_POOL_MAX_IDLE_PER_HOST;
+static int g_max_active_per_host = HTTP_POOL_MAX_ACTIVE_PER_HOST;
+static int g_idle_timeout_ms = HTTP_POOL_IDLE_TIMEOUT_MS;
+
+static long long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static int same_origin(const struct http_conn *conn, const char *hostname,
+                       uint16_t port, bool use_tls) {
+    return conn->port == port && conn->use_tls == use_tls &&
+           strcmp(conn->hostname, hostname) == 0;
+}
+
+/* An idle keep-alive socket must have nothing to read. EOF means the server
+ * closed it; pending bytes (usually a TLS close_notify alert) mean the same. */
+static int conn_stale(const struct http_conn *conn) {
+    char probe;
+    ssize_t n = recv(conn->socket_fd, &probe, 1, MSG_PEEK | MSG_DONTWAIT);
+
+    if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        return 0;
+    }
+    return 1;
+}
+
+void http_conn_close(struct http_conn *conn) {
+    if (conn->socket_fd >= 0) {
+        close(conn->socket_fd);
+        conn->socket_fd = -1;
+    }
+    if (conn->use_tls) {
+        mbedtls_tls_reset(&conn->tls_ctx);
+    }
+    conn->connected = 0;
+    conn->requests = 0;
+}
+
+/* Free a connection. One inherited across fork() shares its socket and TLS
+ * state with the parent, so it is dropped without any protocol traffic. */
+static void conn_free(struct http_conn *conn) {
+    if (conn->socket_fd >= 0) {
+        close(conn->socket_fd);
+    }
+    if (conn->use_tls) {
+        mbedtls_tls_free(&conn->tls_ctx);
+    }
+    free(conn);
+}
+
+/* Unlink idle connections matching drop(); returns how many were freed */
+static int drop_idle(int (*drop)(struct http_conn *conn, long long now)) {
+    struct http_conn **link = &g_idle;
+    long long now = monotonic_ms();
+    int dropped = 0;
+
+    while (*link) {
+        struct http_conn *conn = *link;
+        if (drop(conn, now)) {
+            *link = conn->next;
+            conn_free(conn);
+            g_stats.idle--;
+            dropped++;
+        } else {
+            link = &conn->next;
+        }
+    }
+    return dropped;
+}
+
+static int drop_expired(struct http_conn *conn, long long now) {
+    if (conn->owner != getpid()) return 1;
+    if (now - conn->idle_since < g_idle_timeout_ms) return 0;
+    g_stats.expired++;
+    return 1;
+}
+
+static int drop_all(struct http_conn *conn, long long now) {
+    (void)conn;
+    (void)now;
+    return 1;
+}
+
+/* Leases this process holds on an origin. Leases inherited across fork()
+ * belong to the parent and are not counted. */
+static int leases_for(const char *hostname, uint16_t port, bool use_tls) {
+    pid_t pid = getpid();
+    int n = 0;
+
+    for (struct http_conn *conn = g_leased; conn; conn = conn->next) {
+        if (conn->owner == pid && same_origin(conn, hostname, port, use_tls)) n++;
+    }
+    return n;
+}
+
+static struct http_conn *lease(struct http_conn *conn) {
+    conn->next = g_leased;
+    g_leased = conn;
+    return conn;
+}
+
+static void unlease(struct http_conn *conn) {
+    struct http_conn **link = &g_leased;
+
+    while (*link && *link != conn) link = &(*link)->next;
+    if (*link) *link = conn->next;
+    conn->next = NULL;
+}
+
+struct http_conn *http_pool_acquire(const char *hostname, uint16_t port, bool use_tls) {
+    struct http_conn **link;
+    struct http_conn **cold = NULL;
+    struct http_conn *conn;
+
+    drop_idle(drop_expired);
+
+    if (leases_for(hostname, port, use_tls) >= g_max_active_per_host) {
+        g_stats.refused++;
+        errno = EBUSY;
+        return NULL;
+    }
+
+    for (link = &g_idle; *link;) {
+        conn = *link;
+        if (!same_origin(conn, hostname, port, use_tls)) {
+            link = &conn->next;
+            continue;
+        }
+        if (conn->connected && conn_stale(conn)) {
+            g_stats.stale++;
+            http_conn_close(conn);
+        }
+        if (conn->connected) {
+            *link = conn->next;
+            g_stats.idle--;
+            g_stats.reused++;
+            return lease(conn);
+        }
+        if (!cold) cold = link;
+        link = &conn->next;
+    }
+
+    /* No live connection: recycle a cold one to skip TLS context setup */
+    if (cold) {
+        conn = *cold;
+        *cold = conn->next;
+        g_stats.idle--;
+        return lease(conn);
+    }
+
+    conn = calloc(1, sizeof(*conn));
+    if (!conn) {
+        errno = ENOMEM;
+        return NULL;
+    }
+    snprintf(conn->hostname, sizeof(conn->hostname), "%s", hostname);
+    conn->port = port;
+    conn->use_tls = use_tls;
+    conn->socket_fd = -1;
+    conn->owner = getpid();
+    if (use_tls && mbedtls_init(&conn->tls_ctx, hostname) != 0) {
+        free(conn);
+        errno = ENOMEM;
+        return NULL;
+    }
+    g_stats.created++;
+    return lease(conn);
+}
+
+void http_pool_release(struct http_conn *conn, int reusable) {
+    struct http_conn **link;
+    struct http_conn **oldest_same = NULL;
+    struct http_conn **cold_same = NULL;
+    struct http_conn **oldest = NULL;
+    struct http_conn **cold = NULL;
+    struct http_conn **victim = NULL;
+    int same = 0;
+    int full = 0;
+
+    if (!conn) return;
+    unlease(conn);
+    if (conn->owner != getpid()) {
+        conn_free(conn);
+        return;
+    }
+    if (!reusable) {
+        http_conn_close(conn);
+    }
+
+    /* Make room: evict the least recently used idle connection of this
+     * origin when over the per-host cap, else the oldest overall. Cold
+     * entries go first, and a live one never makes way for a cold one. */
+    for (link = &g_idle; *link; link = &(*link)->next) {
+        int live = (*link)->connected;
+
+        if (same_origin(*link, conn->hostname, conn->port, conn->use_tls)) {
+            same++;
+            oldest_same = link;
+            if (!live) cold_same = link;
+        }
+        oldest = link;
+        if (!live) cold = link;
+    }
+    if (same >= g_max_idle_per_host && oldest_same) {
+        full = 1;
+        victim = cold_same ? cold_same : (conn->connected ? oldest_same : NULL);
+    } else if (g_stats.idle >= HTTP_POOL_MAX_IDLE && oldest) {
+        full = 1;
+        victim = cold ? cold : (conn->connected ? oldest : NULL);
+    }
+    if (full && !victim) {
+        conn_free(conn);
+        return;
+    }
+    if (victim) {
+        struct http_conn *evicted = *victim;
+        *victim = evicted->next;
+        conn_free(evicted);
+        g_stats.idle--;
+    }
+
+    conn->idle_since = monotonic_ms();
+    conn->next = g_idle;
+    g_idle = conn;
+    g_stats.idle++;
+}
+
+void http_pool_prune(void) {
+    drop_idle(drop_expired);
+}
+
+void http_pool_configure(int max_idle_per_host, int max_active_per_host,
+                         int idle_timeout_ms) {
+    if (max_idle_per_host > 0) g_max_idle_per_host = max_idle_per_host;
+    if (max_active_per_host > 0) g_max_active_per_host = max_active_per_host;
+    if (idle_timeout_ms > 0) g_idle_timeout_ms = idle_timeout_ms;
+}
+
+void http_pool_flush(void) {
+    drop_idle(drop_all);
+}
+
+void http_pool_get_stats(struct http_pool_stats *stats) {
+    if (stats) {
+        pid_t pid = getpid();
+
+        *stats = g_stats;
+        stats->leased = 0;
+        for (struct http_conn *conn = g_leased; conn; conn = conn->next) {
+            if (conn->owner == pid) stats->leased++;
+        }
+    }
+}
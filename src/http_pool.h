@@ -0,0 +1,80 @@
+/*
+ * MikroClaw - HTTP connection pool
+ * Keep-alive connections are shared process-wide, keyed by origin
+ * (host:port:tls). A client leases a connection for the duration of one
+ * request and hands it back afterwards, so every http_client talking to the
+ * same origin - including short-lived ones - skips the TCP and TLS setup.
+ */
+
+#ifndef MIKROCLAW_HTTP_POOL_H
+#define MIKROCLAW_HTTP_POOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "http.h"
+#include "../vendor/mbedtls_integration.h"
+
+#define HTTP_POOL_MAX_IDLE_PER_HOST 2       /* Idle connections kept per origin */
+#define HTTP_POOL_MAX_ACTIVE_PER_HOST 6     /* Connections leased at once per origin */
+#define HTTP_POOL_MAX_IDLE          8       /* Idle connections kept in total */
+#define HTTP_POOL_IDLE_TIMEOUT_MS   30000   /* Close connections idle this long */
+
+/* One connection to an origin. Released connections may be cold (closed,
+ * with the TLS context kept for the next handshake). */
+struct http_conn {
+    char hostname[HTTP_MAX_HOSTNAME];
+    uint16_t port;
+    bool use_tls;
+    int socket_fd;
+    struct mbedtls_ctx tls_ctx;
+    int connected;          /* Socket (and TLS session) is up */
+    int requests;           /* Requests served on the current connection */
+    int timeout_ms;         /* Socket timeout currently applied */
+    long long idle_since;   /* Monotonic ms when last released */
+    pid_t owner;            /* Process that created it */
+    struct http_conn *next;
+};
+
+struct http_pool_stats {
+    unsigned long reused;       /* Leases served by a live idle connection */
+    unsigned long created;      /* Connections allocated */
+    unsigned long stale;        /* Idle connections found closed by the peer */
+    unsigned long expired;      /* Idle connections closed on timeout */
+    unsigned long refused;      /* Leases refused at the per-origin cap */
+    int idle;                   /* Connections currently idle in the pool */
+    int leased;                 /* Connections currently leased out */
+};
+
+/* Lease a connection to an origin: a live idle one if it passes the health
+ * check, else a cold or new one that the caller must connect. At most
+ * HTTP_POOL_MAX_ACTIVE_PER_HOST connections per origin are leased at once.
+ * returns: connection, or NULL with errno EBUSY when the origin is at its
+ *          cap, ENOMEM if out of memory or TLS setup failed
+ */
+struct http_conn *http_pool_acquire(const char *hostname, uint16_t port, bool use_tls);
+
+/* Return a leased connection. When the pool is full a cold idle entry is
+ * evicted first; a closed connection is dropped rather than displace a
+ * live one.
+ * reusable: connection can carry another request; otherwise it is closed
+ */
+void http_pool_release(struct http_conn *conn, int reusable);
+
+/* Close the socket and reset the TLS session, keeping the connection object */
+void http_conn_close(struct http_conn *conn);
+
+/* Close idle connections past the idle timeout. Call from an idle point. */
+void http_pool_prune(void);
+
+/* Set pool limits (<= 0 keeps the current value) */
+void http_pool_configure(int max_idle_per_host, int max_active_per_host,
+                         int idle_timeout_ms);
+
+/* Close every idle connection */
+void http_pool_flush(void);
+
+void http_pool_get_stats(struct http_pool_stats *stats);
+
+#endif /* MIKROCLAW_HTTP_POOL_H */
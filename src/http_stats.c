@@ -0,0 +1,186 @@
+/*
+ * MikroClaw - HTTP latency statistics Implementation
+ */
+
+#include "http_stats.h"
+
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+
+struct stats_entry {
+    struct http_origin_stats stats;
+    unsigned long last_used;    /* g_clock at the last record, 0: slot free */
+};
+
+static struct stats_entry g_entries[HTTP_STATS_MAX_ORIGINS];
+static unsigned long g_clock;
+
+static const char *const g_phase_names[HTTP_PHASE_COUNT] = {
+    "dns", "connect", "tls", "send", "ttfb", "transfer", "total"
+};
+
+const char *http_phase_name(enum http_phase phase) {
+    return (unsigned)phase < HTTP_PHASE_COUNT ? g_phase_names[phase] : "unknown";
+}
+
+static int bucket_of(uint32_t us) {
+    uint32_t ms = us / 1000;
+    int bucket = 0;
+
+    while (ms > 0 && bucket < HTTP_STATS_BUCKETS - 1) {
+        ms >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/* Find an origin's entry, taking over the least recently used slot if new */
+static struct stats_entry *entry_for(const char *hostname, uint16_t port, bool use_tls) {
+    struct stats_entry *victim = &g_entries[0];
+
+    for (int i = 0; i < HTTP_STATS_MAX_ORIGINS; i++) {
+        struct stats_entry *e = &g_entries[i];
+        if (e->last_used && e->stats.port == port && e->stats.use_tls == use_tls &&
+            strcmp(e->stats.hostname, hostname) == 0) {
+            return e;
+        }
+        if (e->last_used < victim->last_used) victim = e;
+    }
+
+    memset(victim, 0, sizeof(*victim));
+    snprintf(victim->stats.hostname, sizeof(victim->stats.hostname), "%s", hostname);
+    victim->stats.port = port;
+    victim->stats.use_tls = use_tls;
+    return victim;
+}
+
+void http_stats_record(const char *hostname, uint16_t port, bool use_tls,
+                       const struct http_timing *timing, int result) {
+    struct stats_entry *e;
+
+    if (!hostname || !timing) return;
+
+    e = entry_for(hostname, port, use_tls);
+    e->last_used = ++g_clock;
+    e->stats.requests++;
+    if (result != 0) e->stats.errors++;
+    if (timing->reused) e->stats.reused++;
+    if (timing->tls_resumed) e->stats.tls_resumed++;
+    e->stats.bytes_sent += timing->bytes_sent;
+    e->stats.bytes_received += timing->bytes_received;
+
+    for (int p = 0; p < HTTP_PHASE_COUNT; p++) {
+        struct http_phase_stats *phase = &e->stats.phases[p];
+        uint32_t us = timing->us[p];
+
+        if (!(timing->done & (1u << p))) continue;
+        phase->count++;
+        phase->sum_us += us;
+        if (us > phase->max_us) phase->max_us = us;
+        phase->buckets[bucket_of(us)]++;
+    }
+}
+
+int http_stats_get(struct http_origin_stats *out, int max) {
+    const struct stats_entry *order[HTTP_STATS_MAX_ORIGINS];
+    int n = 0;
+
+    if (!out) return 0;
+
+    /* Insertion sort by recency; there are only a handful of origins */
+    for (int i = 0; i < HTTP_STATS_MAX_ORIGINS; i++) {
+        const struct stats_entry *e = &g_entries[i];
+        int j = n;
+
+        if (!e->last_used) continue;
+        while (j > 0 && order[j - 1]->last_used < e->last_used) {
+            order[j] = order[j - 1];
+            j--;
+        }
+        order[j] = e;
+        n++;
+    }
+
+    if (n > max) n = max;
+    for (int i = 0; i < n; i++) {
+        out[i] = order[i]->stats;
+    }
+    return n;
+}
+
+long http_stats_percentile_ms(const struct http_phase_stats *phase, int pct) {
+    unsigned long rank;
+    unsigned long seen = 0;
+
+    if (!phase || phase->count == 0) return 0;
+
+    rank = (phase->count * (unsigned long)pct + 99) / 100;
+    if (rank == 0) rank = 1;
+    for (int b = 0; b < HTTP_STATS_BUCKETS; b++) {
+        seen += phase->buckets[b];
+        if (seen >= rank) {
+            if (b == HTTP_STATS_BUCKETS - 1) return -1;
+            return b == 0 ? 0 : 1L << b;
+        }
+    }
+    return -1;
+}
+
+/* Append to buf, tracking the length; *n goes past len on overflow */
+static void append(char *buf, size_t len, size_t *n, const char *fmt, ...) {
+    va_list ap;
+    int w;
+
+    va_start(ap, fmt);
+    w = vsnprintf(*n < len ? buf + *n : NULL, *n < len ? len - *n : 0, fmt, ap);
+    va_end(ap);
+    if (w > 0) *n += (size_t)w;
+}
+
+int http_stats_format_json(char *buf, size_t len) {
+    struct http_origin_stats origins[HTTP_STATS_MAX_ORIGINS];
+    int count = http_stats_get(origins, HTTP_STATS_MAX_ORIGINS);
+    size_t n = 0;
+
+    if (!buf || len == 0) return -1;
+
+    append(buf, len, &n, "{\"origins\":[");
+    for (int i = 0; i < count; i++) {
+        const struct http_origin_stats *o = &origins[i];
+
+        append(buf, len, &n,
+               "%s{\"origin\":\"%s://%s:%u\",\"requests\":%lu,\"errors\":%lu,"
+               "\"reused\":%lu,\"tls_resumed\":%lu,\"bytes_sent\":%llu,"
+               "\"bytes_received\":%llu,\"phases\":{",
+               i ? "," : "", o->use_tls ? "https" : "http", o->hostname,
+               (unsigned)o->port, o->requests, o->errors, o->reused, o->tls_resumed,
+               o->bytes_sent, o->bytes_received);
+
+        for (int p = 0; p < HTTP_PHASE_COUNT; p++) {
+            const struct http_phase_stats *phase = &o->phases[p];
+
+            append(buf, len, &n,
+                   "%s\"%s\":{\"count\":%lu,\"avg_us\":%llu,\"max_us\":%u,"
+                   "\"p50_ms\":%ld,\"p95_ms\":%ld,\"histogram\":[",
+                   p ? "," : "", g_phase_names[p], phase->count,
+                   phase->count ? phase->sum_us / phase->count : 0ULL,
+                   (unsigned)phase->max_us,
+                   http_stats_percentile_ms(phase, 50),
+                   http_stats_percentile_ms(phase, 95));
+            for (int b = 0; b < HTTP_STATS_BUCKETS; b++) {
+                append(buf, len, &n, "%s%lu", b ? "," : "", phase->buckets[b]);
+            }
+            append(buf, len, &n, "]}");
+        }
+        append(buf, len, &n, "}}");
+    }
+    append(buf, len, &n, "]}");
+
+    return n < len ? (int)n : -1;
+}
+
+void http_stats_reset(void) {
+    memset(g_entries, 0, sizeof(g_entries));
+    g_clock = 0;
+}
@@ -0,0 +1,69 @@
+/*
+ * MikroClaw - HTTP latency statistics
+ * Every native HTTP request is accounted to its origin (host:port:tls):
+ * request, error and reuse counts, bytes, and a log2 latency histogram per
+ * phase (see struct http_timing), so a slow reply can be pinned on DNS,
+ * connect, TLS, the server or the transfer.
+ */
+
+#ifndef MIKROCLAW_HTTP_STATS_H
+#define MIKROCLAW_HTTP_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "http.h"
+
+#define HTTP_STATS_MAX_ORIGINS  8   /* Least recently used origin is evicted */
+#define HTTP_STATS_BUCKETS      16  /* <1ms, then [2^(i-1), 2^i) ms, last open-ended */
+
+struct http_phase_stats {
+    unsigned long count;
+    unsigned long long sum_us;
+    uint32_t max_us;
+    unsigned long buckets[HTTP_STATS_BUCKETS];
+};
+
+struct http_origin_stats {
+    char hostname[HTTP_MAX_HOSTNAME];
+    uint16_t port;
+    bool use_tls;
+    unsigned long requests;
+    unsigned long errors;       /* Requests that failed */
+    unsigned long reused;       /* Requests served on an open connection */
+    unsigned long tls_resumed;  /* TLS handshakes that resumed a session; the
+                                 * hit rate is this over phases[HTTP_PHASE_TLS].count */
+    unsigned long long bytes_sent;
+    unsigned long long bytes_received;
+    struct http_phase_stats phases[HTTP_PHASE_COUNT];
+};
+
+/* Account one request
+ * result: 0 or the request's negative error code
+ */
+void http_stats_record(const char *hostname, uint16_t port, bool use_tls,
+                       const struct http_timing *timing, int result);
+
+/* Copy out per-origin statistics, most recently used first
+ * returns: number of origins written to out
+ */
+int http_stats_get(struct http_origin_stats *out, int max);
+
+/* Upper bound of the histogram bucket holding the pct-th percentile
+ * returns: milliseconds, 0 if there are no samples or all were under 1ms,
+ *          -1 if it lies in the open-ended last bucket
+ */
+long http_stats_percentile_ms(const struct http_phase_stats *phase, int pct);
+
+/* Render all origins as JSON:
+ * {"origins":[{"origin":"https://host:443","requests":N,...,"phases":{"dns":{...},...}}]}
+ * returns: length written, or -1 if buf is too small
+ */
+int http_stats_format_json(char *buf, size_t len);
+
+const char *http_phase_name(enum http_phase phase);
+
+void http_stats_reset(void);
+
+#endif /* MIKROCLAW_HTTP_STATS_H */
@@ -9,54 +9,146 @@
 
 void json_init(struct json_ctx *ctx) {
     jsmn_init(&ctx->parser);
+    ctx->tokens = ctx->inline_tokens;
+    ctx->cap = JSON_INLINE_TOKENS;
+    ctx->scratch = NULL;
+    ctx->scratch_cap = 0;
+    ctx->heap = NULL;
     ctx->data = NULL;
+    ctx->data_len = 0;
     ctx->num_tokens = 0;
 }
 
-int json_parse(struct json_ctx *ctx, const char *data, size_t len) {
-    ctx->data = data;
-    ctx->num_tokens = jsmn_parse(&ctx->parser, data, len, 
-                                ctx->tokens, JSON_MAX_TOKENS);
-    return ctx->num_tokens;
+void json_set_scratch(struct json_ctx *ctx, jsmntok_t *tokens, size_t count) {
+    ctx->scratch = tokens;
+    ctx->scratch_cap = tokens ? count : 0;
 }
 
-const jsmntok_t *json_find_key(const struct json_ctx *ctx, const char *key) {
-    if (ctx->num_tokens < 1) return NULL;
-    
-    /* Assume first token is object */
-    if (ctx->tokens[0].type != JSMN_OBJECT) return NULL;
-    
-    int obj_size = ctx->tokens[0].size;
-    int idx = 1;  /* Start after root object */
-    
-    for (int i = 0; i < obj_size && idx < ctx->num_tokens; i++) {
-        /* Current token should be key (string) */
-        if (ctx->tokens[idx].type != JSMN_STRING) {
-            idx++;
-            continue;
+void json_free(struct json_ctx *ctx) {
+    free(ctx->heap);
+    ctx->heap = NULL;
+    ctx->tokens = ctx->inline_tokens;
+    ctx->cap = JSON_INLINE_TOKENS;
+    ctx->num_tokens = 0;
+}
+
+/* Move to the next larger token store, keeping the tokens parsed so far */
+static int json_grow(struct json_ctx *ctx) {
+    size_t used = ctx->parser.toknext;
+    jsmntok_t *next;
+    size_t cap;
+
+    if (ctx->tokens != ctx->scratch && ctx->tokens != ctx->heap &&
+        ctx->scratch_cap > ctx->cap) {
+        memcpy(ctx->scratch, ctx->tokens, used * sizeof(*ctx->tokens));
+        ctx->tokens = ctx->scratch;
+        ctx->cap = ctx->scratch_cap;
+        return 0;
+    }
+
+    if (ctx->cap >= JSON_MAX_TOKENS) {
+        return -1;
+    }
+    cap = ctx->cap * 2 > JSON_MAX_TOKENS ? JSON_MAX_TOKENS : ctx->cap * 2;
+
+    if (ctx->tokens == ctx->heap) {
+        next = realloc(ctx->heap, cap * sizeof(*next));
+        if (!next) {
+            return -1;
         }
-        
-        /* Compare key */
-        int key_len = ctx->tokens[idx].end - ctx->tokens[idx].start;
-        if ((int)strlen(key) == key_len &&
-            strncmp(ctx->data + ctx->tokens[idx].start, key, key_len) == 0) {
-            /* Return value token (next token) */
-            if (idx + 1 < ctx->num_tokens) {
-                return &ctx->tokens[idx + 1];
-            }
+    } else {
+        next = malloc(cap * sizeof(*next));
+        if (!next) {
+            return -1;
         }
-        
-        /* Skip key and value */
-        idx++;
-        if (idx < ctx->num_tokens) {
-            /* Skip value - it may have children */
-            idx += 1 + ctx->tokens[idx].size;
+        memcpy(next, ctx->tokens, used * sizeof(*next));
+    }
+    ctx->heap = next;
+    ctx->tokens = next;
+    ctx->cap = cap;
+    return 0;
+}
+
+/* Record for each token the index just past its subtree. Tokens are in
+ * document order, so a container's subtree is the run of tokens starting
+ * before its end offset. Containers still open are chained through next. */
+static void json_index(struct json_ctx *ctx) {
+    jsmntok_t *t = ctx->tokens;
+    int open = -1;
+    int parent;
+
+    for (int i = 0; i < ctx->num_tokens; i++) {
+        while (open != -1 && t[i].start >= t[open].end) {
+            parent = t[open].next;
+            t[open].next = i;
+            open = parent;
+        }
+        if (t[i].type == JSMN_OBJECT || t[i].type == JSMN_ARRAY) {
+            t[i].next = open;
+            open = i;
+        } else {
+            t[i].next = i + 1;
+        }
+    }
+    while (open != -1) {
+        parent = t[open].next;
+        t[open].next = ctx->num_tokens;
+        open = parent;
+    }
+}
+
+int json_parse(struct json_ctx *ctx, const char *data, size_t len) {
+    int r;
+
+    jsmn_init(&ctx->parser);
+    ctx->data = data;
+    ctx->data_len = (int)len;
+
+    for (;;) {
+        r = jsmn_parse(&ctx->parser, data, len, ctx->tokens, ctx->cap);
+        if (r != JSMN_ERROR_NOMEM || json_grow(ctx) != 0) {
+            break;
+        }
+    }
+    ctx->num_tokens = r;
+    if (r > 0) {
+        json_index(ctx);
+    }
+    return r;
+}
+
+static bool json_token_eq(const struct json_ctx *ctx, const jsmntok_t *token,
+                          const char *s) {
+    size_t len = strlen(s);
+
+    return token->type == JSMN_STRING &&
+           (size_t)(token->end - token->start) == len &&
+           memcmp(ctx->data + token->start, s, len) == 0;
+}
+
+const jsmntok_t *json_object_get(const struct json_ctx *ctx, const jsmntok_t *object,
+                                 const char *key) {
+    struct json_iter it;
+    const jsmntok_t *name;
+    const jsmntok_t *value;
+
+    if (!key || !object || object->type != JSMN_OBJECT ||
+        !json_iter_init(&it, ctx, object)) {
+        return NULL;
+    }
+    while ((value = json_iter_next(&it, &name)) != NULL) {
+        if (json_token_eq(ctx, name, key)) {
+            return value;
         }
     }
-    
     return NULL;
 }
 
+const jsmntok_t *json_find_key(const struct json_ctx *ctx, const char *key) {
+    if (ctx->num_tokens < 1) return NULL;
+    return json_object_get(ctx, &ctx->tokens[0], key);
+}
+
 const char *json_get_string(const struct json_ctx *ctx, const char *key,
                             const char *default_val) {
     const jsmntok_t *token = json_find_key(ctx, key);
@@ -97,13 +189,56 @@ int json_array_len(const struct json_ctx *ctx, const jsmntok_t *array) {
 
 const jsmntok_t *json_array_get(const struct json_ctx *ctx,
                                  const jsmntok_t *array, int index) {
-    (void)ctx;
+    struct json_iter it;
+    const jsmntok_t *elem;
+
     if (!array || array->type != JSMN_ARRAY) return NULL;
     if (index < 0 || index >= array->size) return NULL;
-    
-    /* Find the indexed element */
-    /* This is simplified - real implementation needs to walk tokens */
-    return NULL;  /* TODO: Implement properly */
+    if (!json_iter_init(&it, ctx, array)) return NULL;
+
+    elem = json_iter_next(&it, NULL);
+    while (elem && index-- > 0) {
+        elem = json_iter_next(&it, NULL);
+    }
+    return elem;
+}
+
+bool json_iter_init(struct json_iter *it, const struct json_ctx *ctx,
+                    const jsmntok_t *container) {
+    int idx;
+
+    if (!it || !ctx || !container || ctx->num_tokens < 1) return false;
+    idx = (int)(container - ctx->tokens);
+    if (idx < 0 || idx >= ctx->num_tokens) return false;
+    if (container->type != JSMN_OBJECT && container->type != JSMN_ARRAY) return false;
+
+    it->ctx = ctx;
+    it->pos = idx + 1;
+    it->end = container->next;
+    it->object = container->type == JSMN_OBJECT;
+    return true;
+}
+
+const jsmntok_t *json_iter_next(struct json_iter *it, const jsmntok_t **key) {
+    const jsmntok_t *t;
+    const jsmntok_t *value;
+
+    if (!it || it->pos >= it->end) return NULL;
+    t = it->ctx->tokens;
+
+    if (it->object) {
+        /* A key without a value ends the walk */
+        if (t[it->pos].next >= it->end) {
+            it->pos = it->end;
+            return NULL;
+        }
+        if (key) *key = &t[it->pos];
+        value = &t[t[it->pos].next];
+    } else {
+        value = &t[it->pos];
+    }
+    it->pos = value->next;
+    return value;
 }
 
 int json_extract_string(const struct json_ctx *ctx, const jsmntok_t *token,
@@ -122,6 +257,7 @@ int extract_json_string(const char *json, const char *key,
                        char *out, size_t out_len) {
     struct json_ctx ctx;
     const jsmntok_t *token;
+    int ret;
 
     if (!json || !key || !out || out_len == 0) {
         return -1;
@@ -129,15 +265,14 @@ int extract_json_string(const char *json, const char *key,
 
     json_init(&ctx);
     if (json_parse(&ctx, json, strlen(json)) < 0) {
+        json_free(&ctx);
         return -1;
     }
 
     token = json_get_token(&ctx, key);
-    if (!token) {
-        return -1;
-    }
-
-    return json_extract_string(&ctx, token, out, out_len);
+    ret = token ? json_extract_string(&ctx, token, out, out_len) : -1;
+    json_free(&ctx);
+    return ret;
 }
 
 /* Escape a string for safe JSON inclusion
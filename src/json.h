@@ -10,24 +10,45 @@
 #include "mikroclaw_config.h"
 #include "../vendor/jsmn.h"
 
-/* JSON context */
+/* JSON context. Tokens start in the inline array, move to the scratch
+ * array if one is set and the document needs more, then to the heap, up
+ * to JSON_MAX_TOKENS. tokens may point into the context, so it must not
+ * be copied. */
 struct json_ctx {
     jsmn_parser parser;
-    jsmntok_t tokens[JSON_MAX_TOKENS];
+    jsmntok_t *tokens;
     int num_tokens;
+    size_t cap;
+    jsmntok_t *scratch;
+    size_t scratch_cap;
+    jsmntok_t *heap;
     const char *data;
     int data_len;
+    jsmntok_t inline_tokens[JSON_INLINE_TOKENS];
 };
 
 /* Initialize JSON parser context */
 void json_init(struct json_ctx *ctx);
 
-/* Parse JSON string */
+/* Offer a caller-owned token array for documents that outgrow the
+ * inline one. It must outlive the parsed tokens. */
+void json_set_scratch(struct json_ctx *ctx, jsmntok_t *tokens, size_t count);
+
+/* Release heap token storage. The context can be parsed into again. */
+void json_free(struct json_ctx *ctx);
+
+/* Parse JSON string. Grows the token storage as needed, indexes each
+ * token's subtree end (jsmntok_t.next) and returns the token count, or a
+ * negative JSMN error. */
 int json_parse(struct json_ctx *ctx, const char *data, size_t len);
 
-/* Find key in JSON object */
+/* Find key in the root JSON object */
 const jsmntok_t *json_find_key(const struct json_ctx *ctx, const char *key);
 
+/* Find key in an object token, returning its value token */
+const jsmntok_t *json_object_get(const struct json_ctx *ctx, const jsmntok_t *object,
+                                 const char *key);
+
 /* Get string value by key */
 const char *json_get_string(const struct json_ctx *ctx, const char *key, const char *default_val);
 
@@ -45,6 +66,23 @@ int json_array_len(const struct json_ctx *ctx, const jsmntok_t *array);
 const jsmntok_t *json_array_get(const struct json_ctx *ctx,
                                  const jsmntok_t *array, int index);
 
+/* Iterator over the members of an array or object token. Each step hops
+ * over the previous member's subtree in one move. */
+struct json_iter {
+    const struct json_ctx *ctx;
+    int pos;
+    int end;
+    bool object;
+};
+
+/* Returns false if the token is not an array or object */
+bool json_iter_init(struct json_iter *it, const struct json_ctx *ctx,
+                    const jsmntok_t *container);
+
+/* Next element, or for objects the next value with its key in *key.
+ * Returns NULL when the container is exhausted. */
+const jsmntok_t *json_iter_next(struct json_iter *it, const jsmntok_t **key);
+
 /* Extract string from token */
 int json_extract_string(const struct json_ctx *ctx, const jsmntok_t *token,
                         char *out, size_t max_len);
@@ -43,6 +43,17 @@ struct llm_ctx *llm_init(struct llm_config *config) {
         free(ctx);
         return NULL;
     }
+    if (config->timeout_ms > 0) {
+        http_client_set_timeout(ctx->http, config->timeout_ms);
+    }
+
+    /* A chat completion has no side effects, so a 429/503 or dropped
+     * connection is retried with backoff before llm_chat_reliable falls
+     * back to the next provider */
+    struct http_retry_policy retry;
+    http_retry_get_default(&retry);
+    retry.retry_post = true;
+    http_client_set_retry(ctx->http, &retry);
     
     return ctx;
 }
@@ -53,35 +64,23 @@ void llm_destroy(struct llm_ctx *ctx) {
     free(ctx);
 }
 
-int llm_chat(struct llm_ctx *ctx,
-             const char *system_prompt,
-             const char *user_message,
-             char *response, size_t max_response) {
-    
-    if (!ctx || !user_message || !response) return -1;
-    
-    /* Escape input strings for safe JSON inclusion */
-    char escaped_system[4096];
-    char escaped_user[4096];
-    
-    if (system_prompt && *system_prompt) {
-        if (json_escape(system_prompt, escaped_system, sizeof(escaped_system)) != 0) {
-            return -1;
-        }
-    } else {
-        escaped_system[0] = '\0';
-    }
-    
-    if (json_escape(user_message, escaped_user, sizeof(escaped_user)) != 0) {
-        return -1;
+/* JSON-escape into a heap buffer sized for the worst case (\u00XX) */
+static char *escape_alloc(const char *in) {
+    size_t cap = strlen(in) * 6 + 1;
+    char *out = malloc(cap);
+
+    if (out && json_escape(in, out, cap) != 0) {
+        free(out);
+        out = NULL;
     }
-    
-    /* Build request body */
-    char body[8192];
-    int body_len;
-    
+    return out;
+}
+
+/* Format the chat completion request body (snprintf semantics) */
+static int format_chat_body(char *buf, size_t size, const struct llm_ctx *ctx,
+                            const char *escaped_system, const char *escaped_user) {
     if (escaped_system[0]) {
-        body_len = snprintf(body, sizeof(body),
+        return snprintf(buf, size,
             "{"
             "\"model\":\"%s\","
             "\"messages\":["
@@ -96,20 +95,47 @@ int llm_chat(struct llm_ctx *ctx,
             escaped_user,
             ctx->config.temperature,
             ctx->config.max_tokens);
-    } else {
-        body_len = snprintf(body, sizeof(body),
-            "{"
-            "\"model\":\"%s\","
-            "\"messages\":["
-            "{\"role\":\"user\",\"content\":\"%s\"}"
-            "],"
-            "\"temperature\":%.1f,"
-            "\"max_tokens\":%d"
-            "}",
-            ctx->config.model,
-            escaped_user,
-            ctx->config.temperature,
-            ctx->config.max_tokens);
+    }
+    return snprintf(buf, size,
+        "{"
+        "\"model\":\"%s\","
+        "\"messages\":["
+        "{\"role\":\"user\",\"content\":\"%s\"}"
+        "],"
+        "\"temperature\":%.1f,"
+        "\"max_tokens\":%d"
+        "}",
+        ctx->config.model,
+        escaped_user,
+        ctx->config.temperature,
+        ctx->config.max_tokens);
+}
+
+int llm_chat(struct llm_ctx *ctx,
+             const char *system_prompt,
+             const char *user_message,
+             char *response, size_t max_response) {
+    
+    if (!ctx || !user_message || !response) return -1;
+    
+    /* Escape input strings for safe JSON inclusion. Buffers are sized from
+     * the input, so long prompts (e.g. with RouterOS context) are not cut. */
+    char *escaped_system = escape_alloc(system_prompt ? system_prompt : "");
+    char *escaped_user = escape_alloc(user_message);
+    char *body = NULL;
+    int body_len = -1;
+    
+    if (escaped_system && escaped_user) {
+        body_len = format_chat_body(NULL, 0, ctx, escaped_system, escaped_user);
+        body = body_len >= 0 ? malloc((size_t)body_len + 1) : NULL;
+        if (body) {
+            format_chat_body(body, (size_t)body_len + 1, ctx, escaped_system, escaped_user);
+        }
+    }
+    free(escaped_system);
+    free(escaped_user);
+    if (!body) {
+        return -1;
     }
     
     struct http_header headers[2];
@@ -131,7 +157,8 @@ int llm_chat(struct llm_ctx *ctx,
     memset(&resp, 0, sizeof(resp));
     
     int ret = http_post(ctx->http, "/v1/chat/completions", headers, 2, 
-                        body, body_len, &resp);
+                        body, (size_t)body_len, &resp);
+    free(body);
     
     if (ret != 0 || resp.status_code != 200) {
         http_response_clear(&resp);
@@ -142,6 +169,7 @@ int llm_chat(struct llm_ctx *ctx,
     struct json_ctx json;
     json_init(&json);
     if (json_parse(&json, resp.body, resp.body_len) < 0) {
+        json_free(&json);
         http_response_clear(&resp);
         return -1;
     }
@@ -156,6 +184,7 @@ int llm_chat(struct llm_ctx *ctx,
         response[0] = '\0';
     }
     
+    json_free(&json);
     http_response_clear(&resp);
     return 0;
 }
@@ -14,9 +14,12 @@
 #include "mikroclaw_config.h"
 #include "routeros.h"
 #include "llm.h"
+#include "dns_cache.h"
+#include "http.h"
 #include "provider_registry.h"
 #include "config_validate.h"
 #include "crypto.h"
+#include "csprng.h"
 #include "identity.h"
 #include "log.h"
 #include "channels/telegram.h"
@@ -27,6 +30,7 @@
 #include "config_memu.h"
 #endif
 #include "cli.h"
+#include "mbedtls_integration.h"
 
 static volatile int running = 1;
 
@@ -276,6 +280,34 @@ int main(int argc, char **argv) {
 
     functions_init();
     
+    /* Resolver cache shared by all HTTP clients */
+    dns_cache_set_ttl(atoi(getenv_or("DNS_CACHE_TTL", "0")),
+                      atoi(getenv_or("DNS_CACHE_NEGATIVE_TTL", "0")));
+
+    /* Backoff for idempotent HTTP requests; 0 keeps the built-in default */
+    struct http_retry_policy retry = {
+        atoi(getenv_or("HTTP_RETRY_MAX_ATTEMPTS", "0")),
+        atoi(getenv_or("HTTP_RETRY_BASE_MS", "0")),
+        atoi(getenv_or("HTTP_RETRY_MAX_MS", "0")),
+        false
+    };
+    http_retry_set_default(&retry);
+
+    /* Public-key pins; a RouterOS self-signed certificate is trusted only
+     * through ROUTEROS_TLS_PIN */
+    const char *tls_pins = getenv("TLS_PINS");
+    const char *router_pin = getenv("ROUTEROS_TLS_PIN");
+    if (tls_pins && tls_pins[0] && mbedtls_tls_pin_list(tls_pins) < 0) {
+        fprintf(stderr, "Invalid TLS_PINS, expected host=sha256/<base64>[,...][;...]\n");
+        functions_destroy();
+        return 1;
+    }
+    if (router_pin && router_pin[0] && mbedtls_tls_pin(router_host, router_pin) != 0) {
+        fprintf(stderr, "Invalid ROUTEROS_TLS_PIN, expected sha256/<base64>\n");
+        functions_destroy();
+        return 1;
+    }
+
     /* Initialize RouterOS connection */
     ctx.ros = routeros_init(router_host, 443, router_user, router_pass);
     if (!ctx.ros) {
@@ -408,14 +440,26 @@ int main(int argc, char **argv) {
     const char *gateway_port_str = getenv_or("GATEWAY_PORT", "18789");
     const char *gateway_bind = getenv_or("GATEWAY_BIND", "0.0.0.0");
     int gateway_port_value = (gateway_port_override >= 0) ? gateway_port_override : atoi(gateway_port_str);
+    const char *gateway_tls_cert = getenv("GATEWAY_TLS_CERT");
+    const char *gateway_tls_key = getenv("GATEWAY_TLS_KEY");
     struct gateway_config gw_config = {
         .port = (uint16_t)gateway_port_value,
-        .bind_addr = gateway_bind
+        .bind_addr = gateway_bind,
+        .tls_cert = (gateway_tls_cert && gateway_tls_cert[0]) ? gateway_tls_cert : NULL,
+        .tls_key = (gateway_tls_key && gateway_tls_key[0]) ? gateway_tls_key : NULL
     };
+    if (gw_config.tls_cert && gw_config.tls_key && !mbedtls_tls_server_supported()) {
+        fprintf(stderr, "Gateway TLS needs mbedTLS built with MBEDTLS_SSL_SRV_C\n");
+    }
     ctx.gateway = gateway_init(&gw_config);
+    if (!ctx.gateway && (gw_config.tls_cert || gw_config.tls_key)) {
+        fprintf(stderr, "Gateway disabled: GATEWAY_TLS_CERT and GATEWAY_TLS_KEY must both "
+                        "name a readable PEM certificate and key\n");
+    }
     if (ctx.gateway) {
         int bound_port = gateway_port(ctx.gateway);
-        printf("Gateway listening on %s:%d\n", gateway_bind, bound_port);
+        const char *scheme = gateway_is_tls(ctx.gateway) ? "https" : "http";
+        printf("Gateway listening on %s://%s:%d\n", scheme, gateway_bind, bound_port);
         ctx.gateway_auth = gateway_auth_init(300);
         ctx.rate_limit = rate_limit_init(10, 60, 60);
         ctx.subagent = subagent_init(4, 100);
@@ -440,8 +484,8 @@ int main(int argc, char **argv) {
                 char on_event[512];
                 const char *interval = getenv_or("HEARTBEAT_INTERVAL", "5m");
                 snprintf(on_event, sizeof(on_event),
-                         "/tool fetch url=\"http://%s:%d/health/heartbeat\" keep-result=no",
-                         gateway_bind, bound_port);
+                         "/tool fetch url=\"%s://%s:%d/health/heartbeat\" keep-result=no",
+                         scheme, gateway_bind, bound_port);
                 if (ctx.ros && routeros_scheduler_add(ctx.ros, "mikroclaw-heartbeat", interval,
                                                       on_event, sched_resp, sizeof(sched_resp)) == 0) {
                     scheduler_added = 1;
@@ -458,6 +502,7 @@ int main(int argc, char **argv) {
             pid_t child = fork();
             int status = 0;
             if (child == 0) {
+                (void)csprng_reseed();
                 while (running) {
                     mikroclaw_run(&ctx);
                     usleep(100000);
@@ -483,6 +528,12 @@ int main(int argc, char **argv) {
     printf("Shutting down...\n");
     log_emit(LOG_LEVEL_INFO, "main", "shutdown");
     
+#ifdef USE_MEMU_CLOUD
+    /* Give queued memU writes a moment to land */
+    for (int i = 0; i < 50 && memu_poll(100) > 0; i++) {
+    }
+#endif
+
     /* Cleanup */
         llm_destroy(ctx.llm);
 #ifdef CHANNEL_TELEGRAM
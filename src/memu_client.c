@@ -1,8 +1,8 @@
 #include "memu_client.h"
 
+#include "http_client.h"
 #include "json.h"
 
-#include <curl/curl.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -15,26 +15,9 @@ struct memu_buf {
     size_t len;
 };
 
-static size_t write_cb(void *contents, size_t size, size_t nmemb, void *userp) {
-    size_t chunk = size * nmemb;
-    struct memu_buf *buf = (struct memu_buf *)userp;
-    char *next = realloc(buf->data, buf->len + chunk + 1);
-
-    if (!next) {
-        return 0;
-    }
-    buf->data = next;
-    memcpy(buf->data + buf->len, contents, chunk);
-    buf->len += chunk;
-    buf->data[buf->len] = '\0';
-    return chunk;
-}
-
 static int post_json(const char *path, const char *json_body, struct memu_buf *out) {
-    CURL *curl;
-    CURLcode rc;
-    long code = 0;
-    struct curl_slist *headers = NULL;
+    curl_http_response response;
+    const char *headers[1];
     char auth[320];
     char url[512];
 
@@ -44,44 +27,20 @@ static int post_json(const char *path, const char *json_body, struct memu_buf *o
 
     snprintf(url, sizeof(url), "%s%s", g_base_url, path);
     snprintf(auth, sizeof(auth), "Authorization: Bearer %s", g_api_key);
-
-    curl = curl_easy_init();
-    if (!curl) {
-        return -1;
-    }
-
-    headers = curl_slist_append(headers, "Content-Type: application/json");
-    headers = curl_slist_append(headers, auth);
+    headers[0] = auth;
 
     out->data = NULL;
     out->len = 0;
 
-    curl_easy_setopt(curl, CURLOPT_URL, url);
-    curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-    curl_easy_setopt(curl, CURLOPT_POST, 1L);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDS, json_body);
-    curl_easy_setopt(curl, CURLOPT_POSTFIELDSIZE, (long)strlen(json_body));
-    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, write_cb);
-    curl_easy_setopt(curl, CURLOPT_WRITEDATA, out);
-    curl_easy_setopt(curl, CURLOPT_TIMEOUT_MS, 30000L);
-    curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT_MS, 10000L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYPEER, 1L);
-    curl_easy_setopt(curl, CURLOPT_SSL_VERIFYHOST, 2L);
-
-    rc = curl_easy_perform(curl);
-    if (rc == CURLE_OK) {
-        curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &code);
+    if (curl_http_request(url, headers, 1, json_body, &response) != 0) {
+        return -1;
     }
-
-    curl_slist_free_all(headers);
-    curl_easy_cleanup(curl);
-
-    if (rc != CURLE_OK || code < 200 || code >= 300) {
-        free(out->data);
-        out->data = NULL;
-        out->len = 0;
+    if (response.status_code < 200 || response.status_code >= 300) {
+        curl_http_response_free(&response);
         return -1;
     }
+    out->data = response.body;
+    out->len = response.body_len;
     return 0;
 }
 
@@ -98,8 +57,23 @@ int memu_client_configure(const char *api_key, const char *base_url) {
     return 0;
 }
 
-int memu_memorize(const char *content, const char *modality, const char *user_id) {
+static int memorize_body(const char *content, const char *modality, const char *user_id,
+                         char *body, size_t body_len) {
     char esc[2048];
+
+    if (json_escape(content, esc, sizeof(esc)) != 0) {
+        return -1;
+    }
+
+    snprintf(body, body_len,
+             "{\"resource_url\":\"inline\",\"modality\":\"%s\",\"content\":\"%s\",\"user\":{\"user_id\":\"%s\"}}",
+             (modality && modality[0]) ? modality : "conversation",
+             esc,
+             (user_id && user_id[0]) ? user_id : "default-user");
+    return 0;
+}
+
+int memu_memorize(const char *content, const char *modality, const char *user_id) {
     char body[3072];
     struct memu_buf out;
 
@@ -110,16 +84,42 @@ int memu_memorize(const char *content, const char *modality, const char *user_id
         return 0;
     }
 
-    if (json_escape(content, esc, sizeof(esc)) != 0) {
+    if (memorize_body(content, modality, user_id, body, sizeof(body)) != 0) {
         return -1;
     }
 
-    snprintf(body, sizeof(body),
-             "{\"resource_url\":\"inline\",\"modality\":\"%s\",\"content\":\"%s\",\"user\":{\"user_id\":\"%s\"}}",
-             (modality && modality[0]) ? modality : "conversation",
-             esc,
-             (user_id && user_id[0]) ? user_id : "default-user");
+    if (post_json("/api/v3/memory/memorize", body, &out) != 0) {
+        return -1;
+    }
+    free(out.data);
+    return 0;
+}
+
+int memu_memorize_async(const char *content, const char *modality, const char *user_id) {
+    char body[3072];
+    char auth[320];
+    char url[512];
+    const char *headers[1];
+    struct memu_buf out;
 
+    if (!content || content[0] == '\0' || g_api_key[0] == '\0') {
+        return -1;
+    }
+    if (getenv("MEMU_MOCK_RETRIEVE_TEXT")) {
+        return 0;
+    }
+
+    if (memorize_body(content, modality, user_id, body, sizeof(body)) != 0) {
+        return -1;
+    }
+
+    snprintf(url, sizeof(url), "%s/api/v3/memory/memorize", g_base_url);
+    snprintf(auth, sizeof(auth), "Authorization: Bearer %s", g_api_key);
+    headers[0] = auth;
+    if (curl_http_submit(url, headers, 1, body, NULL, NULL) == 0) {
+        return 0;
+    }
+    /* Too many writes in flight: fall back to waiting for this one */
     if (post_json("/api/v3/memory/memorize", body, &out) != 0) {
         return -1;
     }
@@ -127,6 +127,10 @@ int memu_memorize(const char *content, const char *modality, const char *user_id
     return 0;
 }
 
+int memu_poll(int timeout_ms) {
+    return curl_http_poll(timeout_ms);
+}
+
 int memu_retrieve(const char *query, const char *method, char *out, size_t out_len) {
     char esc[1024];
     char body[2048];
@@ -5,6 +5,15 @@
 
 int memu_client_configure(const char *api_key, const char *base_url);
 int memu_memorize(const char *content, const char *modality, const char *user_id);
+
+/* Queue a memorize write and return without waiting for memU; it completes
+ * from memu_poll (or any other curl transfer). Falls back to a blocking
+ * write when too many are already in flight. */
+int memu_memorize_async(const char *content, const char *modality, const char *user_id);
+
+/* Advance queued writes, waiting up to timeout_ms if any are in flight
+ * returns: writes still in flight */
+int memu_poll(int timeout_ms);
 int memu_retrieve(const char *query, const char *method, char *out, size_t out_len);
 int memu_categories(char *out, size_t out_len);
 int memu_forget(const char *key);
@@ -17,6 +17,18 @@ int memu_memorize(const char *content, const char *modality, const char *user_id
     return -1;
 }
 
+int memu_memorize_async(const char *content, const char *modality, const char *user_id) {
+    (void)content;
+    (void)modality;
+    (void)user_id;
+    return -1;
+}
+
+int memu_poll(int timeout_ms) {
+    (void)timeout_ms;
+    return 0;
+}
+
 int memu_retrieve(const char *query, const char *method, char *out, size_t out_len) {
     (void)query;
     (void)method;
@@ -5,6 +5,9 @@
 #include "mikroclaw.h"
 #include "routeros.h"
 #include "llm.h"
+#include "dns_cache.h"
+#include "http_pool.h"
+#include "http_stats.h"
 #include "channels/telegram.h"
 #include "gateway.h"
 #include "gateway_auth.h"
@@ -161,7 +164,7 @@ static void memu_store_turn(const char *session_id, const char *role, const char
     }
 
     snprintf(payload, sizeof(payload), "%s|%s|%s", session_id, role, content);
-    (void)memu_memorize(payload, "conversation", session_id);
+    (void)memu_memorize_async(payload, "conversation", session_id);
 }
 
 static void supervisor_tick(struct mikroclaw_ctx *ctx) {
@@ -228,6 +231,9 @@ int mikroclaw_run(struct mikroclaw_ctx *ctx) {
     char llm_response[LLM_MAX_RESPONSE] = {0};
     int ret;
     
+    /* Let queued memU writes make progress */
+    (void)memu_poll(0);
+
     /* Check Telegram for messages */
 #ifdef CHANNEL_TELEGRAM
     if (ctx->telegram) {
@@ -534,6 +540,21 @@ int mikroclaw_run(struct mikroclaw_ctx *ctx) {
                 }
             }
 
+            if (strcmp(method, "GET") == 0 && strcmp(path, "/stats/http") == 0) {
+                /* Up to HTTP_STATS_MAX_ORIGINS histograms: kept off the stack */
+                static char body[12288];
+                static char response[12800];
+                if (http_stats_format_json(body, sizeof(body)) < 0) {
+                    build_http_json_response(500, "Internal Server Error",
+                                             "{\"error\":\"stats too large\"}",
+                                             response, sizeof(response));
+                } else {
+                    build_http_json_response(200, "OK", body, response, sizeof(response));
+                }
+                gateway_respond(client_fd, response);
+                return MC_OK;
+            }
+
 #ifdef CHANNEL_SLACK
             if (ctx->slack && slack_parse_inbound(message, inbound_text, sizeof(inbound_text)) == 1) {
                 gateway_target = REPLY_SLACK;
@@ -606,5 +627,10 @@ int mikroclaw_run(struct mikroclaw_ctx *ctx) {
 #endif
     
     supervisor_tick(ctx);
+
+    /* Idle point: refresh DNS entries that were served stale this round and
+     * close pooled connections nobody has used for a while */
+    dns_cache_revalidate();
+    http_pool_prune();
     return MC_OK;
 }
@@ -99,7 +99,8 @@
 #define HTTP_MAX_HEADERS        16
 #define HTTP_TIMEOUT_MS         30000
 
-#define JSON_MAX_TOKENS         256
+#define JSON_INLINE_TOKENS      256     /* Held in struct json_ctx */
+#define JSON_MAX_TOKENS         65536   /* Heap growth ceiling */
 
 #define MESSAGE_MAX             4096
 #define COMMAND_MAX             4096
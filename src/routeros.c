@@ -10,6 +10,8 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#define ROUTEROS_MAX_BATCH 16   /* Requests pipelined per http_get_batch */
+
 struct routeros_ctx {
     struct http_client *http;
     char host[256];
@@ -34,6 +36,25 @@ static void build_auth_header(struct routeros_ctx *ctx) {
     }
 }
 
+/* Body sink that fills a caller buffer and drains the rest, so large
+ * listings are truncated without holding the whole response in memory. */
+struct output_sink {
+    char *out;
+    size_t max;
+    size_t len;
+};
+
+static int output_sink_write(const char *data, size_t len, void *user_data) {
+    struct output_sink *sink = user_data;
+    size_t room = sink->max - 1 - sink->len;
+
+    if (len > room) len = room;
+    memcpy(sink->out + sink->len, data, len);
+    sink->len += len;
+    sink->out[sink->len] = '\0';
+    return 0;
+}
+
 struct routeros_ctx *routeros_init(const char *host, int port,
                                    const char *user, const char *pass) {
     if (!host || !user || !pass) return NULL;
@@ -64,7 +85,7 @@ void routeros_destroy(struct routeros_ctx *ctx) {
 
 int routeros_execute(struct routeros_ctx *ctx, const char *command,
                      char *output, size_t max_output) {
-    if (!ctx || !command || !output) return -1;
+    if (!ctx || !command || !output || max_output == 0) return -1;
     
     char escaped[8192];
     if (json_escape(command, escaped, sizeof(escaped)) != 0) {
@@ -95,25 +116,23 @@ int routeros_execute(struct routeros_ctx *ctx, const char *command,
     };
     strncpy(headers[1].value, ctx->auth_header, sizeof(headers[1].value) - 1);
     
-    int ret = http_post(ctx->http, "/rest/execute", headers, 2,
-                        body, strlen(body), &resp);
+    struct output_sink sink = {output, max_output, 0};
+    output[0] = '\0';
+    int ret = http_post_stream(ctx->http, "/rest/execute", headers, 2,
+                               body, strlen(body), output_sink_write, &sink, &resp);
     
     if (ret != 0) {
         http_response_clear(&resp);
         return -1;
     }
     
-    /* Copy output */
-    strncpy(output, resp.body, max_output - 1);
-    output[max_output - 1] = '\0';
-    
     http_response_clear(&resp);
     return 0;
 }
 
 int routeros_get(struct routeros_ctx *ctx, const char *path,
                  char *output, size_t max_output) {
-    if (!ctx || !path || !output) return -1;
+    if (!ctx || !path || !output || max_output == 0) return -1;
     
     struct http_response resp;
     memset(&resp, 0, sizeof(resp));
@@ -124,23 +143,71 @@ int routeros_get(struct routeros_ctx *ctx, const char *path,
     };
     strncpy(headers[1].value, ctx->auth_header, sizeof(headers[1].value) - 1);
     
-    int ret = http_get(ctx->http, path, headers, 2, &resp);
+    struct output_sink sink = {output, max_output, 0};
+    output[0] = '\0';
+    int ret = http_get_stream(ctx->http, path, headers, 2,
+                              output_sink_write, &sink, &resp);
     
     if (ret != 0) {
         http_response_clear(&resp);
         return -1;
     }
     
-    strncpy(output, resp.body, max_output - 1);
-    output[max_output - 1] = '\0';
-    
     http_response_clear(&resp);
     return 0;
 }
 
+int routeros_get_batch(struct routeros_ctx *ctx, struct routeros_query *queries, int count) {
+    struct http_batch_item items[ROUTEROS_MAX_BATCH];
+    struct output_sink sinks[ROUTEROS_MAX_BATCH];
+    int failed = 0;
+
+    if (!ctx || !queries || count < 0) return -1;
+
+    struct http_header headers[2] = {
+        {"Accept", "application/json"},
+        {"Authorization", ""}
+    };
+    strncpy(headers[1].value, ctx->auth_header, sizeof(headers[1].value) - 1);
+
+    for (int done = 0; done < count; done += ROUTEROS_MAX_BATCH) {
+        int n = count - done < ROUTEROS_MAX_BATCH ? count - done : ROUTEROS_MAX_BATCH;
+        int index[ROUTEROS_MAX_BATCH];
+        int valid = 0;
+
+        for (int i = done; i < done + n; i++) {
+            struct routeros_query *q = &queries[i];
+            q->result = -1;
+            if (!q->path || !q->output || q->max_output == 0) {
+                failed = 1;
+                continue;
+            }
+            q->output[0] = '\0';
+            sinks[valid].out = q->output;
+            sinks[valid].max = q->max_output;
+            sinks[valid].len = 0;
+            items[valid].path = q->path;
+            items[valid].on_body = output_sink_write;
+            items[valid].user_data = &sinks[valid];
+            index[valid++] = i;
+        }
+
+        http_get_batch(ctx->http, headers, 2, items, valid);
+        for (int i = 0; i < valid; i++) {
+            if (items[i].result == 0) {
+                queries[index[i]].result = 0;
+            } else {
+                failed = 1;
+            }
+        }
+    }
+
+    return failed ? -1 : 0;
+}
+
 int routeros_post(struct routeros_ctx *ctx, const char *path,
                   const char *data, char *output, size_t max_output) {
-    if (!ctx || !path || !data || !output) return -1;
+    if (!ctx || !path || !data || !output || max_output == 0) return -1;
     
     struct http_response resp;
     memset(&resp, 0, sizeof(resp));
@@ -151,17 +218,16 @@ int routeros_post(struct routeros_ctx *ctx, const char *path,
     };
     strncpy(headers[1].value, ctx->auth_header, sizeof(headers[1].value) - 1);
     
-    int ret = http_post(ctx->http, path, headers, 2,
-                        data, strlen(data), &resp);
+    struct output_sink sink = {output, max_output, 0};
+    output[0] = '\0';
+    int ret = http_post_stream(ctx->http, path, headers, 2,
+                               data, strlen(data), output_sink_write, &sink, &resp);
     
     if (ret != 0) {
         http_response_clear(&resp);
         return -1;
     }
     
-    strncpy(output, resp.body, max_output - 1);
-    output[max_output - 1] = '\0';
-    
     http_response_clear(&resp);
     return 0;
 }
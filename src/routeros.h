@@ -32,6 +32,21 @@ int routeros_execute(struct routeros_ctx *ctx, const char *command,
 int routeros_get(struct routeros_ctx *ctx, const char *path,
                  char *output, size_t max_output);
 
+/* One query of a routeros_get_batch */
+struct routeros_query {
+    const char *path;
+    char *output;
+    size_t max_output;
+    int result;         /* Output: 0 or -1, as routeros_get */
+};
+
+/* Get several REST paths, pipelined on one connection so the batch costs
+ * about one round trip. Each output is filled (and truncated) as by
+ * routeros_get.
+ * returns: 0 if every query succeeded, -1 otherwise (see query results)
+ */
+int routeros_get_batch(struct routeros_ctx *ctx, struct routeros_query *queries, int count);
+
 /* Post data to REST API */
 int routeros_post(struct routeros_ctx *ctx, const char *path,
                   const char *data, char *output, size_t max_output);
@@ -1,5 +1,6 @@
 #include "subagent.h"
 
+#include "csprng.h"
 #include "task_handlers.h"
 #include "task_queue.h"
 #include "worker_pool.h"
@@ -47,7 +48,10 @@ static void spawn_task(struct task_item *task) {
         char out[TASK_RESULT_MAX] = {0};
         char path[128];
         FILE *fp;
-        int rc = fn(task->params, out, sizeof(out));
+        int rc;
+
+        (void)csprng_reseed();
+        rc = fn(task->params, out, sizeof(out));
         task_result_path(task->id, path, sizeof(path));
         fp = fopen(path, "w");
         if (fp) {
@@ -1,6 +1,9 @@
 #include "task_handlers.h"
 
+#include "json.h"
+
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 
 task_handler_fn task_handler_resolve(const char *task_type) {
@@ -21,3 +24,205 @@ task_handler_fn task_handler_resolve(const char *task_type) {
     }
     return NULL;
 }
+
+/* Append one record's scalar fields; on overflow the line is dropped */
+static int format_record(const struct json_ctx *json, const jsmntok_t *record,
+                         char *out, size_t out_len, size_t *used) {
+    struct json_iter it;
+    const jsmntok_t *key;
+    const jsmntok_t *value;
+    size_t pos = *used;
+    int n;
+
+    if (!json_iter_init(&it, json, record) || !it.object) {
+        return 0;
+    }
+    while ((value = json_iter_next(&it, &key)) != NULL) {
+        if (value->type != JSMN_STRING && value->type != JSMN_PRIMITIVE) {
+            continue;
+        }
+        n = snprintf(out + pos, out_len - pos, "%s%.*s=%.*s",
+                     pos > *used ? " " : "",
+                     key->end - key->start, json->data + key->start,
+                     value->end - value->start, json->data + value->start);
+        if (n < 0 || (size_t)n >= out_len - pos) {
+            out[*used] = '\0';
+            return -1;
+        }
+        pos += (size_t)n;
+    }
+    if (pos + 1 >= out_len) {
+        out[*used] = '\0';
+        return -1;
+    }
+    out[pos++] = '\n';
+    out[pos] = '\0';
+    *used = pos;
+    return 0;
+}
+
+/* End of the last whole element of a top-level array that was cut off
+ * (json_parse gave JSMN_ERROR_PART), or 0 if none arrived whole */
+static int whole_prefix(const struct json_ctx *ctx) {
+    const jsmntok_t *t = ctx->tokens;
+    int n = (int)ctx->parser.toknext;
+    int end = 0;
+    int i = 1;
+
+    if (n < 1 || t[0].type != JSMN_ARRAY) {
+        return 0;
+    }
+    while (i < n && t[i].end != -1) {
+        int elem_end = t[i].type == JSMN_STRING ? t[i].end + 1 : t[i].end;
+
+        /* A primitive running into the cut may itself be cut short */
+        if (t[i].type == JSMN_PRIMITIVE && elem_end >= ctx->data_len) {
+            break;
+        }
+        end = elem_end;
+        for (i++; i < n && t[i].start < end; i++) {
+        }
+    }
+    return end;
+}
+
+int task_format_records(const char *json, size_t len, char *out, size_t out_len) {
+    struct json_ctx ctx;
+    struct json_iter it;
+    const jsmntok_t *record;
+    char *whole = NULL;
+    size_t used = 0;
+    int count = 0;
+    int total;
+    int cut;
+    int r;
+
+    if (!json || !out || out_len == 0) {
+        return -1;
+    }
+    out[0] = '\0';
+
+    json_init(&ctx);
+    r = json_parse(&ctx, json, len);
+    if (r == JSMN_ERROR_PART && (cut = whole_prefix(&ctx)) > 0) {
+        /* Cut off by the reply buffer: keep the records that arrived whole */
+        whole = malloc((size_t)cut + 2);
+        if (whole) {
+            memcpy(whole, json, (size_t)cut);
+            whole[cut] = ']';
+            whole[cut + 1] = '\0';
+            r = json_parse(&ctx, whole, (size_t)cut + 1);
+        }
+    }
+    if (r < 1 || !json_iter_init(&it, &ctx, &ctx.tokens[0])) {
+        json_free(&ctx);
+        free(whole);
+        snprintf(out, out_len, "%.*s", (int)len, json);
+        return -1;
+    }
+
+    if (it.object) {
+        count = format_record(&ctx, &ctx.tokens[0], out, out_len, &used) == 0 ? 1 : 0;
+        json_free(&ctx);
+        free(whole);
+        if (count == 0) {
+            snprintf(out, out_len, "%.*s", (int)len, json);
+        }
+        return count;
+    }
+
+    total = json_array_len(&ctx, &ctx.tokens[0]);
+    while ((record = json_iter_next(&it, NULL)) != NULL) {
+        if (format_record(&ctx, record, out, out_len, &used) != 0) {
+            snprintf(out + used, out_len - used, "(%d more%s)\n", total - count,
+                     whole ? ", reply truncated" : "");
+            break;
+        }
+        count++;
+    }
+    if (whole && count == total &&
+        snprintf(out + used, out_len - used, "(reply truncated)\n") >= (int)(out_len - used)) {
+        out[used] = '\0';
+    }
+    json_free(&ctx);
+    free(whole);
+    if (count == 0 && total > 0) {
+        /* A single record wider than out: raw text beats an empty share */
+        snprintf(out, out_len, "%.*s", (int)len, json);
+    }
+    return count;
+}
+
+static void append_text(char *dst, size_t dst_len, const char *text) {
+    size_t used;
+    size_t remain;
+
+    if (!dst || dst_len == 0 || !text) {
+        return;
+    }
+    used = strlen(dst);
+    if (used >= dst_len - 1) {
+        return;
+    }
+    remain = dst_len - used - 1;
+    strncat(dst, text, remain);
+}
+
+void task_queries_add(struct task_queries *q, const char *label, const char *path) {
+    char *output;
+
+    if (!q || !label || !path || q->count >= TASK_MAX_QUERIES) {
+        return;
+    }
+    output = malloc(TASK_QUERY_REPLY_MAX);
+    if (!output) {
+        return;
+    }
+    q->labels[q->count] = label;
+    q->outputs[q->count] = output;
+    q->queries[q->count].path = path;
+    q->queries[q->count].output = output;
+    q->queries[q->count].max_output = TASK_QUERY_REPLY_MAX;
+    q->queries[q->count].result = -1;
+    q->count++;
+}
+
+static void free_queries(struct task_queries *q) {
+    int i;
+
+    for (i = 0; q && i < q->count; i++) {
+        free(q->outputs[i]);
+    }
+    if (q) {
+        q->count = 0;
+    }
+}
+
+void task_queries_append(struct routeros_ctx *ros, struct task_queries *q,
+                         char *ctx, size_t ctx_len) {
+    char line[256];
+    char text[TASK_QUERY_TEXT_MAX];
+    int i;
+
+    if (!ros || !q || !ctx || ctx_len == 0) {
+        free_queries(q);
+        return;
+    }
+
+    (void)routeros_get_batch(ros, q->queries, q->count);
+
+    for (i = 0; i < q->count; i++) {
+        snprintf(line, sizeof(line), "\n[%s] %s\n", q->labels[i], q->queries[i].path);
+        append_text(ctx, ctx_len, line);
+
+        if (q->queries[i].result != 0) {
+            append_text(ctx, ctx_len, "<query_failed>");
+        } else {
+            (void)task_format_records(q->outputs[i], strlen(q->outputs[i]),
+                                      text, sizeof(text));
+            append_text(ctx, ctx_len, text);
+        }
+        append_text(ctx, ctx_len, "\n");
+    }
+    free_queries(q);
+}
@@ -1,6 +1,8 @@
 #ifndef MIKROCLAW_TASK_HANDLERS_H
 #define MIKROCLAW_TASK_HANDLERS_H
 
+#include "routeros.h"
+
 #include <stddef.h>
 
 typedef int (*task_handler_fn)(const char *params_json, char *result, size_t result_len);
@@ -12,4 +14,36 @@ int task_handle_analyze(const char *params_json, char *result, size_t result_len
 int task_handle_summarize(const char *params_json, char *result, size_t result_len);
 int task_handle_skill_invoke(const char *params_json, char *result, size_t result_len);
 
+/* Render a RouterOS REST reply, an array of records or a single record,
+ * as one "key=value ..." line per record for the LLM context. Nested
+ * values are left out, and output stops at the last whole record that
+ * fits. A listing cut off mid-record keeps its leading whole records.
+ * When no record fits, or the reply is not a JSON object or array, out
+ * holds the raw reply instead, truncated to fit.
+ * returns: records written, or -1 if the reply is not a JSON object or array
+ */
+int task_format_records(const char *json, size_t len, char *out, size_t out_len);
+
+#define TASK_MAX_QUERIES     8
+#define TASK_QUERY_REPLY_MAX 16384  /* Raw REST reply, compacted before use */
+#define TASK_QUERY_TEXT_MAX  1024   /* Context share of one query */
+
+/* RouterOS reads gathered as LLM context by the investigate and analyze
+ * tasks. Set count to 0, add paths, then append them. */
+struct task_queries {
+    int count;
+    const char *labels[TASK_MAX_QUERIES];
+    struct routeros_query queries[TASK_MAX_QUERIES];
+    char *outputs[TASK_MAX_QUERIES];
+};
+
+/* Queue a REST path; ignored once TASK_MAX_QUERIES are queued */
+void task_queries_add(struct task_queries *q, const char *label, const char *path);
+
+/* Fetch all queued queries in one pipelined batch, then append them to
+ * ctx in order, each as "[label] path" and its task_format_records text.
+ * The queue is emptied and its buffers freed. */
+void task_queries_append(struct routeros_ctx *ros, struct task_queries *q,
+                         char *ctx, size_t ctx_len);
+
 #endif
@@ -25,29 +25,6 @@ static void append_text(char *dst, size_t dst_len, const char *text) {
     strncat(dst, text, remain);
 }
 
-static void append_query(struct routeros_ctx *ros,
-                         char *ctx,
-                         size_t ctx_len,
-                         const char *label,
-                         const char *path) {
-    char buf[1024];
-    char line[256];
-
-    if (!ros || !ctx || ctx_len == 0 || !label || !path) {
-        return;
-    }
-
-    snprintf(line, sizeof(line), "\n[%s] %s\n", label, path);
-    append_text(ctx, ctx_len, line);
-
-    if (routeros_get(ros, path, buf, sizeof(buf)) == 0) {
-        append_text(ctx, ctx_len, buf);
-    } else {
-        append_text(ctx, ctx_len, "<query_failed>");
-    }
-    append_text(ctx, ctx_len, "\n");
-}
-
 static int llm_config_from_env(struct llm_config *cfg) {
     const char *provider_name;
     const char *fallback_key;
@@ -99,6 +76,7 @@ int task_handle_analyze(const char *params_json, char *result, size_t result_len
     char scope[64] = "performance";
     char user_msg[4096];
     char context[7000] = "";
+    struct task_queries queries;
     const char *host = getenv("ROUTER_HOST");
     const char *user = getenv("ROUTER_USER");
     const char *pass = getenv("ROUTER_PASS");
@@ -119,40 +97,42 @@ int task_handle_analyze(const char *params_json, char *result, size_t result_len
         return -1;
     }
 
+    queries.count = 0;
     if (strcmp(scope, "performance") == 0) {
-        append_query(ros, context, sizeof(context), "system_resource", "/rest/system/resource");
-        append_query(ros, context, sizeof(context), "system_health", "/rest/system/health");
-        append_query(ros, context, sizeof(context), "interfaces", "/rest/interface");
-        append_query(ros, context, sizeof(context), "queues", "/rest/queue/simple");
+        task_queries_add(&queries, "system_resource", "/rest/system/resource");
+        task_queries_add(&queries, "system_health", "/rest/system/health");
+        task_queries_add(&queries, "interfaces", "/rest/interface");
+        task_queries_add(&queries, "queues", "/rest/queue/simple");
     } else if (strcmp(scope, "security") == 0) {
-        append_query(ros, context, sizeof(context), "fw_filter", "/rest/ip/firewall/filter");
-        append_query(ros, context, sizeof(context), "ip_services", "/rest/ip/service");
-        append_query(ros, context, sizeof(context), "users", "/rest/user");
-        append_query(ros, context, sizeof(context), "logs", "/rest/log");
+        task_queries_add(&queries, "fw_filter", "/rest/ip/firewall/filter");
+        task_queries_add(&queries, "ip_services", "/rest/ip/service");
+        task_queries_add(&queries, "users", "/rest/user");
+        task_queries_add(&queries, "logs", "/rest/log");
     } else if (strcmp(scope, "firewall") == 0) {
-        append_query(ros, context, sizeof(context), "fw_filter", "/rest/ip/firewall/filter");
-        append_query(ros, context, sizeof(context), "fw_nat", "/rest/ip/firewall/nat");
-        append_query(ros, context, sizeof(context), "fw_conn", "/rest/ip/firewall/connection");
-        append_query(ros, context, sizeof(context), "fw_addr_list", "/rest/ip/firewall/address-list");
+        task_queries_add(&queries, "fw_filter", "/rest/ip/firewall/filter");
+        task_queries_add(&queries, "fw_nat", "/rest/ip/firewall/nat");
+        task_queries_add(&queries, "fw_conn", "/rest/ip/firewall/connection");
+        task_queries_add(&queries, "fw_addr_list", "/rest/ip/firewall/address-list");
     } else if (strcmp(scope, "routing") == 0) {
-        append_query(ros, context, sizeof(context), "routes", "/rest/ip/route");
-        append_query(ros, context, sizeof(context), "arp", "/rest/ip/arp");
-        append_query(ros, context, sizeof(context), "neighbors", "/rest/ip/neighbor");
-        append_query(ros, context, sizeof(context), "dns", "/rest/ip/dns");
+        task_queries_add(&queries, "routes", "/rest/ip/route");
+        task_queries_add(&queries, "arp", "/rest/ip/arp");
+        task_queries_add(&queries, "neighbors", "/rest/ip/neighbor");
+        task_queries_add(&queries, "dns", "/rest/ip/dns");
     } else if (strcmp(scope, "full") == 0) {
-        append_query(ros, context, sizeof(context), "system_resource", "/rest/system/resource");
-        append_query(ros, context, sizeof(context), "system_health", "/rest/system/health");
-        append_query(ros, context, sizeof(context), "interfaces", "/rest/interface");
-        append_query(ros, context, sizeof(context), "fw_filter", "/rest/ip/firewall/filter");
-        append_query(ros, context, sizeof(context), "fw_nat", "/rest/ip/firewall/nat");
-        append_query(ros, context, sizeof(context), "routes", "/rest/ip/route");
-        append_query(ros, context, sizeof(context), "dns", "/rest/ip/dns");
-        append_query(ros, context, sizeof(context), "logs", "/rest/log");
+        task_queries_add(&queries, "system_resource", "/rest/system/resource");
+        task_queries_add(&queries, "system_health", "/rest/system/health");
+        task_queries_add(&queries, "interfaces", "/rest/interface");
+        task_queries_add(&queries, "fw_filter", "/rest/ip/firewall/filter");
+        task_queries_add(&queries, "fw_nat", "/rest/ip/firewall/nat");
+        task_queries_add(&queries, "routes", "/rest/ip/route");
+        task_queries_add(&queries, "dns", "/rest/ip/dns");
+        task_queries_add(&queries, "logs", "/rest/log");
     } else {
-        append_query(ros, context, sizeof(context), "system_resource", "/rest/system/resource");
-        append_query(ros, context, sizeof(context), "interfaces", "/rest/interface");
-        append_query(ros, context, sizeof(context), "logs", "/rest/log");
+        task_queries_add(&queries, "system_resource", "/rest/system/resource");
+        task_queries_add(&queries, "interfaces", "/rest/interface");
+        task_queries_add(&queries, "logs", "/rest/log");
     }
+    task_queries_append(ros, &queries, context, sizeof(context));
 
     if (llm_config_from_env(&llm_cfg) != 0) {
         routeros_destroy(ros);
@@ -25,29 +25,6 @@ static void append_text(char *dst, size_t dst_len, const char *text) {
     strncat(dst, text, remain);
 }
 
-static void append_query(struct routeros_ctx *ros,
-                         char *ctx,
-                         size_t ctx_len,
-                         const char *label,
-                         const char *path) {
-    char buf[1024];
-    char line[256];
-
-    if (!ros || !ctx || ctx_len == 0 || !label || !path) {
-        return;
-    }
-
-    snprintf(line, sizeof(line), "\n[%s] %s\n", label, path);
-    append_text(ctx, ctx_len, line);
-
-    if (routeros_get(ros, path, buf, sizeof(buf)) == 0) {
-        append_text(ctx, ctx_len, buf);
-    } else {
-        append_text(ctx, ctx_len, "<query_failed>");
-    }
-    append_text(ctx, ctx_len, "\n");
-}
-
 static int llm_config_from_env(struct llm_config *cfg) {
     const char *provider_name;
     const char *fallback_key;
@@ -100,6 +77,7 @@ int task_handle_investigate(const char *params_json, char *result, size_t result
     char issue[256] = "";
     char user_msg[4096];
     char context[7000] = "";
+    struct task_queries queries;
     const char *host = getenv("ROUTER_HOST");
     const char *user = getenv("ROUTER_USER");
     const char *pass = getenv("ROUTER_PASS");
@@ -121,29 +99,31 @@ int task_handle_investigate(const char *params_json, char *result, size_t result
         return -1;
     }
 
-    append_query(ros, context, sizeof(context), "system", "/rest/system/resource");
-    append_query(ros, context, sizeof(context), "logs", "/rest/log");
+    queries.count = 0;
+    task_queries_add(&queries, "system", "/rest/system/resource");
+    task_queries_add(&queries, "logs", "/rest/log");
 
     if (strstr(target, "ether") || strstr(target, "wlan") || strstr(target, "bridge") || strstr(target, "vlan")) {
-        append_query(ros, context, sizeof(context), "interfaces", "/rest/interface");
-        append_query(ros, context, sizeof(context), "ip_addresses", "/rest/ip/address");
+        task_queries_add(&queries, "interfaces", "/rest/interface");
+        task_queries_add(&queries, "ip_addresses", "/rest/ip/address");
     } else if (strchr(target, '.')) {
-        append_query(ros, context, sizeof(context), "arp", "/rest/ip/arp");
-        append_query(ros, context, sizeof(context), "dhcp_leases", "/rest/ip/dhcp-server/lease");
-        append_query(ros, context, sizeof(context), "routes", "/rest/ip/route");
+        task_queries_add(&queries, "arp", "/rest/ip/arp");
+        task_queries_add(&queries, "dhcp_leases", "/rest/ip/dhcp-server/lease");
+        task_queries_add(&queries, "routes", "/rest/ip/route");
     } else if (strstr(target, "firewall")) {
-        append_query(ros, context, sizeof(context), "fw_filter", "/rest/ip/firewall/filter");
-        append_query(ros, context, sizeof(context), "fw_conn", "/rest/ip/firewall/connection");
+        task_queries_add(&queries, "fw_filter", "/rest/ip/firewall/filter");
+        task_queries_add(&queries, "fw_conn", "/rest/ip/firewall/connection");
     } else if (strstr(target, "dhcp")) {
-        append_query(ros, context, sizeof(context), "dhcp_leases", "/rest/ip/dhcp-server/lease");
-        append_query(ros, context, sizeof(context), "ip_addresses", "/rest/ip/address");
+        task_queries_add(&queries, "dhcp_leases", "/rest/ip/dhcp-server/lease");
+        task_queries_add(&queries, "ip_addresses", "/rest/ip/address");
     } else if (strstr(target, "routing")) {
-        append_query(ros, context, sizeof(context), "routes", "/rest/ip/route");
-        append_query(ros, context, sizeof(context), "arp", "/rest/ip/arp");
-        append_query(ros, context, sizeof(context), "neighbors", "/rest/ip/neighbor");
+        task_queries_add(&queries, "routes", "/rest/ip/route");
+        task_queries_add(&queries, "arp", "/rest/ip/arp");
+        task_queries_add(&queries, "neighbors", "/rest/ip/neighbor");
     } else {
-        append_query(ros, context, sizeof(context), "health", "/rest/system/health");
+        task_queries_add(&queries, "health", "/rest/system/health");
     }
+    task_queries_append(ros, &queries, context, sizeof(context));
 
     if (llm_config_from_env(&llm_cfg) != 0) {
         routeros_destroy(ros);